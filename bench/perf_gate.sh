@@ -0,0 +1,52 @@
+#!/usr/bin/env bash
+# Fails if a benchmark result is slower than the baseline by more than the
+# tolerance: lower pages/sec, or more CPU time per page.
+#
+# Usage: perf_gate.sh <result> <baseline> [tolerance_percent]
+set -euo pipefail
+
+if [[ $# -lt 2 ]]; then
+    sed -n '2,5p' "$0" >&2
+    exit 1
+fi
+result=$1
+baseline=$2
+tolerance=${3:-10}
+
+if [[ ! -f "$baseline" ]]; then
+    echo "No baseline at $baseline; record one with the bench-baseline target" >&2
+    exit 1
+fi
+
+value() {
+    awk -v key="$2" '$1 == key { print $2 }' "$1"
+}
+
+for key in pages concurrency; do
+    if [[ "$(value "$result" $key)" != "$(value "$baseline" $key)" ]]; then
+        echo "Result and baseline were measured with different $key; re-record the baseline" >&2
+        exit 1
+    fi
+done
+
+status=0
+check() {
+    local key=$1 direction=$2
+    local now base
+    now=$(value "$result" "$key")
+    base=$(value "$baseline" "$key")
+    # Percent change in the bad direction: lower throughput, higher CPU
+    local regression
+    regression=$(awk -v now="$now" -v base="$base" -v dir="$direction" \
+        'BEGIN { change = (now - base) / base * 100; printf "%.1f", (dir == "higher") ? -change : change }')
+    if awk -v r="$regression" -v t="$tolerance" 'BEGIN { exit !(r > t) }'; then
+        echo "REGRESSION $key: $now vs baseline $base ($regression% worse, tolerance $tolerance%)"
+        status=1
+    else
+        echo "ok $key: $now vs baseline $base"
+    fi
+}
+
+check pages_per_sec higher
+check cpu_ms_per_page lower
+exit $status
@@ -0,0 +1,36 @@
+#!/usr/bin/env bash
+# Profile-guided build: an instrumented crawler crawls the synthetic site, then
+# the same build tree is rebuilt with the profile. GCC matches profiles to
+# objects by path, which is why both phases share one build directory.
+#
+# Usage: pgo.sh <source_dir> <build_dir> [extra cmake args]
+#   PGO_TRAIN_PAGES  pages of the training crawl (default 20000)
+set -euo pipefail
+
+if [[ $# -lt 2 ]]; then
+    sed -n '2,7p' "$0" >&2
+    exit 1
+fi
+source_dir=$(realpath "$1")
+build_dir=$(realpath -m "$2")
+shift 2
+profile_dir="$build_dir/pgo-profiles"
+jobs=$(nproc)
+
+cmake -S "$source_dir" -B "$build_dir" -DCMAKE_BUILD_TYPE=Release "$@" \
+    -DCRAWLER_PGO=GENERATE -DCRAWLER_PGO_DIR="$profile_dir"
+rm -rf "$profile_dir"
+cmake --build "$build_dir" -j"$jobs" --target crawler crawler_bench_site
+
+echo "Training crawl..."
+"$source_dir/bench/run_bench.sh" "$build_dir/crawler" "$build_dir/crawler_bench_site" \
+    --pages "${PGO_TRAIN_PAGES:-20000}" --runs 1 > /dev/null
+
+# Clang writes raw profiles that have to be merged first
+if compgen -G "$profile_dir/*.profraw" > /dev/null; then
+    llvm-profdata merge -output="$profile_dir/default.profdata" "$profile_dir"/*.profraw
+fi
+
+cmake -S "$source_dir" -B "$build_dir" -DCRAWLER_PGO=USE
+cmake --build "$build_dir" -j"$jobs" --target crawler crawler_bench_site
+echo "Profile-optimized crawler: $build_dir/crawler"
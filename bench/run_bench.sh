@@ -0,0 +1,90 @@
+#!/usr/bin/env bash
+# Crawls the synthetic site several times and reports the median throughput
+# and CPU time per page, as parsed from the crawler's summary lines.
+#
+# Usage: run_bench.sh <crawler> <crawler_bench_site> [--pages N] [--runs N]
+#                     [--concurrency N] [--port N] [--out FILE] [-- extra crawler args]
+set -euo pipefail
+
+if [[ $# -lt 2 ]]; then
+    sed -n '2,7p' "$0" >&2
+    exit 1
+fi
+crawler=$(realpath "$1")
+site=$(realpath "$2")
+shift 2
+
+pages=20000
+runs=5
+concurrency=32
+port=${BENCH_PORT:-18090}
+out=""
+extra=()
+while [[ $# -gt 0 ]]; do
+    case "$1" in
+        --pages) pages=$2; shift 2 ;;
+        --runs) runs=$2; shift 2 ;;
+        --concurrency) concurrency=$2; shift 2 ;;
+        --port) port=$2; shift 2 ;;
+        --out) out=$2; shift 2 ;;
+        --) shift; extra=("$@"); break ;;
+        *) echo "Unknown option: $1" >&2; exit 1 ;;
+    esac
+done
+
+workdir=$(mktemp -d)
+site_pid=""
+cleanup() {
+    [[ -n "$site_pid" ]] && kill "$site_pid" 2>/dev/null || true
+    rm -rf "$workdir"
+}
+trap cleanup EXIT
+
+# Twice as many pages as are crawled, so the frontier never runs dry
+"$site" --port "$port" --pages $((pages * 2)) > "$workdir/site.log" 2>&1 &
+site_pid=$!
+for _ in $(seq 50); do
+    if (exec 3<>"/dev/tcp/127.0.0.1/$port") 2>/dev/null; then
+        break
+    fi
+    if ! kill -0 "$site_pid" 2>/dev/null; then
+        cat "$workdir/site.log" >&2
+        exit 1
+    fi
+    sleep 0.1
+done
+
+throughputs=()
+cpus=()
+for run in $(seq "$runs"); do
+    log="$workdir/run_$run.log"
+    if ! (cd "$workdir" && "$crawler" "${extra[@]}" "http://127.0.0.1:$port/p/0" "$pages" "$concurrency" > "$log" 2>&1); then
+        tail -20 "$log" >&2
+        echo "Benchmark crawl $run failed" >&2
+        exit 1
+    fi
+    rm -f "$workdir"/crawl_results_*
+    throughput=$(awk '/^Throughput:/ { print $2 }' "$log")
+    cpu=$(awk '/^CPU per page:/ { print $4 }' "$log")
+    if [[ -z "$throughput" || -z "$cpu" ]]; then
+        echo "No throughput in the crawler's output:" >&2
+        tail -20 "$log" >&2
+        exit 1
+    fi
+    echo "run $run: $throughput pages/sec, $cpu ms CPU per page" >&2
+    throughputs+=("$throughput")
+    cpus+=("$cpu")
+done
+
+median() {
+    printf '%s\n' "$@" | sort -g | awk '{ v[NR] = $1 } END { print (NR % 2) ? v[(NR + 1) / 2] : (v[NR / 2] + v[NR / 2 + 1]) / 2 }'
+}
+
+result="pages_per_sec $(median "${throughputs[@]}")
+cpu_ms_per_page $(median "${cpus[@]}")
+pages $pages
+concurrency $concurrency"
+echo "$result"
+if [[ -n "$out" ]]; then
+    echo "$result" > "$out"
+fi
@@ -0,0 +1,142 @@
+#ifndef BOUNDED_CHANNEL_HPP
+#define BOUNDED_CHANNEL_HPP
+
+#include <atomic>
+#include <memory>
+#include <optional>
+#include <cstddef>
+#include <cstdint>
+
+// Bounded multi-producer / multi-consumer channel between pipeline stages.
+//
+// The queue itself is Vyukov's lock-free ring: every cell carries a sequence
+// number that tells producers and consumers whose turn it is, so tryPush() and
+// tryPop() never take a lock. push() and pop() block on C++20 atomic waits when
+// the ring is full or empty, which gives backpressure: a fast stage stalls
+// instead of buffering without bound in front of a slow one.
+template <typename T>
+class BoundedChannel {
+public:
+    explicit BoundedChannel(size_t capacity)
+        : m_capacity(roundUpToPowerOfTwo(capacity)),
+          m_mask(m_capacity - 1),
+          m_cells(std::make_unique<Cell[]>(m_capacity)) {
+        for (size_t i = 0; i < m_capacity; ++i) {
+            m_cells[i].sequence.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    BoundedChannel(const BoundedChannel&) = delete;
+    BoundedChannel& operator=(const BoundedChannel&) = delete;
+
+    bool tryPush(T& value) {
+        size_t position {m_tail.load(std::memory_order_relaxed)};
+        while (true) {
+            Cell& cell {m_cells[position & m_mask]};
+            const size_t sequence {cell.sequence.load(std::memory_order_acquire)};
+            const intptr_t diff {static_cast<intptr_t>(sequence) - static_cast<intptr_t>(position)};
+            if (diff == 0) {
+                if (m_tail.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+                    cell.value = std::move(value);
+                    cell.sequence.store(position + 1, std::memory_order_release);
+                    m_pushes.fetch_add(1, std::memory_order_release);
+                    m_pushes.notify_one();
+                    return true;
+                }
+            } else if (diff < 0) {
+                return false;  // Full
+            } else {
+                position = m_tail.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    bool tryPop(T& value) {
+        size_t position {m_head.load(std::memory_order_relaxed)};
+        while (true) {
+            Cell& cell {m_cells[position & m_mask]};
+            const size_t sequence {cell.sequence.load(std::memory_order_acquire)};
+            const intptr_t diff {static_cast<intptr_t>(sequence) - static_cast<intptr_t>(position + 1)};
+            if (diff == 0) {
+                if (m_head.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+                    value = std::move(*cell.value);
+                    cell.value.reset();
+                    cell.sequence.store(position + m_capacity, std::memory_order_release);
+                    m_pops.fetch_add(1, std::memory_order_release);
+                    m_pops.notify_one();
+                    return true;
+                }
+            } else if (diff < 0) {
+                return false;  // Empty
+            } else {
+                position = m_head.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    // Blocks while the channel is full. Returns false if the channel was closed.
+    bool push(T value) {
+        while (!m_closed.load(std::memory_order_acquire)) {
+            const uint32_t seen {m_pops.load(std::memory_order_acquire)};
+            if (tryPush(value)) return true;
+            m_pops.wait(seen, std::memory_order_acquire);
+        }
+        return false;
+    }
+
+    // Blocks while the channel is empty. Returns false once it is closed and drained.
+    bool pop(T& value) {
+        while (true) {
+            const uint32_t seen {m_pushes.load(std::memory_order_acquire)};
+            if (tryPop(value)) return true;
+            if (m_closed.load(std::memory_order_acquire)) {
+                return tryPop(value);
+            }
+            m_pushes.wait(seen, std::memory_order_acquire);
+        }
+    }
+
+    // Wakes every blocked producer and consumer. Values already queued can still be popped.
+    void close() {
+        m_closed.store(true, std::memory_order_release);
+        m_pushes.fetch_add(1, std::memory_order_release);
+        m_pops.fetch_add(1, std::memory_order_release);
+        m_pushes.notify_all();
+        m_pops.notify_all();
+    }
+
+    size_t capacity() const { return m_capacity; }
+
+    // Approximate number of queued values, for stats only.
+    size_t size() const {
+        const size_t tail {m_tail.load(std::memory_order_relaxed)};
+        const size_t head {m_head.load(std::memory_order_relaxed)};
+        return tail > head ? tail - head : 0;
+    }
+
+private:
+    struct Cell {
+        std::atomic<size_t> sequence {0};
+        std::optional<T> value;
+    };
+
+    static size_t roundUpToPowerOfTwo(size_t n) {
+        size_t capacity {2};
+        while (capacity < n) capacity <<= 1;
+        return capacity;
+    }
+
+    const size_t m_capacity;
+    const size_t m_mask;
+    std::unique_ptr<Cell[]> m_cells;
+
+    // Producers and consumers touch different cache lines.
+    alignas(64) std::atomic<size_t> m_tail {0};
+    alignas(64) std::atomic<size_t> m_head {0};
+    // Bumped on every push/pop; blocked threads wait for them to change.
+    alignas(64) std::atomic<uint32_t> m_pushes {0};
+    alignas(64) std::atomic<uint32_t> m_pops {0};
+    std::atomic<bool> m_closed {false};
+};
+
+#endif
@@ -0,0 +1,76 @@
+#ifndef BUFFER_POOL_HPP
+#define BUFFER_POOL_HPP
+
+#include "bounded_channel.hpp"
+
+#include <string>
+#include <string_view>
+#include <cstddef>
+
+// Recycles response buffers across fetches, so a crawl reaches a steady state
+// where bodies and headers are written into memory that is already allocated.
+// Buffers move between threads (fetch -> parse), so the free list is a shared
+// lock-free channel rather than per-thread caches.
+class BufferPool {
+public:
+    // Smaller buffers are not worth a pool slot; the pool only holds larger ones.
+    static constexpr size_t kMinCapacity {1024};
+
+    static BufferPool& shared();
+
+    // A recycled buffer, or an empty string if none is free.
+    std::string take();
+    // Keeps the buffer's storage for reuse unless the pool is full or it is too small or too large.
+    void give(std::string&& buffer);
+
+private:
+    BufferPool();
+
+    BoundedChannel<std::string> m_free;
+};
+
+// String storage that goes back to the shared pool when it is destroyed.
+class PooledBuffer {
+public:
+    PooledBuffer() = default;
+    ~PooledBuffer() { release(); }
+
+    PooledBuffer(PooledBuffer&& other) noexcept : m_data(std::move(other.m_data)) { other.m_data.clear(); }
+    PooledBuffer& operator=(PooledBuffer&& other) noexcept {
+        if (this != &other) {
+            release();
+            m_data = std::move(other.m_data);
+            other.m_data.clear();
+        }
+        return *this;
+    }
+    PooledBuffer(const PooledBuffer&) = delete;
+    PooledBuffer& operator=(const PooledBuffer&) = delete;
+
+    // Empties the buffer, taking recycled storage from the pool if it has none yet.
+    void reset() {
+        m_data.clear();
+        if (m_data.capacity() < BufferPool::kMinCapacity) m_data = BufferPool::shared().take();
+    }
+    // Returns the storage to the pool now; the buffer is left empty.
+    void release() {
+        if (m_data.capacity() >= BufferPool::kMinCapacity) BufferPool::shared().give(std::move(m_data));
+        m_data = std::string();
+    }
+
+    void reserve(size_t size) { m_data.reserve(size); }
+    void append(const char* data, size_t size) { m_data.append(data, size); }
+    void clear() { m_data.clear(); }
+
+    size_t size() const { return m_data.size(); }
+    size_t capacity() const { return m_data.capacity(); }
+    bool empty() const { return m_data.empty(); }
+    const char* data() const { return m_data.data(); }
+    std::string_view view() const { return m_data; }
+    const std::string& str() const { return m_data; }
+
+private:
+    std::string m_data;
+};
+
+#endif
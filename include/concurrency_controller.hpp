@@ -0,0 +1,94 @@
+#ifndef CONCURRENCY_CONTROLLER_HPP
+#define CONCURRENCY_CONTROLLER_HPP
+
+#include <string>
+#include <unordered_map>
+#include <mutex>
+#include <chrono>
+#include <cstddef>
+
+// How a single fetch ended, as seen by the concurrency controller.
+enum class FetchOutcome {
+    Success,    // Got a response that is not a rate-limit signal
+    Throttled,  // Server asked us to back off (429 / 503)
+    Error       // Transport failure (timeout, reset, DNS, ...)
+};
+
+struct ConcurrencyLimits {
+    size_t minLimit = 1;
+    size_t initialLimit = 4;
+    size_t maxLimit = 32;
+    size_t hostInitialLimit = 2;
+    size_t hostMaxLimit = 8;
+};
+
+// Adapts the number of in-flight fetches during a crawl, both overall and per host.
+//
+// Each limiter uses AIMD driven by a latency gradient in the style of TCP Vegas:
+// the limit grows by roughly one slot per "round" of completed fetches while the
+// smoothed latency stays close to the best latency seen, shrinks by one when the
+// latency inflates (queueing at the server), and is halved on errors or 429/503.
+// After a decrease the limit is held for one latency window (at least 100ms).
+//
+// Errors and rate limits are one host's business and only halve that host's
+// limit. The global limit follows latency alone: it shrinks when most recent
+// samples come from hosts whose own latency is inflating (congestion on our
+// side), not when a single host is slow. Limiters of idle hosts are dropped
+// once more than kMaxHosts are tracked.
+class ConcurrencyController {
+public:
+    // Host limiters kept before idle ones are evicted.
+    static constexpr size_t kMaxHosts {10000};
+
+    explicit ConcurrencyController(const ConcurrencyLimits& limits = {});
+
+    // Reserves a fetch slot for the host. Returns false if either the global or
+    // the host limit is currently saturated.
+    bool tryAcquire(const std::string& host);
+    // Returns the slot taken by tryAcquire() and feeds the sample to the limiters.
+    void release(const std::string& host, FetchOutcome outcome, std::chrono::milliseconds latency);
+    // Returns a slot that was acquired but never used for a fetch; no sample is recorded.
+    void cancel(const std::string& host);
+
+    // True if the global limit has room, regardless of host.
+    bool hasCapacity() const;
+    size_t limit() const;
+    size_t inFlight() const;
+    size_t hostLimit(const std::string& host) const;
+    // Hosts with fetches in flight, and how many each.
+    std::unordered_map<std::string, size_t> inFlightByHost() const;
+    // Upper bound for the global limit fixed at construction (one fetch thread each).
+    size_t maxLimit() const { return m_limits.maxLimit; }
+    // Hosts whose limiter is currently kept.
+    size_t trackedHosts() const;
+
+    // Caps the adaptive global limit at runtime, within [minLimit, maxLimit].
+    // Returns the ceiling in effect.
+    size_t setCeiling(size_t ceiling);
+    size_t ceiling() const;
+
+private:
+    struct Limiter {
+        double limit = 1.0;
+        size_t inFlight = 0;
+        double minLatencyMs = 0.0;   // Best latency observed (no-load estimate)
+        double smoothedLatencyMs = 0.0;
+        // Global limiter only: smoothed share of samples from queueing hosts
+        double queueingShare = 0.0;
+        std::chrono::steady_clock::time_point lastDecrease {};
+        std::chrono::steady_clock::time_point lastUsed {};
+    };
+
+    static void observe(Limiter& limiter, double latencyMs);
+    static void adjust(Limiter& limiter, size_t minLimit, size_t maxLimit, FetchOutcome outcome, bool queueing);
+    void evictIdleHosts(std::chrono::steady_clock::time_point now);
+
+    ConcurrencyLimits m_limits;
+    size_t m_ceiling;
+    Limiter m_global;
+    std::unordered_map<std::string, Limiter> m_hosts;
+    size_t m_evictAt;  // m_hosts size that triggers the next eviction pass
+    mutable std::mutex m_mutex;
+};
+
+#endif
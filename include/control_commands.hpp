@@ -0,0 +1,22 @@
+#ifndef CONTROL_COMMANDS_HPP
+#define CONTROL_COMMANDS_HPP
+
+#include "control_server.hpp"
+#include "crawler.hpp"
+
+#include <string>
+#include <vector>
+#include <functional>
+
+// Writes out buffered results; on failure fills error and returns false.
+using ResultFlush = std::function<bool(std::string& error)>;
+
+// Adds the runtime commands of a crawl to server: stats, hosts, concurrency,
+// pause, resume, budget and flush. crawler and flushResults must outlive it.
+// Stats come from the crawler's published snapshot, so they need a stats interval.
+void addCrawlCommands(ControlServer& server, WebCrawler& crawler, ResultFlush flushResults);
+
+// Parses a control command's single count argument, without printing anything.
+bool parseControlCount(const std::vector<std::string>& args, size_t& out);
+
+#endif
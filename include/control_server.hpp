@@ -0,0 +1,50 @@
+#ifndef CONTROL_SERVER_HPP
+#define CONTROL_SERVER_HPP
+
+#include <string>
+#include <vector>
+#include <map>
+#include <functional>
+#include <thread>
+
+// Line-based control endpoint on a Unix domain socket, served by its own thread.
+//
+// A client sends one command per line ("pause example.com"); the reply is zero
+// or more lines of output followed by "OK", or "ERR <message>". Any number of
+// clients may be connected; commands run one at a time on the server thread,
+// and a client that does not read its replies never blocks the others.
+class ControlServer {
+public:
+    // Fills reply with the command's output, or the error message on failure.
+    using Handler = std::function<bool(const std::vector<std::string>& args, std::string& reply)>;
+
+    ControlServer() = default;
+    ~ControlServer();
+    ControlServer(const ControlServer&) = delete;
+    ControlServer& operator=(const ControlServer&) = delete;
+
+    // Commands must be added before start(). "help" is built in.
+    void addCommand(const std::string& name, const std::string& usage, Handler handler);
+
+    // Replaces a stale socket at path, but fails if anything else is there.
+    // The socket is created accessible to its owner only.
+    bool start(const std::string& path);
+    void stop();
+
+private:
+    struct Command {
+        std::string usage;
+        Handler handler;
+    };
+
+    void serve();
+    std::string execute(const std::string& line);
+
+    std::map<std::string, Command> m_commands;  // Sorted, for help
+    std::string m_path;
+    int m_listenFd = -1;
+    int m_wakePipe[2] {-1, -1};  // Written by stop() to end the poll loop
+    std::thread m_thread;
+};
+
+#endif
@@ -0,0 +1,65 @@
+#ifndef CRAWL_BUDGET_HPP
+#define CRAWL_BUDGET_HPP
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <unordered_map>
+#include <utility>
+#include <atomic>
+#include <mutex>
+
+// Page budgets for a crawl. Depths and prefixes without an entry are unlimited.
+struct BudgetLimits {
+    size_t maxPages = 100;
+    size_t maxPagesPerHost = 0;  // 0 means unlimited
+    // depth -> pages fetched at that depth (seeds are depth 0)
+    std::unordered_map<size_t, size_t> maxPagesPerDepth;
+    // "host/path/prefix" -> pages fetched under it
+    std::vector<std::pair<std::string, size_t>> maxPagesPerPrefix;
+};
+
+// Tracks how much of each budget has been spent.
+//
+// A worker reserves a fetch slot *before* it pops a URL: tryReserve() is a single
+// CAS on the global counter, so the total number of fetches can never overshoot
+// maxPages no matter how many workers race for the last slot. Scoped quotas
+// (host, depth, path prefix) are reserved together for the chosen URL. A
+// global slot that finds nothing admissible is handed back with release().
+// Once a URL holds its slots every outcome is a page (retries keep them, and
+// failures are reported too), so scoped reservations are never returned.
+class CrawlBudget {
+public:
+    explicit CrawlBudget(BudgetLimits limits = {});
+
+    // Global slot. Lock-free; fails once every page of the budget is reserved.
+    bool tryReserve();
+    void release();
+
+    // Scoped quotas for one URL. Takes all of them or none.
+    bool tryReserveScoped(const std::string& host, size_t depth, std::string_view url);
+    // True if the scoped quotas still have room for the URL (nothing is reserved).
+    bool admits(const std::string& host, size_t depth, std::string_view url) const;
+
+    bool exhausted() const { return m_reserved.load(std::memory_order_acquire) >= m_maxPages.load(std::memory_order_acquire); }
+    size_t reserved() const { return m_reserved.load(std::memory_order_relaxed); }
+    size_t maxPages() const { return m_maxPages.load(std::memory_order_relaxed); }
+    // Raises the global page limit while the crawl runs; never lowers it.
+    // Returns the limit in effect.
+    size_t raise(size_t maxPages);
+
+private:
+    bool hasScopedLimits() const;
+    bool admitsLocked(const std::string& host, size_t depth, std::string_view hostPath) const;
+
+    std::atomic<size_t> m_reserved{0};
+    std::atomic<size_t> m_maxPages;
+
+    BudgetLimits m_limits;
+    std::unordered_map<std::string, size_t> m_hostPages;
+    std::unordered_map<size_t, size_t> m_depthPages;
+    std::vector<size_t> m_prefixPages;  // Parallel to m_limits.maxPagesPerPrefix
+    mutable std::mutex m_scopedMutex;
+};
+
+#endif
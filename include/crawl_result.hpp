@@ -0,0 +1,16 @@
+#ifndef CRAWL_RESULT_HPP
+#define CRAWL_RESULT_HPP
+
+#include <string>
+#include <ctime>
+
+struct CrawlResult {
+    std::string url;
+    std::string title;
+    long status;
+    size_t linkCount;
+    std::string error;
+    std::time_t lastModified = 0;  // Sitemap <lastmod> of the URL, 0 if unknown
+};
+
+#endif
@@ -1,61 +1,196 @@
 #ifndef CRAWLER_HPP
 #define CRAWLER_HPP
 
+#include "crawl_result.hpp"
 #include "http_client.hpp"
 #include "parse.hpp"
+#include "concurrency_controller.hpp"
+#include "domain_filter.hpp"
+#include "inverted_index.hpp"
+#include "crawl_budget.hpp"
+#include "bounded_channel.hpp"
+#include "url_canonicalizer.hpp"
+#include "trap_detector.hpp"
+#include "retry_policy.hpp"
+#include "timer_wheel.hpp"
+#include "snapshot_slot.hpp"
+#include "host_resolver.hpp"
 
 #include <string>
 #include <vector>
-#include <queue>
+#include <deque>
 #include <unordered_set>
+#include <unordered_map>
 #include <mutex>
 #include <thread>
 #include <atomic>
 #include <condition_variable>
 #include <memory>
-
-struct CrawlResult {
-    std::string url;
-    std::string title;
-    long status;
-    size_t linkCount;
-    std::string error;
-};
+#include <functional>
+#include <chrono>
+#include <ctime>
 
 // Frontier entry: stores URL and metadata about the page that linked to it
 struct FrontierEntry {
     std::string url;
+    std::string host;         // Host part of url, used for per-host concurrency
     std::string referrerUrl;  // URL of the page that contained this link
     std::string referrerTitle; // Title of the referring page
+    std::time_t lastModified = 0; // Sitemap <lastmod>, 0 if unknown
+    size_t depth = 0;             // Link hops from a seed
+    UrlShape shape;               // Template and path shape, for trap detection
+    uint8_t attempts = 0;         // Failed fetches so far
+};
+
+// A URL waiting on the timer wheel for another fetch attempt. It keeps its
+// budget reservation and still counts as an active page meanwhile.
+struct RetryItem {
+    FrontierEntry entry;
+    std::string lastError;  // Reported if the retry never happens
+};
+
+// A fetched page on its way from the fetch stage to the parse stage.
+struct FetchedPage {
+    FrontierEntry entry;
+    HttpResult http;
+    std::string error;
+    bool ok = false;  // False if the transfer itself failed
+};
+
+// A parsed page on its way to the dedup/enqueue stage.
+struct ParsedLinks {
+    CrawlResult result;
+    std::string host;
+    UrlShape shape;                    // Of the page itself, to credit its template with the links
+    std::vector<FrontierEntry> links;  // Resolved, normalized and in scope
+    std::string canonicalUrl;          // rel=canonical of the page, if it differs from its URL
+};
+
+// Receives every finished page, in completion order, on the result sink thread.
+using ResultSink = std::function<void(const CrawlResult&)>;
+
+struct HostSnapshot {
+    std::string host;
+    size_t queued = 0;    // URLs waiting in the frontier (or the paused queue)
+    size_t inFlight = 0;  // Fetches running right now
+    bool paused = false;
+};
+
+// Crawl state published by the stats thread. Immutable once published, so
+// any number of readers can hold one without touching the crawler's locks.
+struct CrawlSnapshot {
+    double elapsedSeconds = 0.0;
+    size_t pagesCrawled = 0;
+    double pagesPerSecond = 0.0;         // Over the last stats interval
+    double averagePagesPerSecond = 0.0;  // Since start()
+    size_t frontierSize = 0;
+    size_t pausedUrls = 0;
+    size_t activePages = 0;      // Taken off the frontier, links not enqueued yet
+    size_t waitingRetries = 0;   // On the timer wheel or ready to be fetched again
+    size_t retriesScheduled = 0;
+    size_t inFlight = 0;
+    size_t concurrencyLimit = 0;
+    size_t concurrencyCeiling = 0;
+    size_t budgetReserved = 0;
+    size_t budgetMax = 0;
+    bool finished = false;
+    std::vector<HostSnapshot> hosts;  // Paused, fetching, and the busiest queued hosts
 };
 
 class WebCrawler {
 public:
-    WebCrawler(size_t numThreads = 4, size_t maxPages = 100);
+    WebCrawler(const ConcurrencyLimits& limits = {}, const BudgetLimits& budget = {});
     ~WebCrawler();
     
+    // Seeds and the domain filter must be set up before start().
+    void setDomainFilter(DomainFilter filter);
+    void setCanonicalizer(UrlCanonicalizer canonicalizer) { m_canonicalizer = std::move(canonicalizer); }
+    // Log every URL the trap detector throttles or drops.
+    bool setTrapLog(const std::string& path) { return m_trapDetector.openLog(path); }
+    // Fixed addresses for some hosts, in /etc/hosts format; checked before DNS.
+    bool loadHostsFile(const std::string& path) { return m_resolver.loadHostsFile(path); }
+    // Resolve hosts with this instead of the system resolver (e.g. a stub for offline tests).
+    void setResolveFunction(HostResolver::ResolveFunction resolve) { m_resolver.setResolveFunction(std::move(resolve)); }
+    size_t addSeeds(const std::vector<std::string>& urls);
+    // Loads one URL per line from a (possibly huge) file via mmap, in parallel.
+    size_t loadSeedFile(const std::string& path);
+    // Also fill the frontier from the sitemaps of every seed host.
+    void setSitemapDiscovery(bool enabled) { m_sitemapDiscovery = enabled; }
+    // Feed the visible text of every 2XX page to an index builder (not owned).
+    void setIndexBuilder(IndexBuilder* indexer) { m_indexer = indexer; }
+    // Threads that parse pages and process links; 0 means one per core.
+    void setParseThreads(size_t count) { m_parseThreadCount = count; }
+    // Stream results to a callback instead of keeping them for getResults().
+    void setResultSink(ResultSink sink) { m_resultSink = std::move(sink); }
+    // Publish a CrawlSnapshot this often while crawling; zero (the default) disables it.
+    void setStatsInterval(std::chrono::milliseconds interval) { m_statsInterval = interval; }
+    
+    void start();
     void start(const std::string& startUrl);
     void stop();
     std::vector<CrawlResult> getResults() const;
+    size_t pagesCrawled() const { return m_pagesCrawled; }
+    size_t retriesScheduled() const { return m_retriesScheduled; }
+    // URLs dropped from the frontier because their host did not resolve.
+    size_t unresolvedUrls() const { return m_unresolvedUrls; }
+    // Latest published snapshot (null before the first one). Lock-free for readers.
+    std::shared_ptr<const CrawlSnapshot> snapshot() const { return m_snapshot.load(); }
+    
+    // Runtime controls, safe to call from any thread while start() runs.
+    // Caps the adaptive fetch concurrency; returns the cap in effect.
+    size_t setConcurrencyCeiling(size_t ceiling);
+    // Parks the host's queued URLs until it is resumed; running fetches finish.
+    // The crawl does not end while a paused host has URLs queued.
+    bool pauseHost(const std::string& host);
+    bool resumeHost(const std::string& host);
+    // Raises the page budget; returns the budget in effect.
+    size_t raiseBudget(size_t maxPages);
+    
+    // Only read after start() has returned.
+    const TrapDetector& trapDetector() const { return m_trapDetector; }
+    const HostResolver& resolver() const { return m_resolver; }
+    const UrlCanonicalizer& canonicalizer() const { return m_canonicalizer; }
     
 private:
-    void workerThread();
-    bool shouldCrawl(const std::string& url);
+    // Pipeline stages, in order: fetch -> parse/links -> dedup/enqueue -> result sink
+    void fetchWorker();
+    void parseWorker();
+    void enqueueWorker();
+    void sinkWorker();
+    void retryWorker();
+    void statsWorker();
+    void publishSnapshot(double pagesPerSecond, bool finished);
+    void pushFrontier(FrontierEntry&& entry);
+    void notifyFetchers(size_t available);
+    void untrackQueued(const std::string& host);
+    void scheduleRetry(RetryItem item, std::chrono::steady_clock::time_point deadline);
+    void abandonRetries();
+    std::vector<FrontierEntry> collectLinks(const FrontierEntry& target, const std::string& title,
+                                            const std::vector<std::string>& links);
+    size_t enqueueLinks(std::vector<FrontierEntry>& links, uint64_t sourcePattern,
+                        size_t& newLinks, size_t& selfLinks);
+    bool shouldCrawl(const std::string& host) const;
+    size_t enqueueSeeds(std::vector<std::vector<FrontierEntry>>& batches);
     std::string resolveUrl(const std::string& baseUrl, const std::string& relativeUrl);
     std::string normalizeUrl(const std::string& url);
-    void processUrl(const std::string& url);
-    bool isFrontierEmpty() const;
+    static std::string extractHost(const std::string& url);
+    void sitemapWorker();
+    bool enqueueBatch(std::vector<FrontierEntry>& entries);
+    bool popAdmissibleEntry(FrontierEntry& entry);
+    bool popReadyRetry(FrontierEntry& entry);
+    bool isCrawlFinished() const;
     void markWorkerActive();
     void markWorkerIdle();
     
-    size_t m_numThreads;
-    size_t m_maxPages;
+    // Page budget; fetch slots are reserved before a URL leaves the frontier
+    CrawlBudget m_budget;
     std::atomic<size_t> m_pagesCrawled{0};
+    // Pages taken off the frontier whose links are not enqueued yet, plus running sitemap threads
     std::atomic<size_t> m_activeWorkers{0};
     std::atomic<bool> m_shouldStop{false};
     
     // Frontier queue: URLs waiting to be crawled
-    std::queue<FrontierEntry> m_frontier;
+    std::deque<FrontierEntry> m_frontier;
     // Visited URLs: tracks all URLs we've already crawled or added to frontier
     std::unordered_set<std::string> m_visitedUrls;
     // Results: stores all crawled page information
@@ -65,8 +200,70 @@ private:
     mutable std::mutex m_resultsMutex;
     std::condition_variable m_frontierCondition;
     
+    // Adapts how many fetches run at once; one fetch thread per possible slot
+    ConcurrencyController m_concurrency;
+    
     std::vector<std::thread> m_threads;
-    std::string m_baseDomain;
+    
+    // Bounded channels between the stages. A full channel blocks the stage
+    // before it, so a slow parser throttles fetching instead of piling up pages.
+    std::unique_ptr<BoundedChannel<FetchedPage>> m_parseQueue;
+    std::unique_ptr<BoundedChannel<ParsedLinks>> m_enqueueQueue;
+    std::unique_ptr<BoundedChannel<CrawlResult>> m_sinkQueue;
+    std::vector<std::thread> m_parseThreads;
+    std::thread m_enqueueThread;
+    std::thread m_sinkThread;
+    size_t m_parseThreadCount = 0;
+    ResultSink m_resultSink;
+    
+    // Collapses URL variants before they reach the visited set
+    UrlCanonicalizer m_canonicalizer;
+    // Keeps unbounded URL spaces out of the frontier; guarded by m_frontierMutex
+    TrapDetector m_trapDetector;
+    
+    // Failed fetches wait on the timer wheel, owned by the retry thread, and
+    // then move to m_readyRetries, which fetch threads serve before the frontier
+    HostHealth m_hostHealth;
+    TimerWheel<RetryItem> m_retryWheel;
+    std::mutex m_retryMutex;
+    std::condition_variable m_retryCondition;
+    bool m_retryStop = false;
+    std::thread m_retryThread;
+    std::deque<RetryItem> m_readyRetries;  // Guarded by m_frontierMutex
+    std::atomic<size_t> m_retriesScheduled{0};
+    std::atomic<size_t> m_unresolvedUrls{0};
+    
+    // Hosts paused by the control server, with their parked URLs, and per-host
+    // frontier counts for the snapshots; all guarded by m_frontierMutex
+    std::unordered_map<std::string, std::deque<FrontierEntry>> m_pausedHosts;
+    size_t m_pausedUrls = 0;
+    std::unordered_map<std::string, size_t> m_hostQueued;
+    bool m_trackHosts = false;  // Only kept up to date while snapshots are enabled
+    
+    // Snapshot publishing
+    std::chrono::milliseconds m_statsInterval{0};
+    std::chrono::steady_clock::time_point m_crawlStart;
+    SnapshotSlot<CrawlSnapshot> m_snapshot;
+    std::mutex m_statsMutex;
+    std::condition_variable m_statsCondition;
+    bool m_statsStop = false;
+    std::thread m_statsThread;
+    
+    // Resolves the hosts of frontier URLs before they are fetched
+    HostResolver m_resolver;
+    
+    // Allow/block lists. Without explicit allow rules, only the seed hosts are crawled.
+    DomainFilter m_domainFilter;
+    bool m_allowSeedHostsOnly = true;
+    
+    // Sitemap ingestion: one root URL per distinct seed host, claimed by index
+    bool m_sitemapDiscovery = false;
+    std::vector<std::string> m_seedSites;
+    std::unordered_set<std::string> m_seedHosts;
+    std::atomic<size_t> m_nextSitemapSite{0};
+    std::vector<std::thread> m_sitemapThreads;
+    
+    IndexBuilder* m_indexer = nullptr;
 };
 
 #endif
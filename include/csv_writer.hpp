@@ -1,11 +1,12 @@
 #ifndef CSV_WRITER_HPP
 #define CSV_WRITER_HPP
 
-#include "crawler.hpp"
+#include "crawl_result.hpp"
 
 #include <string>
 #include <vector>
 #include <fstream>
+#include <ctime>
 
 class CsvWriter {
 public:
@@ -18,6 +19,7 @@ public:
     
 private:
     std::string escapeCsvField(const std::string& field);
+    std::string formatTimestamp(std::time_t timestamp);
     
     std::ofstream m_file;
     std::string m_filename;
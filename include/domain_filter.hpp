@@ -0,0 +1,61 @@
+#ifndef DOMAIN_FILTER_HPP
+#define DOMAIN_FILTER_HPP
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <utility>
+#include <cstdint>
+
+// Allow/block lists of domains compiled into a trie keyed by reversed host labels
+// ("www.example.com" is stored as com -> example -> www).
+//
+// Pattern syntax, one per line in list files ('#' starts a comment):
+//   example.com     matches exactly example.com
+//   *.example.com   matches any subdomain of example.com, but not example.com
+//   .example.com    matches example.com and all of its subdomains
+//
+// A host check walks at most one trie node per label and never allocates.
+class DomainFilter {
+public:
+    DomainFilter();
+
+    void allow(std::string_view pattern);
+    void block(std::string_view pattern);
+    // Same as allow() for each pattern, but sorts every touched node once at the
+    // end instead of inserting into its sorted children one pattern at a time.
+    void allowAll(const std::vector<std::string_view>& patterns);
+    bool loadAllowList(const std::string& path);
+    bool loadBlockList(const std::string& path);
+
+    // Block rules win over allow rules. With no allow rules every unblocked host is allowed.
+    bool isAllowed(std::string_view host) const;
+    bool isBlocked(std::string_view host) const;
+    bool hasAllowRules() const { return m_allowRules > 0; }
+
+private:
+    enum : uint8_t {
+        kMatchExact = 1,
+        kMatchSubdomains = 2
+    };
+
+    struct Node {
+        // Sorted by label so lookups can binary search.
+        std::vector<std::pair<std::string, uint32_t>> children;
+        uint8_t allowFlags = 0;
+        uint8_t blockFlags = 0;
+    };
+
+    struct BulkInsert;
+
+    void insert(std::string_view pattern, bool blockRule, BulkInsert* bulk = nullptr);
+    bool loadList(const std::string& path, bool blockRule);
+    uint32_t findChild(uint32_t node, std::string_view label) const;
+    // Returns the allow/block flags that apply to host, as {allowed, blocked}.
+    std::pair<bool, bool> match(std::string_view host) const;
+
+    std::vector<Node> m_nodes;
+    size_t m_allowRules = 0;
+};
+
+#endif
@@ -0,0 +1,18 @@
+#ifndef FNV1A_HPP
+#define FNV1A_HPP
+
+#include <string_view>
+#include <cstdint>
+
+// 64-bit FNV-1a: fast, stable across runs and platforms, and good enough for
+// grouping and sampling (not for anything adversarial).
+inline uint64_t fnv1a64(std::string_view text) {
+    uint64_t hash {14695981039346656037ull};
+    for (unsigned char c : text) {
+        hash ^= c;
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+#endif
@@ -0,0 +1,94 @@
+#ifndef HOST_RESOLVER_HPP
+#define HOST_RESOLVER_HPP
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <unordered_map>
+#include <functional>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <atomic>
+#include <chrono>
+
+// Resolves hosts ahead of their fetches, on its own threads, into a table
+// shared by every fetch thread.
+//
+// Hosts are requested as their URLs enter the frontier, so lookups run in
+// frontier order well before a fetch thread reaches them. Fetches then pin the
+// cached addresses with CURLOPT_RESOLVE and never wait on DNS. Failures are
+// cached too, so URLs of unresolvable hosts are dropped without taking a page
+// of budget or a fetch slot.
+//
+// The system resolver reports no TTLs; answers are kept for kDnsTtl (failures
+// for kDnsNegativeTtl) and served stale while a refresh runs. Names from a
+// hosts-style override file never expire and never reach the resolver.
+class HostResolver {
+public:
+    enum class State {
+        Unknown,   // Never requested
+        Pending,   // Lookup queued or running
+        Resolved,
+        Failed
+    };
+
+    // Fills addresses, or error on failure. The default calls getaddrinfo.
+    using ResolveFunction = std::function<bool(const std::string& host, std::vector<std::string>& addresses,
+                                               std::string& error)>;
+
+    HostResolver();
+    ~HostResolver();
+    HostResolver(const HostResolver&) = delete;
+    HostResolver& operator=(const HostResolver&) = delete;
+
+    // "address name [name...]" lines, as in /etc/hosts.
+    bool loadHostsFile(const std::string& path);
+    // Replaces the system resolver, e.g. with an offline stub. Call before start().
+    void setResolveFunction(ResolveFunction resolve) { m_resolve = std::move(resolve); }
+    // Called on a resolver thread after every finished lookup.
+    void setOnResolved(std::function<void()> onResolved) { m_onResolved = std::move(onResolved); }
+
+    void start(size_t threads);
+    void stop();
+
+    // Never blocks on DNS. Queues a lookup for an unknown or expired host;
+    // an expired answer stays Resolved while it is refreshed.
+    State request(const std::string& host);
+    // Cached addresses or the cached error; does not queue anything.
+    State lookup(const std::string& host, std::vector<std::string>& addresses, std::string& error) const;
+
+    // Lookups done by the resolver threads (refreshes included), and how many failed.
+    size_t lookups() const { return m_lookups; }
+    size_t failedLookups() const { return m_failedLookups; }
+
+private:
+    struct Entry {
+        State state = State::Unknown;
+        bool refreshing = false;  // Resolved, expired, and being looked up again
+        bool pinned = false;      // Hosts file entry or IP literal; never expires
+        std::vector<std::string> addresses;
+        std::string error;
+        std::chrono::steady_clock::time_point expires {};
+    };
+
+    void resolverThread();
+
+    std::unordered_map<std::string, Entry> m_hosts;
+    std::deque<std::string> m_queue;
+    mutable std::mutex m_mutex;
+    std::condition_variable m_queueCondition;
+    bool m_stop = false;
+    std::vector<std::thread> m_threads;
+
+    ResolveFunction m_resolve;
+    std::function<void()> m_onResolved;
+    std::atomic<size_t> m_lookups{0};
+    std::atomic<size_t> m_failedLookups{0};
+};
+
+// CURLOPT_RESOLVE entry ("host:port:addr,addr") pinning url's host to addresses.
+// Empty if the URL cannot be parsed.
+std::string resolveEntry(const std::string& url, const std::string& host, const std::vector<std::string>& addresses);
+
+#endif
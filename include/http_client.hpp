@@ -1,15 +1,65 @@
 #ifndef HTTP_HPP
 #define HTTP_HPP
 
+#include "buffer_pool.hpp"
+
 #include <string>
+#include <string_view>
 #include <curl/curl.h>
 #include <vector>
+#include <functional>
+#include <optional>
+#include <chrono>
+#include <cstdint>
+
+// Header lines of the final response (after redirects), stored as received in
+// one pooled buffer. Nothing is parsed while the transfer runs, and lookups
+// scan the buffer in place, so a response allocates nothing for its headers.
+// Returned views point into the buffer and are valid until it changes.
+class HttpHeaders {
+public:
+    // Adds one raw header line; a status line starts a new response.
+    void append(std::string_view line);
+    void clear();
+
+    // Case-insensitive lookup of the first field with this name, without the
+    // surrounding whitespace. Empty if the header is missing.
+    std::string_view get(std::string_view name) const;
+    std::string_view contentType() const { return get("Content-Type"); }
+    std::string_view etag() const { return get("ETag"); }
+    std::string_view lastModified() const { return get("Last-Modified"); }
+    std::string_view location() const { return get("Location"); }
+    std::string_view retryAfter() const { return get("Retry-After"); }
+    // Empty if the header is missing, malformed or does not fit in 64 bits.
+    std::optional<uint64_t> contentLength() const;
+
+    // Header lines without the status line, as "Name: value". Each call scans
+    // the lines before index; responses carry a few dozen at most.
+    size_t size() const;
+    std::string_view line(size_t index) const;
+
+private:
+    // Calls onLine for each header line until it returns false.
+    template <typename F>
+    void forEachLine(F&& onLine) const;
+
+    PooledBuffer m_raw;
+};
 
 struct HttpResult {
     long status = 0;
+    CURLcode curlCode = CURLE_OK;  // Why the transfer failed, if it did
     std::string url {};
-    std::string body {};
-    std::vector<std::string> headers {};
+    PooledBuffer body {};
+    HttpHeaders headers {};
+};
+
+// Per-request settings; the default timeouts are the crawler's historical fixed ones.
+struct FetchOptions {
+    std::chrono::milliseconds timeout {20000};
+    std::chrono::milliseconds connectTimeout {10000};
+    // CURLOPT_RESOLVE entries ("host:port:addr[,addr]"), so the transfer skips DNS
+    std::vector<std::string> resolve;
 };
 
 // RAII deleters.
@@ -25,7 +75,16 @@ struct SlistDeleter {
     }
 };
 
-bool getHttp(const std::string& url, HttpResult& output, std::string& error);
+// Receives response body chunks; returning false aborts the transfer.
+using BodySink = std::function<bool(const char* data, size_t size)>;
+
+// Bytes to reserve for a body of contentLength bytes: all of it up to a cap,
+// so a bogus header cannot force a huge allocation.
+size_t bodyPresize(std::optional<uint64_t> contentLength);
+
+bool getHttp(const std::string& url, HttpResult& output, std::string& error, const FetchOptions& options = {});
+bool streamHttp(const std::string& url, const BodySink& sink, long& status, std::string& error);
 bool getRobots(const std::string& url, HttpResult& output, std::string& error);
+std::optional<std::string> buildHostUrl(const std::string& url, const char* path);
 
 #endif
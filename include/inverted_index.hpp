@@ -0,0 +1,154 @@
+#ifndef INVERTED_INDEX_HPP
+#define INVERTED_INDEX_HPP
+
+#include "mapped_file.hpp"
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <deque>
+#include <unordered_map>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <atomic>
+#include <condition_variable>
+#include <fstream>
+#include <cstdint>
+
+// On-disk layout of a finished index directory:
+//   terms.bin     "CRIDX001", then per term in sorted order:
+//                 varint length, term bytes, varint document frequency, varint postings offset
+//   postings.bin  per term, blocks of up to kPostingsBlockSize postings:
+//                 varint count, varint last docId, varint payload bytes,
+//                 payload = docId deltas (varint), then term frequencies (varint)
+//   docs.tsv      "docId<TAB>url" lines, in no particular order
+// The per-block last docId and byte length let readers skip blocks when intersecting.
+
+constexpr char kIndexMagic[] {"CRIDX001"};
+constexpr size_t kPostingsBlockSize {128};
+
+struct Posting {
+    uint32_t docId;
+    uint32_t termFrequency;
+};
+
+// Splits text into lowercase terms. ASCII letters and digits form words; bytes of
+// multi-byte UTF-8 sequences are kept as word characters and left untouched.
+void tokenize(std::string_view text, const std::function<void(std::string_view term)>& onTerm);
+
+struct IndexOptions {
+    std::string directory;
+    size_t numThreads = 2;             // Indexing threads, each with its own postings buffer
+    size_t runBytes = 32u << 20;       // Buffer size at which a thread writes a sorted run
+    size_t queueCapacity = 4096;       // Documents waiting to be indexed
+    size_t mergeFanIn = 8;             // Runs merged at once by the background merger
+};
+
+// Builds an inverted index from crawled pages.
+//
+// addDocument() only queues the text; indexing threads tokenize it into private
+// in-memory postings buffers and spill them to sorted run files when they grow
+// past runBytes. A background thread k-way merges runs as they accumulate, and
+// finish() merges what is left into the block-compressed final index.
+class IndexBuilder {
+public:
+    explicit IndexBuilder(IndexOptions options);
+    ~IndexBuilder();
+    IndexBuilder(const IndexBuilder&) = delete;
+    IndexBuilder& operator=(const IndexBuilder&) = delete;
+
+    bool start();
+    // Thread-safe. Blocks only when queueCapacity documents are already waiting.
+    void addDocument(const std::string& url, std::string text);
+    // Asks every indexing thread to spill its buffer to a run now.
+    void flush();
+    // Drains the queue and writes the final index. Returns false on I/O errors.
+    bool finish();
+
+    size_t documentCount() const { return m_nextDocId; }
+
+private:
+    struct Document {
+        uint32_t id;
+        std::string url;
+        std::string text;
+    };
+
+    struct RunFile {
+        std::string path;
+        uint64_t bytes;
+    };
+
+    // Transparent hashing lets terms be looked up by string_view without a copy.
+    struct TermHash {
+        using is_transparent = void;
+        size_t operator()(std::string_view term) const { return std::hash<std::string_view>{}(term); }
+    };
+    using PostingsBuffer = std::unordered_map<std::string, std::vector<Posting>, TermHash, std::equal_to<>>;
+
+    void indexerThread();
+    void mergerThread();
+    bool writeRun(PostingsBuffer& buffer);
+    void addRun(RunFile run);
+    bool mergeRuns(const std::vector<RunFile>& runs, const std::string& outPath, bool final);
+    std::string nextRunPath();
+
+    IndexOptions m_options;
+    std::atomic<uint32_t> m_nextDocId{0};
+    std::atomic<uint64_t> m_nextRunId{0};
+    std::atomic<bool> m_failed{false};
+
+    std::deque<Document> m_queue;
+    std::mutex m_queueMutex;
+    std::condition_variable m_queueNotEmpty;
+    std::condition_variable m_queueNotFull;
+    bool m_finishing = false;
+    uint64_t m_flushGeneration = 0;
+    std::vector<std::thread> m_indexers;
+
+    std::ofstream m_docs;
+    std::mutex m_docsMutex;
+
+    std::vector<RunFile> m_runs;
+    std::mutex m_runsMutex;
+    std::condition_variable m_runsChanged;
+    bool m_indexersDone = false;
+    std::thread m_merger;
+    bool m_started = false;
+};
+
+// Read side of a finished index, used by the query tool.
+class IndexReader {
+public:
+    bool open(const std::string& directory);
+
+    size_t termCount() const { return m_terms.size(); }
+    size_t documentCount() const { return m_urls.size(); }
+    const std::string& url(uint32_t docId) const;
+
+    // All postings of a term (already normalized by tokenize()).
+    std::vector<Posting> postings(std::string_view term) const;
+
+    struct Hit {
+        uint32_t docId;
+        double score;
+    };
+    // Documents containing every query term, best tf-idf score first.
+    std::vector<Hit> search(const std::string& query, size_t limit) const;
+
+private:
+    struct TermInfo {
+        std::string term;
+        uint32_t documentFrequency;
+        uint64_t offset;
+    };
+
+    const TermInfo* findTerm(std::string_view term) const;
+
+    std::vector<TermInfo> m_terms;
+    std::vector<std::string> m_urls;
+    MappedFile m_postings;
+};
+
+#endif
@@ -0,0 +1,25 @@
+#ifndef MAPPED_FILE_HPP
+#define MAPPED_FILE_HPP
+
+#include <string>
+#include <string_view>
+
+// Read-only memory mapping of a whole file.
+class MappedFile {
+public:
+    MappedFile() = default;
+    ~MappedFile();
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    // Maps path, unmapping whatever was mapped before.
+    bool open(const std::string& path);
+    void close();
+    std::string_view data() const { return {m_data, m_size}; }
+
+private:
+    const char* m_data = nullptr;
+    size_t m_size = 0;
+};
+
+#endif
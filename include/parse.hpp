@@ -6,7 +6,16 @@
 #include <string>
 #include <vector>
 
+// Everything the crawler needs from one page, gathered in a single parse.
+struct ParsedPage {
+    std::string title;
+    std::vector<std::string> links;
+    std::string text;  // Visible body text, only filled when requested
+    std::string canonical;  // href of <link rel="canonical">, as written
+};
+
 std::string extractTitle(const std::string& html);
 std::vector<std::string> extractLinks(const std::string& html);
+ParsedPage parsePage(const std::string& html, bool withText);
 
 #endif
@@ -0,0 +1,124 @@
+#ifndef RESULT_FILE_HPP
+#define RESULT_FILE_HPP
+
+#include "crawl_result.hpp"
+#include "mapped_file.hpp"
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <fstream>
+#include <functional>
+#include <optional>
+#include <cstdint>
+#include <ctime>
+
+// Columnar crawl results (".ccr"), for filtering large crawls after the fact.
+//
+// On-disk layout:
+//   "CRCOL001"
+//   row groups of up to kResultRowGroupSize rows, each one chunk per column:
+//     url, title, error  front-coded string heap: per row varint shared prefix
+//                        length with the previous row, varint suffix length, suffix
+//     status             dictionary: varint entries, the distinct codes (varint),
+//                        then per row the varint dictionary index
+//     link count         per row a varint
+//     last modified      per row a zigzag varint
+//   footer: varint row group count, then per row group: varint rows, varint
+//     offset of each column chunk and of the group's end, varint min/max of
+//     status, link count and last modified (zigzag)
+//   8-byte little-endian footer offset, "CRCOL001"
+// Readers map the file, read the footer, and use the per-group min/max and the
+// status dictionary to skip row groups and columns a query does not need.
+
+constexpr char kResultFileMagic[] {"CRCOL001"};
+constexpr size_t kResultRowGroupSize {65536};
+
+enum class ResultColumn : uint8_t {
+    Url,
+    Title,
+    Error,
+    Status,
+    LinkCount,
+    LastModified,
+    Count
+};
+
+struct RowGroupInfo {
+    uint64_t rows = 0;
+    uint64_t offsets[static_cast<size_t>(ResultColumn::Count) + 1] {};  // Chunk starts, then the group's end
+    long minStatus = 0;
+    long maxStatus = 0;
+    uint64_t minLinkCount = 0;
+    uint64_t maxLinkCount = 0;
+    std::time_t minLastModified = 0;
+    std::time_t maxLastModified = 0;
+};
+
+// Writes results as they arrive; a row group is encoded whenever it is full.
+class ResultFileWriter {
+public:
+    ResultFileWriter(const std::string& filename);
+    ~ResultFileWriter();
+
+    bool writeHeader();
+    bool writeResult(const CrawlResult& result);
+    // Writes the buffered rows as a (short) row group and flushes the stream, so
+    // they survive a crash. Readers still need the footer written by finish().
+    bool flush();
+    // Writes the last row group and the footer. The file is unreadable without it.
+    bool finish();
+
+private:
+    bool writeRowGroup();
+
+    std::ofstream m_file;
+    std::string m_filename;
+    bool m_finished = false;
+    uint64_t m_offset = 0;
+    std::vector<RowGroupInfo> m_groups;
+
+    // Rows of the current group, encoded column by column once it is full
+    std::vector<CrawlResult> m_rows;
+};
+
+// Which rows a scan returns; unset fields match everything.
+struct ResultFilter {
+    std::optional<long> status;
+    uint64_t minLinkCount = 0;
+    uint64_t maxLinkCount = UINT64_MAX;
+};
+
+// Read side of a result file, backed by a read-only mapping.
+class ResultFileReader {
+public:
+    bool open(const std::string& path);
+
+    uint64_t rowCount() const { return m_rowCount; }
+    size_t rowGroupCount() const { return m_groups.size(); }
+    const RowGroupInfo& rowGroup(size_t group) const { return m_groups[group]; }
+
+    // Decode one column of a row group. Return false on corrupt data.
+    bool readStrings(size_t group, ResultColumn column, std::vector<std::string>& out) const;
+    bool readStatus(size_t group, std::vector<long>& out) const;
+    bool readLinkCounts(size_t group, std::vector<uint64_t>& out) const;
+    bool readLastModified(size_t group, std::vector<std::time_t>& out) const;
+
+    // Counts the matching rows, decoding only the status and link count columns.
+    // Returns nullopt on corrupt data.
+    std::optional<uint64_t> count(const ResultFilter& filter) const;
+    // Calls onRow for every matching row, in file order. String columns are only
+    // decoded for row groups that have a match. Returns false on corrupt data.
+    bool scan(const ResultFilter& filter, const std::function<void(const CrawlResult&)>& onRow) const;
+
+private:
+    std::string_view chunk(size_t group, ResultColumn column) const;
+    bool mayMatch(const RowGroupInfo& group, const ResultFilter& filter) const;
+    bool selectRows(size_t group, const ResultFilter& filter, std::vector<uint32_t>& rows) const;
+
+    MappedFile m_file;
+    std::vector<RowGroupInfo> m_groups;
+    uint64_t m_rowCount = 0;
+};
+
+#endif
@@ -0,0 +1,78 @@
+#ifndef RETRY_POLICY_HPP
+#define RETRY_POLICY_HPP
+
+#include "http_client.hpp"
+
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <array>
+#include <mutex>
+#include <chrono>
+#include <optional>
+#include <cstdint>
+
+enum class FailureClass {
+    None,       // Got a usable response (including 404 and friends)
+    Retryable,  // Timeouts, resets, 408/429/5XX: worth another try later
+    Permanent   // Bad URL, TLS verification, too many redirects, ...
+};
+
+FailureClass classifyFailure(bool transferOk, CURLcode code, long status);
+
+// Parses a Retry-After value: delta-seconds or an HTTP-date.
+std::optional<std::chrono::seconds> parseRetryAfter(std::string_view value);
+
+// Delay before retry number `attempt` (1 for the first retry): exponential
+// backoff with full jitter, or the server's Retry-After (capped) if it sent one.
+std::chrono::milliseconds retryDelay(unsigned attempt, std::optional<std::chrono::seconds> retryAfter);
+
+// Per-host failure and latency bookkeeping shared by the fetch threads.
+//
+// Circuit breaker: after several consecutive failures a host is "open" and
+// nothing is sent to it for a cooldown that doubles each time it trips again;
+// then one probe is let through (half-open) and a success closes it. A host
+// whose probes keep failing is given up on for the rest of the crawl.
+//
+// Timeouts: successful fetch latencies go into a per-host log-scale histogram.
+// Once there are enough samples the transfer timeout is a multiple of the 99th
+// percentile, so a slow but healthy host still gets its time and a stalled
+// connection to a fast host is given up early. Retries get longer timeouts.
+class HostHealth {
+public:
+    // False while the host's breaker is open, with retryAt set to when to ask
+    // again (time_point::max() once the host is given up on). Lets one probe
+    // through when the cooldown has passed.
+    bool allowRequest(const std::string& host, std::chrono::steady_clock::time_point& retryAt,
+                      std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now());
+
+    void recordSuccess(const std::string& host, std::chrono::milliseconds latency);
+    // timedOut: the failure was our own timeout, which also counts as a latency sample.
+    // retry: the URL failed before; only failures of distinct URLs (and of the
+    // half-open probe) move the breaker, so one broken page cannot trip it.
+    void recordFailure(const std::string& host, bool timedOut, std::chrono::milliseconds timeout, bool retry,
+                       std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now());
+
+    FetchOptions timeoutsFor(const std::string& host, unsigned attempt) const;
+
+private:
+    static constexpr size_t kLatencyBuckets {24};
+
+    enum class Breaker { Closed, Open, HalfOpen };
+
+    struct Host {
+        std::array<uint32_t, kLatencyBuckets> latency {};
+        uint32_t samples = 0;
+        uint32_t consecutiveFailures = 0;
+        uint32_t trips = 0;  // Times the breaker opened since the last success
+        Breaker breaker = Breaker::Closed;
+        std::chrono::steady_clock::time_point openUntil {};
+    };
+
+    void addLatency(Host& host, std::chrono::milliseconds latency);
+
+    std::unordered_map<std::string, Host> m_hosts;
+    mutable std::mutex m_mutex;
+};
+
+#endif
@@ -0,0 +1,14 @@
+#ifndef SEED_LOADER_HPP
+#define SEED_LOADER_HPP
+
+#include <string>
+#include <string_view>
+#include <functional>
+
+// Splits data into numChunks newline-aligned chunks and scans them on separate
+// threads, calling visit(chunkIndex, line) for every line that is not blank or a
+// '#' comment. Lines are trimmed. Returns the number of chunks actually used.
+size_t forEachSeedLine(std::string_view data, size_t numChunks,
+                       const std::function<void(size_t, std::string_view)>& visit);
+
+#endif
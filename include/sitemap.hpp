@@ -0,0 +1,76 @@
+#ifndef SITEMAP_HPP
+#define SITEMAP_HPP
+
+#include <string>
+#include <vector>
+#include <functional>
+#include <ctime>
+#include <zlib.h>
+
+struct SitemapEntry {
+    std::string loc;
+    std::time_t lastModified = 0;  // From <lastmod>, 0 if absent or unparsable
+};
+
+// Streaming, SAX-style parser for sitemap and sitemap index documents.
+//
+// Bytes are fed as they arrive from the network. Gzipped input is detected from
+// its magic bytes and inflated on the fly. Only <loc> and <lastmod> text is kept;
+// an entry is emitted when its enclosing </url> or </sitemap> closes, so memory
+// use does not depend on the document size.
+class SitemapParser {
+public:
+    using EntryCallback = std::function<void(SitemapEntry&& entry)>;
+
+    SitemapParser(EntryCallback onUrl, EntryCallback onSitemap);
+    ~SitemapParser();
+    SitemapParser(const SitemapParser&) = delete;
+    SitemapParser& operator=(const SitemapParser&) = delete;
+
+    // Returns false on corrupt compressed input or when the size cap is exceeded.
+    bool feed(const char* data, size_t size);
+
+private:
+    void feedXml(const char* data, size_t size);
+    void handleTag();
+    void appendText(char c);
+
+    EntryCallback m_onUrl;
+    EntryCallback m_onSitemap;
+
+    // Decompression
+    bool m_sniffed = false;
+    bool m_gzip = false;
+    bool m_inflateReady = false;
+    z_stream m_zstream {};
+    size_t m_xmlBytes = 0;
+
+    // Tokenizer state
+    bool m_inTag = false;
+    std::string m_tag;
+    std::string m_text;
+    std::string m_entity;
+    bool m_inEntity = false;
+    enum class Field { None, Loc, LastMod } m_field = Field::None;
+    SitemapEntry m_current;
+};
+
+// W3C datetime ("2024-01-15", "2024-01-15T10:00:00+02:00", ...) to UTC time_t, 0 on failure.
+std::time_t parseW3cDatetime(const std::string& text);
+
+// Returns the URLs of all "Sitemap:" lines in a robots.txt body.
+std::vector<std::string> parseRobotsSitemaps(const std::string& robotsBody);
+
+struct SitemapLimits {
+    size_t maxSitemaps = 1000;   // Per site, including nested index files
+    size_t batchSize = 1000;     // URLs handed to the sink at a time
+};
+
+// Discovers the sitemaps of siteUrl's host (robots.txt "Sitemap:" lines, falling
+// back to /sitemap.xml), follows sitemap indexes and streams every listed URL to
+// onBatch. onBatch returns false to stop early. Returns the number of URLs found.
+size_t ingestSitemaps(const std::string& siteUrl,
+                      const std::function<bool(std::vector<SitemapEntry>& batch)>& onBatch,
+                      const SitemapLimits& limits = {});
+
+#endif
@@ -0,0 +1,63 @@
+#ifndef SNAPSHOT_SLOT_HPP
+#define SNAPSHOT_SLOT_HPP
+
+#include <atomic>
+#include <memory>
+#include <thread>
+
+// Holds the latest immutable snapshot published by a single writer thread.
+//
+// Two slots alternate: the writer fills the one readers are not using and then
+// flips the index. A reader pins the current slot with a counter, re-checks the
+// index and copies the shared_ptr, so load() never waits on a lock or on the
+// writer; it only retries if a publish flipped the index under it. publish()
+// waits for stragglers still pinning the slot it is about to overwrite.
+//
+// (std::atomic<std::shared_ptr> would do, but libstdc++ implements it with a
+// spinlock that readers and the writer share.)
+template <typename T>
+class SnapshotSlot {
+public:
+    SnapshotSlot() = default;
+    SnapshotSlot(const SnapshotSlot&) = delete;
+    SnapshotSlot& operator=(const SnapshotSlot&) = delete;
+
+    // Any thread. Null until the first publish().
+    std::shared_ptr<const T> load() const {
+        while (true) {
+            const unsigned current {m_current.load()};
+            const Slot& slot {m_slots[current]};
+            // Sequentially consistent, so the writer either sees the pin or
+            // this thread sees the index move away from the slot
+            slot.readers.fetch_add(1);
+            if (m_current.load() == current) {
+                std::shared_ptr<const T> value {slot.value};
+                slot.readers.fetch_sub(1);
+                return value;
+            }
+            slot.readers.fetch_sub(1);
+        }
+    }
+
+    // Writer thread only.
+    void publish(std::shared_ptr<const T> value) {
+        const unsigned next {1 - m_current.load()};
+        Slot& slot {m_slots[next]};
+        while (slot.readers.load() != 0) {
+            std::this_thread::yield();
+        }
+        slot.value = std::move(value);
+        m_current.store(next);
+    }
+
+private:
+    struct Slot {
+        std::shared_ptr<const T> value;
+        mutable std::atomic<unsigned> readers {0};
+    };
+
+    Slot m_slots[2];
+    std::atomic<unsigned> m_current {0};
+};
+
+#endif
@@ -0,0 +1,114 @@
+#ifndef TIMER_WHEEL_HPP
+#define TIMER_WHEEL_HPP
+
+#include <array>
+#include <vector>
+#include <chrono>
+#include <cstdint>
+#include <cstddef>
+
+// Hierarchical timing wheel: O(1) schedule, amortized O(1) expiry.
+//
+// Level 0 has one slot per tick; every higher level has slots 64 times as wide.
+// A timer sits in the lowest level whose span covers its deadline and is moved
+// ("cascaded") one level down whenever the wheel below wraps around, until it
+// reaches level 0 and fires. Four levels of 64 slots cover 64^4 ticks; later
+// deadlines are clamped to that horizon. Not thread-safe.
+template <typename T>
+class TimerWheel {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    explicit TimerWheel(Clock::duration tick, Clock::time_point start = Clock::now())
+        : m_tick(tick), m_start(start) {}
+
+    void schedule(T value, Clock::time_point deadline) {
+        // Round up, so a timer never fires before its deadline
+        const auto offset {deadline - m_start};
+        uint64_t expiry {offset <= Clock::duration::zero() ? 0
+            : static_cast<uint64_t>((offset + m_tick - Clock::duration(1)) / m_tick)};
+        insert(Timer {std::max(expiry, m_current), std::move(value)});
+        m_size++;
+    }
+
+    // Fires every timer whose deadline is at or before now, appending its value to out.
+    void advance(Clock::time_point now, std::vector<T>& out) {
+        if (now < m_start) return;
+        const uint64_t target {static_cast<uint64_t>((now - m_start) / m_tick)};
+        while (m_current <= target && m_size > 0) {
+            const size_t index {m_current & kSlotMask};
+            // Level 0 wrapped around: bring the next slot of each higher level down
+            if (index == 0) {
+                for (size_t level = 1; level < kLevels; ++level) {
+                    const size_t slot {(m_current >> (kSlotBits * level)) & kSlotMask};
+                    cascade(level, slot);
+                    if (slot != 0) break;
+                }
+            }
+            auto& expired {m_levels[0][index]};
+            for (auto& timer : expired) {
+                out.push_back(std::move(timer.value));
+            }
+            m_size -= expired.size();
+            expired.clear();
+            m_current++;
+        }
+        // Nothing scheduled: jump straight to now
+        if (m_size == 0 && m_current <= target) m_current = target + 1;
+    }
+
+    // Removes every timer regardless of its deadline.
+    void drain(std::vector<T>& out) {
+        for (auto& level : m_levels) {
+            for (auto& slot : level) {
+                for (auto& timer : slot) {
+                    out.push_back(std::move(timer.value));
+                }
+                slot.clear();
+            }
+        }
+        m_size = 0;
+    }
+
+    bool empty() const { return m_size == 0; }
+    size_t size() const { return m_size; }
+
+private:
+    static constexpr size_t kLevels {4};
+    static constexpr size_t kSlotBits {6};
+    static constexpr size_t kSlots {size_t {1} << kSlotBits};
+    static constexpr uint64_t kSlotMask {kSlots - 1};
+
+    struct Timer {
+        uint64_t expiry;  // In ticks since m_start
+        T value;
+    };
+
+    void insert(Timer timer) {
+        const uint64_t horizon {(uint64_t {1} << (kSlotBits * kLevels)) - 1};
+        timer.expiry = std::min(timer.expiry, m_current + horizon);
+        const uint64_t delta {timer.expiry - m_current};
+        size_t level {0};
+        while (level + 1 < kLevels && delta >= (uint64_t {1} << (kSlotBits * (level + 1)))) {
+            level++;
+        }
+        const size_t slot {(timer.expiry >> (kSlotBits * level)) & kSlotMask};
+        m_levels[level][slot].push_back(std::move(timer));
+    }
+
+    void cascade(size_t level, size_t slot) {
+        std::vector<Timer> timers;
+        timers.swap(m_levels[level][slot]);
+        for (auto& timer : timers) {
+            insert(std::move(timer));
+        }
+    }
+
+    Clock::duration m_tick;
+    Clock::time_point m_start;
+    uint64_t m_current = 0;  // Next tick to process
+    size_t m_size = 0;
+    std::array<std::array<std::vector<Timer>, kSlots>, kLevels> m_levels;
+};
+
+#endif
@@ -0,0 +1,99 @@
+#ifndef TRAP_DETECTOR_HPP
+#define TRAP_DETECTOR_HPP
+
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <array>
+#include <fstream>
+#include <cstdint>
+#include <cstddef>
+
+// What the trap detector needs to know about a URL, computed off the frontier
+// lock by classify().
+struct UrlShape {
+    uint64_t pattern = 0;     // Hash of the URL template; 0 if not classified
+    uint16_t depth = 0;       // Path segments
+    bool repeating = false;   // A segment or block of segments repeats (/a/b/a/b)
+    bool oversized = false;   // Absurdly long URL or query
+};
+
+enum class TrapVerdict {
+    Accept,
+    Throttle,  // Only a sample of these URLs is enqueued
+    Drop
+};
+
+// Keeps crawler traps (calendars, endless pagination, /a/b/a/b/... loops,
+// generated query strings) from filling the frontier.
+//
+// URLs are grouped into templates: the path with digit runs replaced, plus the
+// sorted query parameter names ("/cal/N/N?view"). For every template the
+// detector counts URLs enqueued, pages fetched, and new links those pages
+// yielded, split into links of the same template and links elsewhere. A
+// template whose pages keep linking to one or two more of themselves but to
+// almost nothing else is a trap: it is throttled, and dropped once it has
+// shown that for long enough. Per host it also keeps a path-depth histogram,
+// throttling URLs far deeper than the host's usual pages. Repeating segments
+// are dropped outright.
+//
+// State is bounded: once more than kMaxHosts hosts are tracked, hosts not seen
+// since the previous such pass are forgotten, and a host whose template table
+// is full forgets the templates that carry no verdict.
+//
+// Not thread-safe; the crawler calls it with the frontier lock held.
+class TrapDetector {
+public:
+    static constexpr size_t kMaxHosts {10000};
+
+    // Pure function of the URL, safe to call from any thread.
+    static UrlShape classify(std::string_view url);
+
+    // Decides whether a new URL may enter the frontier.
+    bool admit(const std::string& host, const std::string& url, const UrlShape& shape);
+    // Reports how many new links (in total / of the page's own template) a fetched page added.
+    void recordYield(const std::string& host, const std::string& url, const UrlShape& shape,
+                     size_t newLinks, size_t selfLinks);
+
+    // Writes every throttle/drop decision as "verdict<TAB>reason<TAB>url".
+    bool openLog(const std::string& path);
+
+    size_t throttled() const { return m_throttled; }
+    size_t dropped() const { return m_dropped; }
+    size_t trackedHosts() const { return m_hosts.size(); }
+
+private:
+    static constexpr size_t kDepthBuckets {32};
+
+    struct TemplateStats {
+        uint32_t enqueued = 0;
+        uint32_t fetched = 0;
+        uint32_t newLinks = 0;
+        uint32_t selfLinks = 0;
+        uint32_t throttleCounter = 0;
+        TrapVerdict state = TrapVerdict::Accept;
+    };
+
+    struct HostStats {
+        std::array<uint32_t, kDepthBuckets> depths {};
+        uint32_t accepted = 0;
+        uint32_t deepCounter = 0;
+        uint32_t generation = 0;  // Eviction pass during which the host was last seen
+        bool templatesFull = false;  // Pruning freed too little; new templates are not judged
+        std::unordered_map<uint64_t, TemplateStats> templates;
+    };
+
+    HostStats& hostStats(const std::string& host);
+    static TemplateStats* templateStats(HostStats& host, uint64_t pattern);
+    size_t depthCutoff(const HostStats& host) const;
+    void logDecision(TrapVerdict verdict, const char* reason, const std::string& url);
+
+    std::unordered_map<std::string, HostStats> m_hosts;
+    uint32_t m_generation = 0;
+    size_t m_evictAt = kMaxHosts;  // m_hosts size that triggers the next eviction pass
+    std::ofstream m_log;
+    size_t m_throttled = 0;
+    size_t m_dropped = 0;
+};
+
+#endif
@@ -0,0 +1,100 @@
+#ifndef URL_CANONICALIZER_HPP
+#define URL_CANONICALIZER_HPP
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <unordered_map>
+#include <unordered_set>
+#include <shared_mutex>
+#include <cstdint>
+
+// Rewrites a path prefix on one host ("*" for every host).
+struct RewriteRule {
+    std::string host;
+    std::string from;
+    std::string to;
+};
+
+struct CanonicalRules {
+    // Query parameter names or globs ("utm_*") that never change the content
+    std::vector<std::string> stripParameters {
+        "utm_*", "gclid", "fbclid", "msclkid", "mc_cid", "mc_eid",
+        "sessionid", "jsessionid", "phpsessid", "sid_*"
+    };
+    std::vector<RewriteRule> rewrites;
+    bool sortParameters = true;
+    bool stripIndexPages = true;     // "/dir/index.html" -> "/dir"
+    bool learnParameters = true;     // Drop parameters that proved not to change content
+};
+
+// Maps the many spellings of a URL to one, so the visited set sees them as the same page.
+//
+// Static rules: lowercase scheme and host, drop the default port, the fragment,
+// ";jsessionid=" path parameters, index pages and the trailing slash, apply
+// per-host path rewrites, strip listed parameters and sort the rest.
+//
+// Learned rules: for every fetched page with a query, the content hash is
+// remembered per "URL without parameter p". Rules are scoped to the host and
+// path template (digit runs collapsed, "/item/#") the evidence came from. When
+// URLs that differ only in p's value return identical content, from at least
+// kLearnConfirmations distinct paths and values, and never different content,
+// p is stripped within that scope. A few values of a stripped parameter are
+// still kept, so its variants keep being compared with the stripped URL and
+// different content revokes the rule. rel=canonical hints only map the fetched
+// URL to its canonical one; they never teach a rule.
+class UrlCanonicalizer {
+public:
+    explicit UrlCanonicalizer(CanonicalRules rules = {});
+    // Moving is only safe while no other thread uses either object.
+    UrlCanonicalizer(UrlCanonicalizer&& other) noexcept;
+    UrlCanonicalizer& operator=(UrlCanonicalizer&& other) noexcept;
+
+    // Rule file lines: "strip <name|glob>", "rewrite <host|*> <from> <to>",
+    // "keep-order", "keep-index", "no-learn". '#' starts a comment.
+    bool loadRules(const std::string& path);
+
+    // Thread-safe.
+    std::string canonicalize(std::string_view url) const;
+
+    // Reports the content of a fetched (canonical) URL; only hashed if it can teach something.
+    void observeContent(const std::string& url, std::string_view content);
+    // Records a same-host rel=canonical hint. Returns the canonical URL if it was
+    // accepted and differs from url, otherwise an empty string.
+    std::string addCanonicalHint(const std::string& url, std::string_view canonicalUrl);
+
+    static uint64_t hashContent(std::string_view content);
+
+    // Parameter rules learned so far, and how many were revoked again.
+    size_t learnedParameters() const;
+    size_t revokedParameters() const;
+
+private:
+    struct ParamStats {
+        uint32_t different = 0;  // Variants with another value gave different content
+        // Hashes of the paths and values identical content was seen for, up to kLearnConfirmations
+        std::vector<uint64_t> paths;
+        std::vector<uint64_t> values;
+    };
+    struct Sample {
+        std::string value;
+        uint64_t hash = 0;
+    };
+
+    void recordEvidence(const std::string& scope, std::string_view name, std::string_view path,
+                        std::string_view firstValue, std::string_view value, bool sameContent);
+    bool isStripped(const std::string& scope, std::string_view name, std::string_view value) const;
+
+    CanonicalRules m_rules;
+
+    // Learned state, shared by the parse threads
+    std::unordered_map<std::string, Sample> m_samples;       // "host/path&others\x1fname" -> first value seen
+    std::unordered_map<std::string, ParamStats> m_paramStats; // "host\x1ftemplate\x1fname"
+    std::unordered_map<std::string, std::unordered_set<std::string>> m_learned; // "host\x1ftemplate" -> parameters
+    std::unordered_map<std::string, std::string> m_aliases;  // fetched URL -> rel=canonical URL
+    size_t m_learnedCount = 0;
+    size_t m_revokedCount = 0;
+    mutable std::shared_mutex m_mutex;
+};
+
+#endif
@@ -0,0 +1,41 @@
+#ifndef VARINT_HPP
+#define VARINT_HPP
+
+#include <string>
+#include <istream>
+#include <cstdint>
+
+// LEB128-style variable length integers: 7 bits per byte, high bit set on all
+// but the last byte. Small numbers (deltas, counts) take a single byte.
+
+inline void putVarint(std::string& out, uint64_t value) {
+    while (value >= 0x80) {
+        out += static_cast<char>((value & 0x7F) | 0x80);
+        value >>= 7;
+    }
+    out += static_cast<char>(value);
+}
+
+// Decodes from [p, end), advancing p. Returns false on truncated or overlong input.
+inline bool getVarint(const char*& p, const char* end, uint64_t& value) {
+    value = 0;
+    for (unsigned shift = 0; shift < 64 && p < end; shift += 7) {
+        const auto byte = static_cast<unsigned char>(*p++);
+        value |= static_cast<uint64_t>(byte & 0x7F) << shift;
+        if ((byte & 0x80) == 0) return true;
+    }
+    return false;
+}
+
+inline bool readVarint(std::istream& in, uint64_t& value) {
+    value = 0;
+    for (unsigned shift = 0; shift < 64; shift += 7) {
+        const int byte = in.get();
+        if (byte == std::char_traits<char>::eof()) return false;
+        value |= static_cast<uint64_t>(byte & 0x7F) << shift;
+        if ((byte & 0x80) == 0) return true;
+    }
+    return false;
+}
+
+#endif
@@ -0,0 +1,324 @@
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <cstdint>
+#include <cerrno>
+#include <csignal>
+#include <unistd.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+
+// Shape of the synthetic site. Every page is a pure function of its number,
+// so runs against the same settings crawl exactly the same pages.
+struct SiteOptions {
+    uint16_t port = 18090;
+    uint64_t pages = 100000;
+    uint64_t links = 20;       // Links per page, the first one to the next page
+    size_t textBytes = 2000;   // Visible text per page
+    uint64_t latencyMs = 0;    // Added before every response
+    double rejectRate = 0.0;   // Fraction of page requests answered with rejectStatus
+    long rejectStatus = 429;
+    uint64_t calendarLinks = 0;  // Links per page into the endless calendar (a crawler trap)
+};
+
+// Requests served so far; decides which ones are rejected.
+static std::atomic<uint64_t> g_requests {0};
+
+static constexpr std::string_view kWords[] {
+    "crawler", "frontier", "latency", "budget", "index", "parser", "socket", "thread",
+    "channel", "buffer", "header", "status", "sitemap", "robots", "canonical", "timer",
+};
+
+// Deterministic scatter of link targets (splitmix64).
+static uint64_t mix(uint64_t x) {
+    x += 0x9E3779B97F4A7C15ull;
+    x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ull;
+    x = (x ^ (x >> 27)) * 0x94D049BB133111EBull;
+    return x ^ (x >> 31);
+}
+
+// Calendar day number to its path; every month has 31 days and every year 12 months.
+static std::string calendarPath(uint64_t day) {
+    return "/cal/" + std::to_string(2000 + day / 372) + "/" + std::to_string(day / 31 % 12 + 1) + "/" +
+           std::to_string(day % 31 + 1);
+}
+
+// A calendar day links to the days before and after it and to nothing else,
+// forever: the classic crawler trap.
+static std::string renderCalendarDay(uint64_t day) {
+    std::string html {"<!DOCTYPE html><html><head><title>Events on day "};
+    html += std::to_string(day);
+    html += "</title></head><body><p>No events.</p>";
+    if (day > 0) {
+        html += "<a href=\"" + calendarPath(day - 1) + "\">Previous day</a>";
+    }
+    html += "<a href=\"" + calendarPath(day + 1) + "\">Next day</a></body></html>";
+    return html;
+}
+
+// "/cal/<year>/<month>/<day>" back to its day number.
+static bool parseCalendarPath(std::string_view path, uint64_t& day) {
+    uint64_t fields[3] {};
+    size_t field {0};
+    bool digits {false};
+    for (char c : path) {
+        if (c == '/' && digits && field < 2) {
+            field++;
+            digits = false;
+        } else if (c >= '0' && c <= '9' && fields[field] < 100000) {
+            fields[field] = fields[field] * 10 + static_cast<uint64_t>(c - '0');
+            digits = true;
+        } else {
+            return false;
+        }
+    }
+    if (field != 2 || !digits || fields[0] < 2000 || fields[1] < 1 || fields[1] > 12 || fields[2] < 1 || fields[2] > 31) {
+        return false;
+    }
+    day = (fields[0] - 2000) * 372 + (fields[1] - 1) * 31 + fields[2] - 1;
+    return true;
+}
+
+static std::string renderPage(uint64_t page, const SiteOptions& options) {
+    std::string html;
+    html.reserve(options.textBytes + options.links * 40 + 256);
+    html += "<!DOCTYPE html><html><head><title>Synthetic page ";
+    html += std::to_string(page);
+    html += "</title></head><body><h1>Page ";
+    html += std::to_string(page);
+    html += "</h1><p>";
+    for (uint64_t word = 0; html.size() < options.textBytes; ++word) {
+        html += kWords[mix(page * 1315423911ull + word) % std::size(kWords)];
+        html += ' ';
+    }
+    html += "</p><ul>";
+    for (uint64_t link = 0; link < options.links; ++link) {
+        const uint64_t target {link == 0 ? (page + 1) % options.pages : mix(page * options.links + link) % options.pages};
+        html += "<li><a href=\"/p/";
+        html += std::to_string(target);
+        html += "\">Page ";
+        html += std::to_string(target);
+        html += "</a></li>";
+    }
+    for (uint64_t link = 0; link < options.calendarLinks; ++link) {
+        html += "<li><a href=\"";
+        html += calendarPath(mix(page * options.calendarLinks + link) % 3720);
+        html += "\">Events</a></li>";
+    }
+    html += "</ul></body></html>";
+    return html;
+}
+
+static const char* statusLine(long status) {
+    switch (status) {
+        case 200: return "HTTP/1.1 200 OK\r\n";
+        case 429: return "HTTP/1.1 429 Too Many Requests\r\n";
+        case 503: return "HTTP/1.1 503 Service Unavailable\r\n";
+        default: return "HTTP/1.1 404 Not Found\r\n";
+    }
+}
+
+// Builds the response to one request line's target.
+static std::string respond(std::string_view target, const SiteOptions& options, bool keepAlive) {
+    long status {404};
+    std::string body {"Not found"};
+    // Rejects a fixed, evenly spread share of the request numbers
+    const uint64_t request {g_requests.fetch_add(1, std::memory_order_relaxed)};
+    if (options.rejectRate > 0.0 && static_cast<double>(mix(request) % 10000) < options.rejectRate * 10000.0) {
+        status = options.rejectStatus;
+        body = "Rejected";
+    } else if (target.substr(0, 3) == "/p/" && target.size() > 3) {
+        uint64_t page {0};
+        bool valid {target.size() <= 3 + 19};
+        for (char c : target.substr(3)) {
+            if (c < '0' || c > '9') valid = false;
+            page = page * 10 + static_cast<uint64_t>(c - '0');
+        }
+        if (valid && page < options.pages) {
+            status = 200;
+            body = renderPage(page, options);
+        }
+    } else if (options.calendarLinks > 0 && target.substr(0, 5) == "/cal/") {
+        uint64_t day {0};
+        if (parseCalendarPath(target.substr(5), day)) {
+            status = 200;
+            body = renderCalendarDay(day);
+        }
+    }
+
+    std::string response {statusLine(status)};
+    if (status == 429 || status == 503) response += "Retry-After: 1\r\n";
+    response += "Content-Type: text/html; charset=utf-8\r\nContent-Length: ";
+    response += std::to_string(body.size());
+    response += keepAlive ? "\r\nConnection: keep-alive\r\n\r\n" : "\r\nConnection: close\r\n\r\n";
+    response += body;
+    return response;
+}
+
+static bool sendAll(int fd, std::string_view data) {
+    while (!data.empty()) {
+        ssize_t sent {::send(fd, data.data(), data.size(), MSG_NOSIGNAL)};
+        if (sent < 0) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        data.remove_prefix(static_cast<size_t>(sent));
+    }
+    return true;
+}
+
+// One thread per keep-alive connection; the crawler opens at most one per fetch slot.
+static void serveConnection(int fd, SiteOptions options) {
+    std::string pending;
+    char buffer[8192];
+    bool open {true};
+    while (open) {
+        size_t end;
+        while ((end = pending.find("\r\n\r\n")) == std::string::npos) {
+            ssize_t received {::recv(fd, buffer, sizeof(buffer), 0)};
+            if (received < 0 && errno == EINTR) continue;
+            if (received <= 0 || pending.size() > 65536) {
+                ::close(fd);
+                return;
+            }
+            pending.append(buffer, static_cast<size_t>(received));
+        }
+
+        const std::string_view request {std::string_view(pending).substr(0, end)};
+        const size_t targetStart {request.find(' ') + 1};
+        const size_t targetEnd {request.find(' ', targetStart)};
+        std::string_view target {targetStart == 0 || targetEnd == std::string_view::npos
+                                     ? std::string_view()
+                                     : request.substr(targetStart, targetEnd - targetStart)};
+        target = target.substr(0, target.find('?'));
+        const bool keepAlive {request.find("Connection: close") == std::string_view::npos &&
+                              request.find("HTTP/1.1") != std::string_view::npos};
+
+        if (options.latencyMs > 0) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(options.latencyMs));
+        }
+        open = sendAll(fd, respond(target, options, keepAlive)) && keepAlive;
+        pending.erase(0, end + 4);
+    }
+    ::close(fd);
+}
+
+static void printUsage(const char* program) {
+    std::cerr << "Usage: " << program << " [options]\n";
+    std::cerr << "  Serves a synthetic site on 127.0.0.1 for crawl benchmarks; start at /p/0.\n";
+    std::cerr << "Options:\n";
+    std::cerr << "  --port <n>          Port to listen on (default: 18090)\n";
+    std::cerr << "  --pages <n>         Pages on the site (default: 100000)\n";
+    std::cerr << "  --links <n>         Links per page (default: 20)\n";
+    std::cerr << "  --text-bytes <n>    Approximate HTML size per page before links (default: 2000)\n";
+    std::cerr << "  --latency-ms <n>    Delay before every response (default: none)\n";
+    std::cerr << "  --reject-rate <f>   Fraction (0-1) of requests rejected with --reject-status (default: 0)\n";
+    std::cerr << "  --reject-status <n> 429 or 503 (default: 429), sent with Retry-After: 1\n";
+    std::cerr << "  --calendar-links <n> Links per page into an endless calendar whose days only\n";
+    std::cerr << "                      link to each other, a crawler trap (default: none)\n";
+}
+
+// Parses a positive integer argument, printing an error on failure.
+static bool parseNumber(const char* value, const char* name, uint64_t& out) {
+    try {
+        out = std::stoull(value);
+    } catch (const std::exception& e) {
+        std::cerr << "Invalid " << name << " value: " << value << "\n";
+        return false;
+    }
+    if (out == 0) {
+        std::cerr << name << " must be at least 1\n";
+        return false;
+    }
+    return true;
+}
+
+// Parses a fraction between 0 and 1, printing an error on failure.
+static bool parseRate(const char* value, const char* name, double& out) {
+    try {
+        out = std::stod(value);
+    } catch (const std::exception& e) {
+        std::cerr << "Invalid " << name << " value: " << value << "\n";
+        return false;
+    }
+    if (!(out >= 0.0 && out <= 1.0)) {
+        std::cerr << name << " must be between 0 and 1\n";
+        return false;
+    }
+    return true;
+}
+
+// Local site for the benchmark and PGO training targets (see bench/), and for
+// the tests, which also use it as a slow or rate-limiting server.
+int main(int argc, char* argv[]) {
+    SiteOptions options;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (i + 1 >= argc) {
+            printUsage(argv[0]);
+            return 1;
+        }
+        const char* value = argv[++i];
+        uint64_t number = 0;
+        if (arg == "--port") {
+            if (!parseNumber(value, "--port", number) || number > 65535) return 1;
+            options.port = static_cast<uint16_t>(number);
+        } else if (arg == "--pages") {
+            if (!parseNumber(value, "--pages", options.pages)) return 1;
+        } else if (arg == "--links") {
+            if (!parseNumber(value, "--links", options.links)) return 1;
+        } else if (arg == "--text-bytes") {
+            if (!parseNumber(value, "--text-bytes", number)) return 1;
+            options.textBytes = static_cast<size_t>(number);
+        } else if (arg == "--latency-ms") {
+            if (!parseNumber(value, "--latency-ms", options.latencyMs)) return 1;
+        } else if (arg == "--calendar-links") {
+            if (!parseNumber(value, "--calendar-links", options.calendarLinks)) return 1;
+        } else if (arg == "--reject-rate") {
+            if (!parseRate(value, "--reject-rate", options.rejectRate)) return 1;
+        } else if (arg == "--reject-status") {
+            if (!parseNumber(value, "--reject-status", number)) return 1;
+            if (number != 429 && number != 503) {
+                std::cerr << "--reject-status must be 429 or 503\n";
+                return 1;
+            }
+            options.rejectStatus = static_cast<long>(number);
+        } else {
+            std::cerr << "Unknown option: " << arg << "\n";
+            printUsage(argv[0]);
+            return 1;
+        }
+    }
+
+    int listenFd {::socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0)};
+    const int reuse {1};
+    ::setsockopt(listenFd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+    sockaddr_in address {};
+    address.sin_family = AF_INET;
+    address.sin_port = htons(options.port);
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (listenFd < 0 || ::bind(listenFd, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0 ||
+        ::listen(listenFd, SOMAXCONN) != 0) {
+        std::cerr << "Failed to listen on 127.0.0.1:" << options.port << ": " << std::strerror(errno) << "\n";
+        return 1;
+    }
+    std::cout << "Serving " << options.pages << " pages on http://127.0.0.1:" << options.port << "/p/0" << std::endl;
+
+    while (true) {
+        int fd {::accept4(listenFd, nullptr, nullptr, SOCK_CLOEXEC)};
+        if (fd < 0) {
+            if (errno == EINTR || errno == ECONNABORTED || errno == EMFILE) continue;
+            std::cerr << "Accept failed: " << std::strerror(errno) << "\n";
+            return 1;
+        }
+        const int noDelay {1};
+        ::setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &noDelay, sizeof(noDelay));
+        std::thread(serveConnection, fd, options).detach();
+    }
+}
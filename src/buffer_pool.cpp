@@ -0,0 +1,29 @@
+#include "buffer_pool.hpp"
+
+// Free buffers kept around; roughly one per fetch or parse thread in flight.
+static constexpr size_t kMaxPooledBuffers {256};
+// Larger buffers (a rare huge page) are freed instead of pinning the memory.
+static constexpr size_t kMaxPooledCapacity {4 * 1024 * 1024};
+
+BufferPool::BufferPool() : m_free(kMaxPooledBuffers) {
+}
+
+BufferPool& BufferPool::shared() {
+    static BufferPool pool;
+    return pool;
+}
+
+std::string BufferPool::take() {
+    std::string buffer;
+    m_free.tryPop(buffer);
+    return buffer;
+}
+
+void BufferPool::give(std::string&& buffer) {
+    if (buffer.capacity() < kMinCapacity || buffer.capacity() > kMaxPooledCapacity) {
+        buffer = std::string();
+        return;
+    }
+    buffer.clear();
+    m_free.tryPush(buffer);  // Dropped (and freed) if the pool is full
+}
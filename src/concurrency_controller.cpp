@@ -0,0 +1,198 @@
+#include "concurrency_controller.hpp"
+
+#include <algorithm>
+
+// Weight of a new sample in the smoothed latency.
+static constexpr double kLatencySmoothing {0.2};
+// Smoothed latency above this multiple of the best latency means requests are queueing.
+static constexpr double kQueueingRatio {2.0};
+// The best latency slowly drifts up so a single lucky sample does not pin it forever.
+static constexpr double kMinLatencyDrift {1.01};
+// The global limit shrinks once more than this share of samples comes from queueing hosts.
+static constexpr double kGlobalQueueingShare {0.5};
+// Weight of a sample in that share; small, so one host's burst of slow replies is not enough.
+static constexpr double kQueueingShareSmoothing {0.02};
+// A host limiter below its initial limit is remembered this long after its last fetch.
+static constexpr std::chrono::minutes kHostMemory {10};
+
+ConcurrencyController::ConcurrencyController(const ConcurrencyLimits& limits)
+    : m_limits(limits) {
+    m_limits.minLimit = std::max<size_t>(1, m_limits.minLimit);
+    m_limits.maxLimit = std::max(m_limits.minLimit, m_limits.maxLimit);
+    m_limits.hostMaxLimit = std::max<size_t>(1, m_limits.hostMaxLimit);
+    m_global.limit = static_cast<double>(
+        std::clamp(m_limits.initialLimit, m_limits.minLimit, m_limits.maxLimit));
+    m_ceiling = m_limits.maxLimit;
+    m_evictAt = kMaxHosts;
+}
+
+bool ConcurrencyController::tryAcquire(const std::string& host) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_global.inFlight >= static_cast<size_t>(m_global.limit)) {
+        return false;
+    }
+
+    const auto now = std::chrono::steady_clock::now();
+    if (m_hosts.size() >= m_evictAt && !m_hosts.contains(host)) {
+        evictIdleHosts(now);
+    }
+    auto [it, inserted] = m_hosts.try_emplace(host);
+    Limiter& hostLimiter = it->second;
+    if (inserted) {
+        hostLimiter.limit = static_cast<double>(
+            std::clamp<size_t>(m_limits.hostInitialLimit, 1, m_limits.hostMaxLimit));
+    }
+    if (hostLimiter.inFlight >= static_cast<size_t>(hostLimiter.limit)) {
+        return false;
+    }
+
+    m_global.inFlight++;
+    hostLimiter.inFlight++;
+    hostLimiter.lastUsed = now;
+    return true;
+}
+
+// Drops the limiters of hosts with nothing in flight, except those still backing
+// off (below their initial limit) and used recently. The next pass runs once the
+// map has doubled again, so passes cost O(1) per new host.
+// Called while holding m_mutex.
+void ConcurrencyController::evictIdleHosts(std::chrono::steady_clock::time_point now) {
+    const double initial {static_cast<double>(std::clamp<size_t>(m_limits.hostInitialLimit, 1, m_limits.hostMaxLimit))};
+    std::erase_if(m_hosts, [&](const auto& item) {
+        const Limiter& limiter {item.second};
+        return limiter.inFlight == 0 && (limiter.limit >= initial || now - limiter.lastUsed >= kHostMemory);
+    });
+    m_evictAt = std::max(kMaxHosts, m_hosts.size() * 2);
+}
+
+void ConcurrencyController::release(const std::string& host, FetchOutcome outcome,
+                                    std::chrono::milliseconds latency) {
+    const double latencyMs = static_cast<double>(std::max<long long>(1, latency.count()));
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    bool hostQueueing {false};
+    auto it = m_hosts.find(host);
+    if (it != m_hosts.end()) {
+        Limiter& hostLimiter {it->second};
+        if (hostLimiter.inFlight > 0) hostLimiter.inFlight--;
+        if (outcome == FetchOutcome::Success) {
+            observe(hostLimiter, latencyMs);
+            hostQueueing = hostLimiter.smoothedLatencyMs > kQueueingRatio * hostLimiter.minLatencyMs;
+        }
+        adjust(hostLimiter, 1, m_limits.hostMaxLimit, outcome, hostQueueing);
+    }
+
+    // A throttling or failing host must not slow down every other host
+    if (m_global.inFlight > 0) m_global.inFlight--;
+    if (outcome == FetchOutcome::Success) {
+        observe(m_global, latencyMs);
+        m_global.queueingShare += kQueueingShareSmoothing * ((hostQueueing ? 1.0 : 0.0) - m_global.queueingShare);
+        adjust(m_global, m_limits.minLimit, m_ceiling, outcome, m_global.queueingShare > kGlobalQueueingShare);
+    }
+}
+
+void ConcurrencyController::cancel(const std::string& host) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_global.inFlight > 0) m_global.inFlight--;
+    auto it = m_hosts.find(host);
+    if (it != m_hosts.end() && it->second.inFlight > 0) it->second.inFlight--;
+}
+
+// Folds a successful fetch's latency into the limiter's smoothed and best latency.
+void ConcurrencyController::observe(Limiter& limiter, double latencyMs) {
+    if (limiter.smoothedLatencyMs == 0.0) {
+        limiter.smoothedLatencyMs = latencyMs;
+        limiter.minLatencyMs = latencyMs;
+    } else {
+        limiter.smoothedLatencyMs += kLatencySmoothing * (latencyMs - limiter.smoothedLatencyMs);
+        limiter.minLatencyMs = std::min(limiter.minLatencyMs * kMinLatencyDrift, latencyMs);
+    }
+}
+
+// queueing: latency is inflating for this limiter (only looked at on success).
+void ConcurrencyController::adjust(Limiter& limiter, size_t minLimit, size_t maxLimit,
+                                   FetchOutcome outcome, bool queueing) {
+    const auto now = std::chrono::steady_clock::now();
+    const double lo = static_cast<double>(minLimit);
+    const double hi = static_cast<double>(maxLimit);
+
+    // Only back off once per latency window, otherwise a burst of failures from
+    // requests that were already in flight collapses the limit to the floor.
+    // The same window also holds the limit after a decrease, so a fast server
+    // cannot win the slots back within it (many rounds fit in 100ms).
+    const auto window = std::chrono::milliseconds(
+        static_cast<long long>(std::max(100.0, limiter.smoothedLatencyMs)));
+    const bool canDecrease = now - limiter.lastDecrease >= window;
+
+    if (outcome != FetchOutcome::Success) {
+        if (canDecrease) {
+            limiter.limit = std::max(lo, limiter.limit / 2.0);
+            limiter.lastDecrease = now;
+        }
+        return;
+    }
+
+    if (queueing) {
+        // Latency is inflating: the server (or the link) is queueing our requests.
+        if (canDecrease) {
+            limiter.limit = std::max(lo, limiter.limit - 1.0);
+            limiter.lastDecrease = now;
+        }
+        return;
+    }
+
+    // Additive increase: about one extra slot per limit's worth of completions,
+    // and only while we are actually using most of the current limit.
+    if (canDecrease && static_cast<double>(limiter.inFlight + 1) >= limiter.limit / 2.0) {
+        limiter.limit = std::min(hi, limiter.limit + 1.0 / limiter.limit);
+    }
+}
+
+bool ConcurrencyController::hasCapacity() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_global.inFlight < static_cast<size_t>(m_global.limit);
+}
+
+size_t ConcurrencyController::limit() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return static_cast<size_t>(m_global.limit);
+}
+
+size_t ConcurrencyController::trackedHosts() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_hosts.size();
+}
+
+size_t ConcurrencyController::inFlight() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_global.inFlight;
+}
+
+std::unordered_map<std::string, size_t> ConcurrencyController::inFlightByHost() const {
+    std::unordered_map<std::string, size_t> hosts;
+    std::lock_guard<std::mutex> lock(m_mutex);
+    for (const auto& [host, limiter] : m_hosts) {
+        if (limiter.inFlight > 0) hosts.emplace(host, limiter.inFlight);
+    }
+    return hosts;
+}
+
+size_t ConcurrencyController::setCeiling(size_t ceiling) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_ceiling = std::clamp(ceiling, m_limits.minLimit, m_limits.maxLimit);
+    // Lowering takes effect at once; raising lets the limit grow into it
+    m_global.limit = std::min(m_global.limit, static_cast<double>(m_ceiling));
+    return m_ceiling;
+}
+
+size_t ConcurrencyController::ceiling() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_ceiling;
+}
+
+size_t ConcurrencyController::hostLimit(const std::string& host) const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto it = m_hosts.find(host);
+    if (it == m_hosts.end()) return m_limits.hostInitialLimit;
+    return static_cast<size_t>(it->second.limit);
+}
@@ -0,0 +1,106 @@
+#include "control_commands.hpp"
+
+#include <iomanip>
+#include <sstream>
+#include <utility>
+
+// Rows "hosts" lists when no count is given.
+static constexpr size_t kDefaultHostRows {20};
+
+bool parseControlCount(const std::vector<std::string>& args, size_t& out) {
+    if (args.size() != 1 || args[0].find_first_not_of("0123456789") != std::string::npos) return false;
+    try {
+        out = std::stoul(args[0]);
+    } catch (const std::exception& e) {
+        return false;
+    }
+    return true;
+}
+
+static bool statsCommand(WebCrawler& crawler, const std::vector<std::string>& args, std::string& reply) {
+    if (!args.empty()) return false;
+    auto snapshot = crawler.snapshot();
+    if (!snapshot) {
+        reply = "no stats yet";
+        return true;
+    }
+    std::ostringstream out;
+    out << std::fixed << std::setprecision(1)
+        << "elapsed_seconds " << snapshot->elapsedSeconds << "\n"
+        << "pages_crawled " << snapshot->pagesCrawled << "\n"
+        << "pages_per_second " << snapshot->pagesPerSecond << "\n"
+        << "average_pages_per_second " << snapshot->averagePagesPerSecond << "\n"
+        << "frontier " << snapshot->frontierSize << "\n"
+        << "paused_urls " << snapshot->pausedUrls << "\n"
+        << "active_pages " << snapshot->activePages << "\n"
+        << "waiting_retries " << snapshot->waitingRetries << "\n"
+        << "retries_scheduled " << snapshot->retriesScheduled << "\n"
+        << "in_flight " << snapshot->inFlight << "\n"
+        << "concurrency " << snapshot->concurrencyLimit << "\n"
+        << "concurrency_ceiling " << snapshot->concurrencyCeiling << "\n"
+        << "budget_reserved " << snapshot->budgetReserved << "\n"
+        << "budget " << snapshot->budgetMax << "\n"
+        << "finished " << (snapshot->finished ? 1 : 0);
+    reply = out.str();
+    return true;
+}
+
+static bool hostsCommand(WebCrawler& crawler, const std::vector<std::string>& args, std::string& reply) {
+    size_t limit = kDefaultHostRows;
+    if (!args.empty() && !parseControlCount(args, limit)) return false;
+    auto snapshot = crawler.snapshot();
+    if (!snapshot) return true;
+    std::ostringstream out;
+    for (size_t i = 0; i < snapshot->hosts.size() && i < limit; ++i) {
+        const HostSnapshot& host = snapshot->hosts[i];
+        out << host.host << "\t" << host.queued << "\t" << host.inFlight << "\t"
+            << (host.paused ? "paused" : "-") << "\n";
+    }
+    reply = out.str();
+    return true;
+}
+
+void addCrawlCommands(ControlServer& server, WebCrawler& crawler, ResultFlush flushResults) {
+    server.addCommand("stats", "stats", [&crawler](const std::vector<std::string>& args, std::string& reply) {
+        return statsCommand(crawler, args, reply);
+    });
+    server.addCommand("hosts", "hosts [n]  (host, queued, in flight, paused)",
+                      [&crawler](const std::vector<std::string>& args, std::string& reply) {
+        return hostsCommand(crawler, args, reply);
+    });
+    server.addCommand("concurrency", "concurrency <n>",
+                      [&crawler](const std::vector<std::string>& args, std::string& reply) {
+        size_t ceiling = 0;
+        if (!parseControlCount(args, ceiling)) return false;
+        reply = "concurrency_ceiling " + std::to_string(crawler.setConcurrencyCeiling(ceiling));
+        return true;
+    });
+    server.addCommand("pause", "pause <host>", [&crawler](const std::vector<std::string>& args, std::string& reply) {
+        if (args.size() != 1) return false;
+        if (!crawler.pauseHost(args[0])) {
+            reply = args[0] + " is already paused";
+            return false;
+        }
+        return true;
+    });
+    server.addCommand("resume", "resume <host>", [&crawler](const std::vector<std::string>& args, std::string& reply) {
+        if (args.size() != 1) return false;
+        if (!crawler.resumeHost(args[0])) {
+            reply = args[0] + " is not paused";
+            return false;
+        }
+        return true;
+    });
+    server.addCommand("budget", "budget <max_pages>  (can only be raised)",
+                      [&crawler](const std::vector<std::string>& args, std::string& reply) {
+        size_t maxPages = 0;
+        if (!parseControlCount(args, maxPages)) return false;
+        reply = "budget " + std::to_string(crawler.raiseBudget(maxPages));
+        return true;
+    });
+    server.addCommand("flush", "flush  (results, and the index's in-memory postings)",
+                      [flush = std::move(flushResults)](const std::vector<std::string>& args, std::string& reply) {
+        if (!args.empty()) return false;
+        return flush(reply);
+    });
+}
@@ -0,0 +1,225 @@
+#include "control_server.hpp"
+
+#include <iostream>
+#include <sstream>
+#include <cerrno>
+#include <cstring>
+#include <poll.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+
+// A client sending a longer line without a newline is disconnected.
+static constexpr size_t kMaxCommandLine {4096};
+// Connected clients; further connections are closed right away.
+static constexpr size_t kMaxClients {16};
+// Commands of a client are not read while this much of its output is unsent,
+// so a client that stops reading its replies only ever holds this much memory.
+static constexpr size_t kMaxPendingOutput {256 * 1024};
+
+// Sends as much of output as the socket takes without blocking, without
+// SIGPIPE if the client has gone away. False if the client is gone.
+static bool flushOutput(int fd, std::string& output) {
+    size_t offset {0};
+    while (offset < output.size()) {
+        ssize_t sent {::send(fd, output.data() + offset, output.size() - offset, MSG_NOSIGNAL | MSG_DONTWAIT)};
+        if (sent < 0) {
+            if (errno == EINTR) continue;
+            if (errno == EAGAIN || errno == EWOULDBLOCK) break;
+            return false;
+        }
+        offset += static_cast<size_t>(sent);
+    }
+    output.erase(0, offset);
+    return true;
+}
+
+ControlServer::~ControlServer() {
+    stop();
+}
+
+void ControlServer::addCommand(const std::string& name, const std::string& usage, Handler handler) {
+    m_commands[name] = Command {usage, std::move(handler)};
+}
+
+bool ControlServer::start(const std::string& path) {
+    sockaddr_un address {};
+    address.sun_family = AF_UNIX;
+    if (path.empty() || path.size() >= sizeof(address.sun_path)) {
+        std::cerr << "Control socket path is empty or too long: " << path << "\n";
+        return false;
+    }
+    std::memcpy(address.sun_path, path.c_str(), path.size() + 1);
+
+    m_listenFd = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (m_listenFd < 0 || ::pipe2(m_wakePipe, O_CLOEXEC) != 0) {
+        std::cerr << "Failed to create control socket: " << std::strerror(errno) << "\n";
+        stop();
+        return false;
+    }
+
+    // A previous run that was killed leaves its socket file behind; anything
+    // else at the path is the user's and stays untouched
+    struct stat existing {};
+    if (::lstat(path.c_str(), &existing) == 0) {
+        if (!S_ISSOCK(existing.st_mode)) {
+            std::cerr << "Control socket path exists and is not a socket: " << path << "\n";
+            stop();
+            return false;
+        }
+        ::unlink(path.c_str());
+    }
+
+    // The socket file is created owner-only, so other users can never reach it
+    const mode_t oldMask {::umask(S_IRWXG | S_IRWXO)};
+    const bool bound {::bind(m_listenFd, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) == 0};
+    const int bindError {errno};
+    ::umask(oldMask);
+    if (!bound || ::listen(m_listenFd, SOMAXCONN) != 0) {
+        std::cerr << "Failed to listen on " << path << ": " << std::strerror(bound ? errno : bindError) << "\n";
+        if (bound) ::unlink(path.c_str());
+        stop();
+        return false;
+    }
+    m_path = path;
+
+    m_thread = std::thread(&ControlServer::serve, this);
+    return true;
+}
+
+void ControlServer::stop() {
+    if (m_thread.joinable()) {
+        const char wake {'x'};
+        while (::write(m_wakePipe[1], &wake, 1) < 0 && errno == EINTR) {
+        }
+        m_thread.join();
+    }
+    for (int* fd : {&m_listenFd, &m_wakePipe[0], &m_wakePipe[1]}) {
+        if (*fd >= 0) {
+            ::close(*fd);
+            *fd = -1;
+        }
+    }
+    if (!m_path.empty()) {
+        ::unlink(m_path.c_str());
+        m_path.clear();
+    }
+}
+
+// Splits the line on whitespace and runs the command.
+std::string ControlServer::execute(const std::string& line) {
+    std::istringstream words(line);
+    std::vector<std::string> args;
+    std::string name;
+    words >> name;
+    for (std::string word; words >> word;) {
+        args.push_back(std::move(word));
+    }
+
+    std::string reply;
+    if (name == "help") {
+        for (const auto& [command, entry] : m_commands) {
+            reply += entry.usage + "\n";
+        }
+        reply += "help\nOK\n";
+        return reply;
+    }
+
+    auto command = m_commands.find(name);
+    if (command == m_commands.end()) {
+        return "ERR unknown command '" + name + "' (try help)\n";
+    }
+    if (!command->second.handler(args, reply)) {
+        return "ERR " + (reply.empty() ? "usage: " + command->second.usage : reply) + "\n";
+    }
+    if (!reply.empty() && reply.back() != '\n') reply += '\n';
+    return reply + "OK\n";
+}
+
+// Poll loop over the listening socket, the wake pipe and every client. Client
+// sockets are non-blocking and replies are queued per client, so a client that
+// stops reading never holds up the others.
+void ControlServer::serve() {
+    struct Client {
+        int fd;
+        std::string pending;  // Bytes after the last complete line
+        std::string output;   // Replies not sent yet
+        bool closing;         // Hung up or misbehaved: close once output is sent
+    };
+    std::vector<Client> clients;
+    std::vector<pollfd> fds;
+
+    while (true) {
+        fds.clear();
+        fds.push_back({m_wakePipe[0], POLLIN, 0});
+        fds.push_back({m_listenFd, POLLIN, 0});
+        for (const auto& client : clients) {
+            short events {0};
+            if (!client.closing && client.output.size() < kMaxPendingOutput) events |= POLLIN;
+            if (!client.output.empty()) events |= POLLOUT;
+            fds.push_back({client.fd, events, 0});
+        }
+        if (::poll(fds.data(), fds.size(), -1) < 0) {
+            if (errno == EINTR) continue;
+            std::cerr << "Control server poll failed: " << std::strerror(errno) << "\n";
+            break;
+        }
+        if (fds[0].revents != 0) break;
+
+        if (fds[1].revents & POLLIN) {
+            int fd {::accept4(m_listenFd, nullptr, nullptr, SOCK_CLOEXEC | SOCK_NONBLOCK)};
+            if (fd >= 0 && clients.size() >= kMaxClients) {
+                ::close(fd);
+            } else if (fd >= 0) {
+                clients.push_back(Client {fd, {}, {}, false});
+            }
+        }
+
+        // Clients accepted above are not in fds yet; they are polled next round
+        for (size_t i = 2; i < fds.size(); ++i) {
+            if (fds[i].revents == 0) continue;
+            Client& client = clients[i - 2];
+            bool open {true};
+
+            if (fds[i].revents & (POLLIN | POLLHUP | POLLERR)) {
+                char buffer[1024];
+                ssize_t received {::recv(client.fd, buffer, sizeof(buffer), 0)};
+                if (received > 0) {
+                    client.pending.append(buffer, static_cast<size_t>(received));
+                    size_t newline;
+                    while (!client.closing && (newline = client.pending.find('\n')) != std::string::npos) {
+                        std::string line = client.pending.substr(0, newline);
+                        client.pending.erase(0, newline + 1);
+                        if (!line.empty() && line.back() == '\r') line.pop_back();
+                        if (line.find_first_not_of(" \t") == std::string::npos) continue;
+                        client.output += execute(line);
+                    }
+                    if (client.pending.size() > kMaxCommandLine) {
+                        client.output += "ERR command too long\n";
+                        client.closing = true;
+                    }
+                } else if (received == 0) {
+                    // The client may have only shut down its sending side; its replies still go out
+                    client.closing = true;
+                } else if (errno != EINTR && errno != EAGAIN && errno != EWOULDBLOCK) {
+                    open = false;
+                }
+            }
+
+            if (open && !client.output.empty()) {
+                open = flushOutput(client.fd, client.output);
+            }
+            if (!open || (client.closing && client.output.empty())) {
+                ::close(client.fd);
+                client.fd = -1;
+            }
+        }
+        std::erase_if(clients, [](const Client& client) { return client.fd < 0; });
+    }
+
+    for (const auto& client : clients) {
+        ::close(client.fd);
+    }
+}
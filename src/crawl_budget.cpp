@@ -0,0 +1,83 @@
+#include "crawl_budget.hpp"
+
+#include <algorithm>
+
+// Strips the scheme, query and fragment: "https://a.com/b?c" -> "a.com/b".
+static std::string_view hostPath(std::string_view url) {
+    size_t scheme {url.find("://")};
+    if (scheme != std::string_view::npos) url.remove_prefix(scheme + 3);
+    size_t end {url.find_first_of("?#")};
+    if (end != std::string_view::npos) url = url.substr(0, end);
+    return url;
+}
+
+CrawlBudget::CrawlBudget(BudgetLimits limits)
+    : m_maxPages(limits.maxPages), m_limits(std::move(limits)) {
+    m_prefixPages.assign(m_limits.maxPagesPerPrefix.size(), 0);
+}
+
+bool CrawlBudget::tryReserve() {
+    size_t current {m_reserved.load(std::memory_order_relaxed)};
+    do {
+        if (current >= m_maxPages.load(std::memory_order_acquire)) return false;
+    } while (!m_reserved.compare_exchange_weak(current, current + 1, std::memory_order_acq_rel));
+    return true;
+}
+
+void CrawlBudget::release() {
+    m_reserved.fetch_sub(1, std::memory_order_acq_rel);
+}
+
+size_t CrawlBudget::raise(size_t maxPages) {
+    size_t current {m_maxPages.load(std::memory_order_relaxed)};
+    while (current < maxPages &&
+           !m_maxPages.compare_exchange_weak(current, maxPages, std::memory_order_acq_rel)) {
+    }
+    return std::max(current, maxPages);
+}
+
+bool CrawlBudget::hasScopedLimits() const {
+    return m_limits.maxPagesPerHost > 0 || !m_limits.maxPagesPerDepth.empty() ||
+           !m_limits.maxPagesPerPrefix.empty();
+}
+
+bool CrawlBudget::admitsLocked(const std::string& host, size_t depth, std::string_view path) const {
+    if (m_limits.maxPagesPerHost > 0) {
+        auto it {m_hostPages.find(host)};
+        if (it != m_hostPages.end() && it->second >= m_limits.maxPagesPerHost) return false;
+    }
+
+    auto depthLimit {m_limits.maxPagesPerDepth.find(depth)};
+    if (depthLimit != m_limits.maxPagesPerDepth.end()) {
+        auto it {m_depthPages.find(depth)};
+        const size_t used {it == m_depthPages.end() ? 0 : it->second};
+        if (used >= depthLimit->second) return false;
+    }
+
+    for (size_t i = 0; i < m_limits.maxPagesPerPrefix.size(); ++i) {
+        const auto& [prefix, limit] {m_limits.maxPagesPerPrefix[i]};
+        if (path.starts_with(prefix) && m_prefixPages[i] >= limit) return false;
+    }
+    return true;
+}
+
+bool CrawlBudget::admits(const std::string& host, size_t depth, std::string_view url) const {
+    if (!hasScopedLimits()) return true;
+    std::lock_guard<std::mutex> lock(m_scopedMutex);
+    return admitsLocked(host, depth, hostPath(url));
+}
+
+bool CrawlBudget::tryReserveScoped(const std::string& host, size_t depth, std::string_view url) {
+    if (!hasScopedLimits()) return true;
+
+    const std::string_view path {hostPath(url)};
+    std::lock_guard<std::mutex> lock(m_scopedMutex);
+    if (!admitsLocked(host, depth, path)) return false;
+
+    if (m_limits.maxPagesPerHost > 0) m_hostPages[host]++;
+    if (m_limits.maxPagesPerDepth.count(depth)) m_depthPages[depth]++;
+    for (size_t i = 0; i < m_limits.maxPagesPerPrefix.size(); ++i) {
+        if (path.starts_with(m_limits.maxPagesPerPrefix[i].first)) m_prefixPages[i]++;
+    }
+    return true;
+}
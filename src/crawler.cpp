@@ -1,62 +1,260 @@
 #include "crawler.hpp"
+#include "seed_loader.hpp"
+#include "mapped_file.hpp"
+#include "sitemap.hpp"
 
 #include <iostream>
 #include <algorithm>
 #include <sstream>
+#include <chrono>
+#include <unordered_map>
 #include <curl/curl.h>
 
-WebCrawler::WebCrawler(size_t numThreads, size_t maxPages)
-    : m_numThreads(numThreads), m_maxPages(maxPages) {
+// How many frontier entries a worker inspects looking for a host with a free slot.
+static constexpr size_t kMaxAdmissionScan {64};
+// Sites whose sitemaps are downloaded at the same time.
+static constexpr size_t kMaxSitemapThreads {4};
+// Fetched pages waiting for a parse thread. Bodies can be large, so keep this short.
+static constexpr size_t kParseQueueCapacity {64};
+// Parsed pages waiting for the dedup/enqueue thread.
+static constexpr size_t kEnqueueQueueCapacity {256};
+// Finished pages waiting for the result sink.
+static constexpr size_t kSinkQueueCapacity {1024};
+// Pages whose links the enqueue thread inserts under one frontier lock.
+static constexpr size_t kEnqueueBatchPages {32};
+// Fetch attempts per URL before a retryable failure is reported as final.
+static constexpr uint8_t kMaxFetchAttempts {4};
+// Resolution of the retry timer wheel.
+static constexpr std::chrono::milliseconds kRetryTick {100};
+// Threads resolving frontier hosts ahead of the fetches.
+static constexpr size_t kResolverThreads {8};
+// Queued hosts listed in a snapshot, besides the paused and fetching ones.
+static constexpr size_t kSnapshotHosts {50};
+
+WebCrawler::WebCrawler(const ConcurrencyLimits& limits, const BudgetLimits& budget)
+    : m_budget(budget), m_concurrency(limits), m_retryWheel(kRetryTick) {
+    // Fetch threads skip URLs whose host is still being resolved; wake them
+    // when a lookup finishes
+    m_resolver.setOnResolved([this] {
+        std::lock_guard<std::mutex> lock(m_frontierMutex);
+        m_frontierCondition.notify_all();
+    });
 }
 
 WebCrawler::~WebCrawler() {
     stop();
 }
 
+void WebCrawler::setDomainFilter(DomainFilter filter) {
+    m_domainFilter = std::move(filter);
+    m_allowSeedHostsOnly = !m_domainFilter.hasAllowRules();
+}
+
+// Reorders entries so that consecutive frontier entries rarely share a host,
+// which lets the per-host limits admit work from many hosts at once.
+static std::vector<FrontierEntry> interleaveByHost(std::vector<std::vector<FrontierEntry>>& batches) {
+    std::unordered_map<std::string, size_t> hostIndex;
+    std::vector<std::vector<FrontierEntry*>> buckets;
+    size_t total = 0;
+    
+    for (auto& batch : batches) {
+        total += batch.size();
+        for (auto& entry : batch) {
+            auto [it, inserted] = hostIndex.try_emplace(entry.host, buckets.size());
+            if (inserted) buckets.emplace_back();
+            buckets[it->second].push_back(&entry);
+        }
+    }
+    
+    std::vector<FrontierEntry> out;
+    out.reserve(total);
+    std::vector<size_t> active(buckets.size());
+    for (size_t i = 0; i < active.size(); ++i) active[i] = i;
+    
+    for (size_t round = 0; !active.empty(); ++round) {
+        size_t kept = 0;
+        for (size_t bucket : active) {
+            out.push_back(std::move(*buckets[bucket][round]));
+            if (round + 1 < buckets[bucket].size()) active[kept++] = bucket;
+        }
+        active.resize(kept);
+    }
+    return out;
+}
+
+size_t WebCrawler::enqueueSeeds(std::vector<std::vector<FrontierEntry>>& batches) {
+    std::vector<FrontierEntry> entries = interleaveByHost(batches);
+    batches.clear();
+    
+    // Without an explicit allow-list, the seed hosts define the crawl scope.
+    // Workers are not running yet, so the filter can still be modified.
+    if (m_allowSeedHostsOnly) {
+        std::vector<std::string_view> hosts;
+        hosts.reserve(entries.size());
+        for (const auto& entry : entries) {
+            hosts.push_back(entry.host);
+        }
+        m_domainFilter.allowAll(hosts);
+    }
+    
+    // Remember one URL per host to discover its sitemaps from
+    for (const auto& entry : entries) {
+        if (m_seedHosts.insert(entry.host).second) {
+            m_seedSites.push_back(entry.url);
+        }
+    }
+    
+    size_t added = 0;
+    std::lock_guard<std::mutex> lock(m_frontierMutex);
+    m_visitedUrls.reserve(m_visitedUrls.size() + entries.size());
+    for (auto& entry : entries) {
+        if (m_visitedUrls.insert(entry.url).second) {
+            pushFrontier(std::move(entry));
+            added++;
+        }
+    }
+    return added;
+}
+
+size_t WebCrawler::addSeeds(const std::vector<std::string>& urls) {
+    std::vector<std::vector<FrontierEntry>> batches(1);
+    for (const auto& url : urls) {
+        FrontierEntry entry;
+        entry.url = normalizeUrl(url);
+        entry.host = extractHost(entry.url);
+        if (entry.host.empty()) continue;
+        if (m_allowSeedHostsOnly ? m_domainFilter.isBlocked(entry.host) : !shouldCrawl(entry.host)) continue;
+        batches[0].push_back(std::move(entry));
+    }
+    return enqueueSeeds(batches);
+}
+
+size_t WebCrawler::loadSeedFile(const std::string& path) {
+    MappedFile file;
+    if (!file.open(path)) return 0;
+    
+    // Each thread normalizes and filters its own chunk into its own batch, so
+    // the frontier lock is only taken once for the whole file.
+    const size_t numChunks = std::max(1u, std::thread::hardware_concurrency());
+    std::vector<std::vector<FrontierEntry>> batches(numChunks);
+    forEachSeedLine(file.data(), numChunks, [&](size_t chunk, std::string_view line) {
+        FrontierEntry entry;
+        entry.url = normalizeUrl(std::string(line));
+        entry.host = extractHost(entry.url);
+        if (entry.host.empty()) return;
+        if (m_allowSeedHostsOnly ? m_domainFilter.isBlocked(entry.host) : !shouldCrawl(entry.host)) return;
+        batches[chunk].push_back(std::move(entry));
+    });
+    
+    return enqueueSeeds(batches);
+}
+
 void WebCrawler::start(const std::string& startUrl) {
+    addSeeds({startUrl});
+    start();
+}
+
+void WebCrawler::start() {
     // Initialize curl for the main thread
     if (curl_global_init(CURL_GLOBAL_DEFAULT) != CURLE_OK) {
         std::cerr << "Global initializing failed." << "\n";
         return;
     }
     
-    // Extract base domain
-    CURLU* handle = curl_url();
-    if (handle) {
-        if (curl_url_set(handle, CURLUPART_URL, startUrl.c_str(), 0) == CURLUE_OK) {
-            char* host = nullptr;
-            if (curl_url_get(handle, CURLUPART_HOST, &host, 0) == CURLUE_OK) {
-                m_baseDomain = host ? std::string(host) : "";
-                curl_free(host);
-            }
+    m_shouldStop = false;
+    
+    // Sitemap threads count as active workers so the crawl does not end while
+    // they may still add URLs to an empty frontier
+    if (m_sitemapDiscovery && !m_seedSites.empty()) {
+        const size_t numSitemapThreads = std::min(kMaxSitemapThreads, m_seedSites.size());
+        {
+            std::lock_guard<std::mutex> lock(m_frontierMutex);
+            m_activeWorkers += numSitemapThreads;
+        }
+        for (size_t i = 0; i < numSitemapThreads; ++i) {
+            m_sitemapThreads.emplace_back(&WebCrawler::sitemapWorker, this);
         }
-        curl_url_cleanup(handle);
     }
     
-    // Normalize and add starting URL to frontier
-    std::string normalized = normalizeUrl(startUrl);
-    {
-        std::lock_guard<std::mutex> lock(m_frontierMutex);
-        FrontierEntry entry;
-        entry.url = normalized;
-        entry.referrerUrl = "";  // Starting URL has no referrer
-        entry.referrerTitle = "";
-        m_frontier.push(entry);
-        m_visitedUrls.insert(normalized);
+    // CPU stages: parsing and link processing scale with cores, dedup/enqueue and
+    // the result sink are single threads that own the frontier lock and the output
+    const size_t numParseThreads = m_parseThreadCount > 0
+        ? m_parseThreadCount : std::max(1u, std::thread::hardware_concurrency());
+    m_parseQueue = std::make_unique<BoundedChannel<FetchedPage>>(kParseQueueCapacity);
+    m_enqueueQueue = std::make_unique<BoundedChannel<ParsedLinks>>(kEnqueueQueueCapacity);
+    m_sinkQueue = std::make_unique<BoundedChannel<CrawlResult>>(kSinkQueueCapacity);
+    for (size_t i = 0; i < numParseThreads; ++i) {
+        m_parseThreads.emplace_back(&WebCrawler::parseWorker, this);
     }
+    m_enqueueThread = std::thread(&WebCrawler::enqueueWorker, this);
+    m_sinkThread = std::thread(&WebCrawler::sinkWorker, this);
+    m_retryStop = false;
+    m_retryThread = std::thread(&WebCrawler::retryWorker, this);
+    m_resolver.start(kResolverThreads);
     
-    // Start worker threads
-    m_shouldStop = false;
-    for (size_t i = 0; i < m_numThreads; ++i) {
-        m_threads.emplace_back(&WebCrawler::workerThread, this);
+    // Seeds were queued before per-host counting was switched on
+    m_crawlStart = std::chrono::steady_clock::now();
+    if (m_statsInterval.count() > 0) {
+        {
+            std::lock_guard<std::mutex> lock(m_frontierMutex);
+            m_hostQueued.clear();
+            for (const auto& entry : m_frontier) {
+                m_hostQueued[entry.host]++;
+            }
+            m_trackHosts = true;
+        }
+        m_statsStop = false;
+        m_statsThread = std::thread(&WebCrawler::statsWorker, this);
     }
     
-    // Wait for all threads to finish
+    // I/O stage: one fetch thread per slot the controller may ever grant; the
+    // controller decides how many of them are fetching at any moment
+    for (size_t i = 0; i < m_concurrency.maxLimit(); ++i) {
+        m_threads.emplace_back(&WebCrawler::fetchWorker, this);
+    }
+    
+    // Fetch threads exit once the crawl is finished; then drain the pipeline
+    // stage by stage, so every fetched page still reaches the sink
     for (auto& thread : m_threads) {
         if (thread.joinable()) {
             thread.join();
         }
     }
+    for (auto& thread : m_sitemapThreads) {
+        if (thread.joinable()) {
+            thread.join();
+        }
+    }
+    m_sitemapThreads.clear();
+    
+    // Retries still waiting (only after stop()) are reported as failures
+    {
+        std::lock_guard<std::mutex> lock(m_retryMutex);
+        m_retryStop = true;
+    }
+    m_retryCondition.notify_all();
+    m_retryThread.join();
+    abandonRetries();
+    m_resolver.stop();
+    
+    m_parseQueue->close();
+    for (auto& thread : m_parseThreads) {
+        thread.join();
+    }
+    m_parseThreads.clear();
+    m_enqueueQueue->close();
+    m_enqueueThread.join();
+    m_sinkQueue->close();
+    m_sinkThread.join();
+    
+    if (m_statsThread.joinable()) {
+        {
+            std::lock_guard<std::mutex> lock(m_statsMutex);
+            m_statsStop = true;
+        }
+        m_statsCondition.notify_all();
+        m_statsThread.join();
+    }
     
     curl_global_cleanup();
 }
@@ -71,6 +269,65 @@ void WebCrawler::stop() {
         }
     }
     m_threads.clear();
+    for (auto& thread : m_sitemapThreads) {
+        if (thread.joinable()) {
+            thread.join();
+        }
+    }
+    m_sitemapThreads.clear();
+}
+
+// Adds a batch of discovered URLs to the frontier under a single lock, freshest
+// first. Returns false once the crawl no longer needs more URLs.
+bool WebCrawler::enqueueBatch(std::vector<FrontierEntry>& entries) {
+    std::stable_sort(entries.begin(), entries.end(), [](const FrontierEntry& a, const FrontierEntry& b) {
+        return a.lastModified > b.lastModified;
+    });
+    
+    std::lock_guard<std::mutex> lock(m_frontierMutex);
+    size_t added = 0;
+    for (auto& entry : entries) {
+        if (m_shouldStop || m_budget.exhausted()) break;
+        if (!m_budget.admits(entry.host, entry.depth, entry.url)) continue;
+        if (m_visitedUrls.insert(entry.url).second) {
+            pushFrontier(std::move(entry));
+            added++;
+        }
+    }
+    notifyFetchers(added);
+    return !m_shouldStop && !m_budget.exhausted();
+}
+
+void WebCrawler::sitemapWorker() {
+    for (size_t site = m_nextSitemapSite++; site < m_seedSites.size(); site = m_nextSitemapSite++) {
+        if (m_shouldStop || m_budget.exhausted()) break;
+        
+        const std::string& siteUrl = m_seedSites[site];
+        std::vector<FrontierEntry> entries;
+        size_t found = ingestSitemaps(siteUrl, [&](std::vector<SitemapEntry>& batch) {
+            entries.clear();
+            for (auto& item : batch) {
+                FrontierEntry entry;
+                entry.url = normalizeUrl(item.loc);
+                entry.host = extractHost(entry.url);
+                if (!shouldCrawl(entry.host)) continue;
+                entry.referrerUrl = siteUrl;
+                entry.lastModified = item.lastModified;
+                entry.depth = 1;  // One hop from the seed, like a link on its home page
+                entry.shape = TrapDetector::classify(entry.url);
+                entries.push_back(std::move(entry));
+            }
+            return enqueueBatch(entries);
+        });
+        
+        if (found > 0) {
+            std::cout << "Sitemaps for " << siteUrl << ": " << found << " URLs\n";
+        }
+    }
+    
+    std::lock_guard<std::mutex> lock(m_frontierMutex);
+    markWorkerIdle();
+    notifyFetchers(0);
 }
 
 std::vector<CrawlResult> WebCrawler::getResults() const {
@@ -78,9 +335,94 @@ std::vector<CrawlResult> WebCrawler::getResults() const {
     return m_results;
 }
 
-bool WebCrawler::isFrontierEmpty() const {
+// Queues a URL, or parks it if its host is paused, and starts resolving its
+// host so the address is known by the time the URL is fetched.
+// Called while holding m_frontierMutex.
+void WebCrawler::pushFrontier(FrontierEntry&& entry) {
+    m_resolver.request(entry.host);
+    if (!m_pausedHosts.empty()) {
+        auto paused = m_pausedHosts.find(entry.host);
+        if (paused != m_pausedHosts.end()) {
+            paused->second.push_back(std::move(entry));
+            m_pausedUrls++;
+            return;
+        }
+    }
+    if (m_trackHosts) {
+        m_hostQueued[entry.host]++;
+    }
+    m_frontier.push_back(std::move(entry));
+}
+
+// Wakes one fetch thread per URL made available instead of all of them, except
+// once the crawl is over and every thread has to see that. Needs m_frontierMutex.
+void WebCrawler::notifyFetchers(size_t available) {
+    if (isCrawlFinished() || available >= m_concurrency.maxLimit()) {
+        m_frontierCondition.notify_all();
+        return;
+    }
+    for (size_t i = 0; i < available; ++i) {
+        m_frontierCondition.notify_one();
+    }
+}
+
+// Called while holding m_frontierMutex, for every entry leaving the frontier.
+void WebCrawler::untrackQueued(const std::string& host) {
+    if (!m_trackHosts) return;
+    auto it = m_hostQueued.find(host);
+    if (it != m_hostQueued.end() && --it->second == 0) {
+        m_hostQueued.erase(it);
+    }
+}
+
+bool WebCrawler::pauseHost(const std::string& host) {
+    std::lock_guard<std::mutex> lock(m_frontierMutex);
+    auto [paused, inserted] = m_pausedHosts.try_emplace(host);
+    if (!inserted) return false;
+    
+    // One pass keeps the order of both the frontier and the parked URLs
+    std::deque<FrontierEntry> kept;
+    for (auto& entry : m_frontier) {
+        if (entry.host == host) {
+            paused->second.push_back(std::move(entry));
+        } else {
+            kept.push_back(std::move(entry));
+        }
+    }
+    m_frontier.swap(kept);
+    m_pausedUrls += paused->second.size();
+    m_hostQueued.erase(host);
+    return true;
+}
+
+bool WebCrawler::resumeHost(const std::string& host) {
+    std::lock_guard<std::mutex> lock(m_frontierMutex);
+    auto paused = m_pausedHosts.find(host);
+    if (paused == m_pausedHosts.end()) return false;
+    
+    std::deque<FrontierEntry> entries = std::move(paused->second);
+    m_pausedHosts.erase(paused);
+    m_pausedUrls -= entries.size();
+    for (auto& entry : entries) {
+        pushFrontier(std::move(entry));
+    }
+    notifyFetchers(entries.size());
+    return true;
+}
+
+size_t WebCrawler::setConcurrencyCeiling(size_t ceiling) {
+    const size_t applied = m_concurrency.setCeiling(ceiling);
+    // Raising the ceiling does not free a slot by itself; let waiters re-check
     std::lock_guard<std::mutex> lock(m_frontierMutex);
-    return m_frontier.empty() && m_activeWorkers == 0;
+    m_frontierCondition.notify_all();
+    return applied;
+}
+
+size_t WebCrawler::raiseBudget(size_t maxPages) {
+    const size_t applied = m_budget.raise(maxPages);
+    std::lock_guard<std::mutex> lock(m_frontierMutex);
+    m_frontierCondition.notify_all();
+    return applied;
 }
 
 void WebCrawler::markWorkerActive() {
@@ -93,275 +435,568 @@ void WebCrawler::markWorkerIdle() {
     m_activeWorkers--;
 }
 
-void WebCrawler::workerThread() {
+// Pops the first frontier entry whose host is not being resolved, has a free
+// fetch slot and whose scoped budgets (host, depth, path prefix) have room.
+// Entries whose scoped budget is already spent, or whose host did not resolve,
+// can never be fetched and are dropped on the way, before any budget or fetch
+// slot is taken for them.
+// Called while holding m_frontierMutex, with a global budget slot reserved.
+bool WebCrawler::popAdmissibleEntry(FrontierEntry& entry) {
+    size_t scanned = 0;
+    for (auto it = m_frontier.begin(); it != m_frontier.end() && scanned < kMaxAdmissionScan;) {
+        if (!m_budget.admits(it->host, it->depth, it->url)) {
+            untrackQueued(it->host);
+            it = m_frontier.erase(it);
+            continue;
+        }
+        const HostResolver::State dns = m_resolver.request(it->host);
+        if (dns == HostResolver::State::Failed) {
+            untrackQueued(it->host);
+            it = m_frontier.erase(it);
+            m_unresolvedUrls++;
+            continue;
+        }
+        if (dns == HostResolver::State::Pending) {
+            ++it;
+            ++scanned;
+            continue;
+        }
+        if (m_concurrency.tryAcquire(it->host)) {
+            if (m_budget.tryReserveScoped(it->host, it->depth, it->url)) {
+                untrackQueued(it->host);
+                entry = std::move(*it);
+                m_frontier.erase(it);
+                return true;
+            }
+            m_concurrency.cancel(it->host);
+        }
+        ++it;
+        ++scanned;
+    }
+    return false;
+}
+
+// Pops the first ready retry whose host is not paused and has a free fetch
+// slot. Its budget slots were reserved on the first attempt.
+// Called while holding m_frontierMutex.
+bool WebCrawler::popReadyRetry(FrontierEntry& entry) {
+    size_t scanned = 0;
+    for (auto it = m_readyRetries.begin(); it != m_readyRetries.end() && scanned < kMaxAdmissionScan; ++it, ++scanned) {
+        if (!m_pausedHosts.empty() && m_pausedHosts.count(it->entry.host)) continue;
+        if (m_concurrency.tryAcquire(it->entry.host)) {
+            entry = std::move(it->entry);
+            m_readyRetries.erase(it);
+            return true;
+        }
+    }
+    return false;
+}
+
+// True once no worker will ever find more work: the budget is fully reserved
+// or nothing is queued (paused hosts included), and no page in flight could
+// still add URLs or come back for a retry.
+// Called while holding m_frontierMutex.
+bool WebCrawler::isCrawlFinished() const {
+    return (m_budget.exhausted() || (m_frontier.empty() && m_pausedUrls == 0)) && m_activeWorkers == 0;
+}
+
+void WebCrawler::fetchWorker() {
     // curl_global_init is already called in start(), and it's thread-safe
     // No need to call it again here
     
-    while (!m_shouldStop) {
+    while (true) {
         FrontierEntry entry;
-        bool hasWork = false;
         
         // Get URL from frontier queue
         {
             std::unique_lock<std::mutex> lock(m_frontierMutex);
-            // Wait until frontier has work, we should stop, or max pages reached
+            // Wait until there is a due retry or a fetchable URL, we should stop, or the crawl is finished
             m_frontierCondition.wait(lock, [this] {
-                return !m_frontier.empty() || m_shouldStop || 
-                       (m_pagesCrawled >= m_maxPages && m_activeWorkers == 0);
+                return m_shouldStop || isCrawlFinished() ||
+                       (m_concurrency.hasCapacity() &&
+                        (!m_readyRetries.empty() || (!m_frontier.empty() && !m_budget.exhausted())));
             });
             
-            // Check stop conditions: explicit stop, max pages reached, or frontier empty
-            if (m_shouldStop) {
+            if (m_shouldStop || isCrawlFinished()) {
                 break;
             }
             
-            // If we've reached max pages and no active workers, stop
-            if (m_pagesCrawled >= m_maxPages && m_activeWorkers == 0) {
-                break;
-            }
-            
-            // If frontier is empty, continue waiting (or exit if all done)
-            if (m_frontier.empty()) {
-                // If no active workers and frontier is empty, we're done
-                if (m_activeWorkers == 0) {
-                    break;
+            // Due retries first: they already hold a budget slot and count as active
+            if (!popReadyRetry(entry)) {
+                // Reserve the fetch before popping, so the page budget can never be
+                // overshot and no URL is taken off the frontier only to be dropped
+                if (m_frontier.empty() || !m_budget.tryReserve()) {
+                    m_frontierCondition.wait(lock);
+                    continue;
+                }
+                
+                // Get entry from frontier, skipping hosts that are at their limit.
+                // If nothing is admissible, sleep until a running fetch releases its slot.
+                if (!popAdmissibleEntry(entry)) {
+                    m_budget.release();
+                    if (isCrawlFinished()) {
+                        m_frontierCondition.notify_all();
+                        break;
+                    }
+                    m_frontierCondition.wait(lock);
+                    continue;
                 }
+                // The page counts as active until the enqueue stage has added its links
+                markWorkerActive();
+            }
+        }
+        
+        FetchedPage page;
+        
+        // Frontier URLs of hosts that did not resolve never get here (they are
+        // dropped at admission); a retry whose host has no address left fails
+        // without a transfer, and before the breaker, which would otherwise
+        // wait for a probe that never runs
+        std::vector<std::string> addresses;
+        std::string dnsError;
+        const HostResolver::State dns = m_resolver.lookup(entry.host, addresses, dnsError);
+        if (dns == HostResolver::State::Failed) {
+            m_concurrency.cancel(entry.host);
+            page.error = "DNS lookup failed: " + dnsError;
+            page.entry = std::move(entry);
+            m_parseQueue->push(std::move(page));
+            continue;
+        }
+        
+        // While a host's circuit breaker is open its URLs wait for the cooldown
+        // without a request; once the host is given up on they fail
+        auto reopenAt = std::chrono::steady_clock::time_point();
+        if (!m_hostHealth.allowRequest(entry.host, reopenAt)) {
+            m_concurrency.cancel(entry.host);
+            if (reopenAt != std::chrono::steady_clock::time_point::max() && !m_shouldStop) {
+                scheduleRetry(RetryItem {std::move(entry), "Host circuit breaker open"}, reopenAt);
                 continue;
             }
-            
-            // Get entry from frontier
-            entry = m_frontier.front();
-            m_frontier.pop();
-            hasWork = true;
-            markWorkerActive();  // Mark active while holding lock
+            page.error = "Host unreachable: circuit breaker open";
+            page.entry = std::move(entry);
+            m_parseQueue->push(std::move(page));
+            continue;
         }
         
-        if (hasWork) {
-            // Process the URL (outside the lock for better concurrency)
-            processUrl(entry.url);
-            
-            // Mark idle after processing
-            {
-                std::lock_guard<std::mutex> lock(m_frontierMutex);
-                markWorkerIdle();
-                // Notify other threads that a worker is now idle
-                m_frontierCondition.notify_all();
+        // Fetch outside the lock; the latency sample covers the network only
+        FetchOptions options = m_hostHealth.timeoutsFor(entry.host, entry.attempts);
+        if (dns == HostResolver::State::Resolved) {
+            std::string pinned = resolveEntry(entry.url, entry.host, addresses);
+            if (!pinned.empty()) options.resolve.push_back(std::move(pinned));
+        }
+        auto fetchStart = std::chrono::steady_clock::now();
+        page.ok = getHttp(entry.url, page.http, page.error, options);
+        auto latency = std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::steady_clock::now() - fetchStart);
+        
+        FetchOutcome outcome = FetchOutcome::Success;
+        if (!page.ok) {
+            outcome = FetchOutcome::Error;
+        } else if (page.http.status == 429 || page.http.status == 503) {
+            outcome = FetchOutcome::Throttled;
+        }
+        m_concurrency.release(entry.host, outcome, latency);
+        
+        const FailureClass failure = classifyFailure(page.ok, page.http.curlCode, page.http.status);
+        if (failure == FailureClass::None) {
+            m_hostHealth.recordSuccess(entry.host, latency);
+        } else {
+            m_hostHealth.recordFailure(entry.host, page.http.curlCode == CURLE_OPERATION_TIMEDOUT, options.timeout,
+                                       entry.attempts > 0);
+        }
+        
+        // A fetch slot was freed; one waiter can use it
+        {
+            std::lock_guard<std::mutex> lock(m_frontierMutex);
+            if (!m_frontier.empty() || !m_readyRetries.empty()) {
+                m_frontierCondition.notify_one();
             }
         }
         
-        // Check if we should stop after processing
-        if (m_pagesCrawled >= m_maxPages) {
-            // Notify other threads that we're done
-            m_frontierCondition.notify_all();
-            break;
+        // Transient failures go back on the timer wheel instead of into the
+        // results, after the server's Retry-After or a jittered backoff
+        if (failure == FailureClass::Retryable && entry.attempts + 1 < kMaxFetchAttempts && !m_shouldStop) {
+            entry.attempts++;
+            std::optional<std::chrono::seconds> retryAfter;
+            if (page.ok) {
+                retryAfter = parseRetryAfter(page.http.headers.retryAfter());
+            }
+            const auto deadline = std::chrono::steady_clock::now() + retryDelay(entry.attempts, retryAfter);
+            std::string lastError = page.ok ? "HTTP " + std::to_string(page.http.status) : std::move(page.error);
+            scheduleRetry(RetryItem {std::move(entry), std::move(lastError)}, deadline);
+            m_retriesScheduled++;
+            continue;
         }
+        
+        // Blocks while the parse stage is behind
+        page.entry = std::move(entry);
+        m_parseQueue->push(std::move(page));
     }
 }
 
-bool WebCrawler::shouldCrawl(const std::string& url) {
-    // Check if URL is valid
-    CURLU* handle = curl_url();
-    if (!handle) return false;
-    
-    bool isValid = curl_url_set(handle, CURLUPART_URL, url.c_str(), 0) == CURLUE_OK;
-    if (!isValid) {
-        curl_url_cleanup(handle);
-        return false;
-    }
-    
-    // Extract host from URL to compare with base domain
-    std::string urlHost;
-    char* host = nullptr;
-    if (curl_url_get(handle, CURLUPART_HOST, &host, 0) == CURLUE_OK) {
-        if (host) {
-            urlHost = host;
-            curl_free(host);
+// Puts a URL on the timer wheel; the retry thread hands it back to the fetch
+// threads once the deadline has passed.
+void WebCrawler::scheduleRetry(RetryItem item, std::chrono::steady_clock::time_point deadline) {
+    std::lock_guard<std::mutex> lock(m_retryMutex);
+    m_retryWheel.schedule(std::move(item), deadline);
+}
+
+// Retry stage: advances the timer wheel every tick and hands due URLs to the
+// fetch threads. No fetch thread is held while a URL waits.
+void WebCrawler::retryWorker() {
+    std::vector<RetryItem> due;
+    std::unique_lock<std::mutex> lock(m_retryMutex);
+    while (!m_retryStop) {
+        m_retryCondition.wait_for(lock, kRetryTick);
+        m_retryWheel.advance(std::chrono::steady_clock::now(), due);
+        if (due.empty()) continue;
+        
+        lock.unlock();
+        {
+            std::lock_guard<std::mutex> frontierLock(m_frontierMutex);
+            for (auto& item : due) {
+                m_readyRetries.push_back(std::move(item));
+            }
+            notifyFetchers(due.size());
         }
+        due.clear();
+        lock.lock();
     }
-    curl_url_cleanup(handle);
-    
-    // Check if URL is from the same domain (optional: can be modified to crawl external links)
-    // For now, we'll only crawl same-domain links
-    if (!m_baseDomain.empty() && urlHost != m_baseDomain) {
-        return false;
-    }
-    
-    // Note: We don't check visitedUrls here to avoid deadlock
-    // The caller will do a final check while holding the lock
-    
-    return true;
 }
 
-std::string WebCrawler::normalizeUrl(const std::string& url) {
-    std::string normalized = url;
-    
-    // Remove fragment (everything after #)
-    size_t pos = normalized.find('#');
-    if (pos != std::string::npos) {
-        normalized.resize(pos);
-    }
-    
-    // Remove trailing slash for consistency
-    // This normalizes "https://example.com/" to "https://example.com"
-    // and "https://example.com/page/" to "https://example.com/page"
-    if (normalized.length() > 1 && normalized.back() == '/') {
-        normalized.pop_back();
+// Stats stage: publishes a snapshot every interval, and a final one once the
+// pipeline has drained.
+void WebCrawler::statsWorker() {
+    using Clock = std::chrono::steady_clock;
+    auto lastTime = m_crawlStart;
+    size_t lastPages = 0;
+    std::unique_lock<std::mutex> lock(m_statsMutex);
+    while (true) {
+        const bool stopping = m_statsCondition.wait_for(lock, m_statsInterval, [this] { return m_statsStop; });
+        lock.unlock();
+        
+        const auto now = Clock::now();
+        const size_t pages = m_pagesCrawled;
+        const double seconds = std::chrono::duration<double>(now - lastTime).count();
+        publishSnapshot(seconds > 0.0 ? (pages - lastPages) / seconds : 0.0, stopping);
+        lastTime = now;
+        lastPages = pages;
+        
+        if (stopping) break;
+        lock.lock();
     }
-    
-    return normalized;
 }
 
-std::string WebCrawler::resolveUrl(const std::string& baseUrl, const std::string& relativeUrl) {
-    // If relativeUrl is already absolute, validate and return it
-    if (relativeUrl.find("://") != std::string::npos) {
-        CURLU* handle = curl_url();
-        if (!handle) return "";
-        CURLUcode rc = curl_url_set(handle, CURLUPART_URL, relativeUrl.c_str(), 0);
-        if (rc != CURLUE_OK) {
-            curl_url_cleanup(handle);
-            return "";
-        }
-        char* resolved = nullptr;
-        std::string result;
-        if (curl_url_get(handle, CURLUPART_URL, &resolved, 0) == CURLUE_OK) {
-            if (resolved) {
-                result = resolved;
-                curl_free(resolved);
-            }
-        }
-        curl_url_cleanup(handle);
-        return result;
+// Builds a snapshot from each component in turn, never holding two locks, so
+// its parts may be a few microseconds apart.
+void WebCrawler::publishSnapshot(double pagesPerSecond, bool finished) {
+    auto snapshot = std::make_shared<CrawlSnapshot>();
+    snapshot->elapsedSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - m_crawlStart).count();
+    snapshot->pagesCrawled = m_pagesCrawled;
+    snapshot->pagesPerSecond = pagesPerSecond;
+    if (snapshot->elapsedSeconds > 0.0) {
+        snapshot->averagePagesPerSecond = snapshot->pagesCrawled / snapshot->elapsedSeconds;
     }
+    snapshot->retriesScheduled = m_retriesScheduled;
+    snapshot->budgetReserved = m_budget.reserved();
+    snapshot->budgetMax = m_budget.maxPages();
+    snapshot->finished = finished;
     
-    // Use curl's URL API to resolve relative URLs
-    CURLU* handle = curl_url();
-    if (!handle) return "";
-    
-    // Set base URL first
-    if (curl_url_set(handle, CURLUPART_URL, baseUrl.c_str(), 0) != CURLUE_OK) {
-        curl_url_cleanup(handle);
-        return "";
+    const std::unordered_map<std::string, size_t> inFlight = m_concurrency.inFlightByHost();
+    snapshot->concurrencyLimit = m_concurrency.limit();
+    snapshot->concurrencyCeiling = m_concurrency.ceiling();
+    for (const auto& [host, count] : inFlight) {
+        snapshot->inFlight += count;
     }
     
-    // For relative URLs, we need to manually resolve the path
-    // Get the current path from base URL
-    char* basePath = nullptr;
-    curl_url_get(handle, CURLUPART_PATH, &basePath, 0);
-    
-    std::string resolvedPath;
-    if (relativeUrl.empty()) {
-        resolvedPath = basePath ? basePath : "/";
-    } else if (relativeUrl[0] == '/') {
-        // Absolute path - use it directly
-        resolvedPath = relativeUrl;
-    } else {
-        // Relative path - resolve against base path
-        std::string currentPath = basePath ? basePath : "/";
-        // Remove filename from current path if it exists (keep directory)
-        size_t lastSlash = currentPath.find_last_of('/');
-        if (lastSlash != std::string::npos) {
-            currentPath = currentPath.substr(0, lastSlash + 1);
-        }
-        resolvedPath = currentPath + relativeUrl;
+    {
+        std::lock_guard<std::mutex> lock(m_retryMutex);
+        snapshot->waitingRetries = m_retryWheel.size();
     }
     
-    if (basePath) curl_free(basePath);
-    
-    // Set the resolved path
-    if (curl_url_set(handle, CURLUPART_PATH, resolvedPath.c_str(), 0) != CURLUE_OK) {
-        curl_url_cleanup(handle);
-        return "";
+    {
+        std::lock_guard<std::mutex> lock(m_frontierMutex);
+        snapshot->frontierSize = m_frontier.size();
+        snapshot->pausedUrls = m_pausedUrls;
+        snapshot->activePages = m_activeWorkers;
+        snapshot->waitingRetries += m_readyRetries.size();
+        
+        // Only the busiest queued hosts are copied out while the lock is held
+        std::vector<const std::pair<const std::string, size_t>*> busiest;
+        busiest.reserve(m_hostQueued.size());
+        for (const auto& queued : m_hostQueued) {
+            busiest.push_back(&queued);
+        }
+        const size_t listed = std::min(kSnapshotHosts, busiest.size());
+        std::partial_sort(busiest.begin(), busiest.begin() + listed, busiest.end(),
+                          [](const auto* a, const auto* b) { return a->second > b->second; });
+        
+        std::unordered_set<std::string_view> seen;
+        auto addHost = [&](const std::string& host, size_t queued, bool paused) {
+            if (!seen.insert(host).second) return;
+            auto fetching = inFlight.find(host);
+            snapshot->hosts.push_back(HostSnapshot {host, queued,
+                                                    fetching != inFlight.end() ? fetching->second : 0, paused});
+        };
+        for (const auto& [host, entries] : m_pausedHosts) {
+            addHost(host, entries.size(), true);
+        }
+        for (const auto& [host, count] : inFlight) {
+            auto queued = m_hostQueued.find(host);
+            addHost(host, queued != m_hostQueued.end() ? queued->second : 0, false);
+        }
+        for (size_t i = 0; i < listed; ++i) {
+            addHost(busiest[i]->first, busiest[i]->second, false);
+        }
     }
+    std::sort(snapshot->hosts.begin(), snapshot->hosts.end(), [](const HostSnapshot& a, const HostSnapshot& b) {
+        return a.queued + a.inFlight > b.queued + b.inFlight;
+    });
     
-    // Get the final resolved URL
-    char* resolved = nullptr;
-    std::string result;
-    if (curl_url_get(handle, CURLUPART_URL, &resolved, 0) == CURLUE_OK) {
-        if (resolved) {
-            result = resolved;
-            curl_free(resolved);
+    m_snapshot.publish(std::move(snapshot));
+}
+
+// Reports every retry that will not happen as a failed page, so it still
+// reaches the results and releases its place among the active pages.
+// Called after the fetch and retry threads have exited.
+void WebCrawler::abandonRetries() {
+    std::vector<RetryItem> items;
+    m_retryWheel.drain(items);
+    {
+        std::lock_guard<std::mutex> lock(m_frontierMutex);
+        for (auto& item : m_readyRetries) {
+            items.push_back(std::move(item));
         }
+        m_readyRetries.clear();
+    }
+    for (auto& item : items) {
+        FetchedPage page;
+        page.error = "Retry abandoned: " + item.lastError;
+        page.entry = std::move(item.entry);
+        m_parseQueue->push(std::move(page));
     }
-    
-    curl_url_cleanup(handle);
-    return result;
 }
 
-void WebCrawler::processUrl(const std::string& url) {
-    CrawlResult result;
-    result.url = url;
-    
-    HttpResult httpResult;
-    std::string error;
-    
-    if (getHttp(url, httpResult, error)) {
-        result.status = httpResult.status;
-        result.title = extractTitle(httpResult.body);
-        
-        // Extract links from the crawled web page
-        std::vector<std::string> links = extractLinks(httpResult.body);
-        result.linkCount = links.size();
+// Parse stage: one parse per page for the title, the links and (when indexing)
+// the visible text, then link processing. Runs on the CPU threads.
+void WebCrawler::parseWorker() {
+    FetchedPage page;
+    while (m_parseQueue->pop(page)) {
+        ParsedLinks parsed;
+        parsed.host = page.entry.host;
+        parsed.shape = page.entry.shape;
+        CrawlResult& result = parsed.result;
+        result.url = page.entry.url;
+        result.lastModified = page.entry.lastModified;
         
-        // Prepare new frontier entries with web page info
-        std::vector<FrontierEntry> entriesToAdd;
-        for (const auto& link : links) {
-            // Skip bad schemes (javascript:, mailto:, tel:, data:)
-            if (link.find("javascript:") == 0 || 
-                link.find("mailto:") == 0 || 
-                link.find("tel:") == 0 ||
-                link.find("data:") == 0) {
-                continue;
-            }
+        if (page.ok) {
+            result.status = page.http.status;
             
-            // Resolve relative URLs to absolute URLs
-            std::string resolved = resolveUrl(url, link);
-            if (resolved.empty()) continue;
+            const bool indexable = m_indexer && page.http.status >= 200 && page.http.status < 300;
+            ParsedPage parsedPage = parsePage(page.http.body.str(), indexable);
+            result.title = std::move(parsedPage.title);
+            result.linkCount = parsedPage.links.size();
             
-            // Normalize the URL (remove fragments, trailing slashes, etc.)
-            std::string normalized = normalizeUrl(resolved);
+            // Hand the text to the indexing threads; this only queues it
+            if (indexable && !parsedPage.text.empty()) {
+                m_indexer->addDocument(result.url, std::move(parsedPage.text));
+            }
             
-            // Check if we should crawl this URL (domain validation, etc.)
-            if (shouldCrawl(normalized)) {
-                FrontierEntry entry;
-                entry.url = normalized;
-                entry.referrerUrl = url;  // Record which page linked to this URL
-                entry.referrerTitle = result.title;  // Record the title of the referring page
-                entriesToAdd.push_back(entry);
+            parsed.links = collectLinks(page.entry, result.title, parsedPage.links);
+            
+            // Let the canonicalizer learn which query parameters do not change the page
+            if (page.http.status >= 200 && page.http.status < 300) {
+                m_canonicalizer.observeContent(page.entry.url, page.http.body.view());
+                if (!parsedPage.canonical.empty()) {
+                    std::string canonical = resolveUrl(page.entry.url, parsedPage.canonical);
+                    if (!canonical.empty()) {
+                        parsed.canonicalUrl = m_canonicalizer.addCanonicalHint(page.entry.url, canonical);
+                    }
+                }
             }
+        } else {
+            result.status = 0;
+            result.error = std::move(page.error);
+            result.linkCount = 0;
+        }
+        
+        page = FetchedPage();  // Free the body before blocking on the next stage
+        m_enqueueQueue->push(std::move(parsed));
+    }
+}
+
+// Link processing: resolves, normalizes and scope-checks the links of a page.
+std::vector<FrontierEntry> WebCrawler::collectLinks(const FrontierEntry& target, const std::string& title,
+                                                    const std::vector<std::string>& links) {
+    std::vector<FrontierEntry> entries;
+    entries.reserve(links.size());
+    for (const auto& link : links) {
+        // Skip bad schemes (javascript:, mailto:, tel:, data:)
+        if (link.find("javascript:") == 0 || 
+            link.find("mailto:") == 0 || 
+            link.find("tel:") == 0 ||
+            link.find("data:") == 0) {
+            continue;
+        }
+        
+        // Resolve relative URLs to absolute URLs
+        std::string resolved = resolveUrl(target.url, link);
+        if (resolved.empty()) continue;
+        
+        // Normalize the URL (remove fragments, trailing slashes, etc.)
+        std::string normalized = normalizeUrl(resolved);
+        
+        // Check if we should crawl this URL (domain validation, etc.)
+        std::string host = extractHost(normalized);
+        if (shouldCrawl(host)) {
+            FrontierEntry entry;
+            entry.url = std::move(normalized);
+            entry.host = std::move(host);
+            entry.referrerUrl = target.url;  // Record which page linked to this URL
+            entry.referrerTitle = title;     // Record the title of the referring page
+            entry.depth = target.depth + 1;
+            entry.shape = TrapDetector::classify(entry.url);
+            entries.push_back(std::move(entry));
+        }
+    }
+    return entries;
+}
+
+// Adds a page's links to the frontier and counts the links it discovered: all
+// new ones, and those sharing the page's own URL template.
+// Called while holding m_frontierMutex.
+size_t WebCrawler::enqueueLinks(std::vector<FrontierEntry>& links, uint64_t sourcePattern,
+                                size_t& newLinks, size_t& selfLinks) {
+    size_t queued = 0;
+    for (auto& entry : links) {
+        // Once every page of the budget is reserved nothing else will be
+        // fetched; leave the rest unvisited instead of silently dropping it
+        if (m_shouldStop || m_budget.exhausted()) {
+            break;
+        }
+        
+        // Entries whose host/depth/prefix budget is spent would only be dropped later
+        if (!m_budget.admits(entry.host, entry.depth, entry.url)) {
+            continue;
+        }
+        
+        // The visited set is only written under the frontier lock, so this
+        // check-and-insert is the single point of deduplication
+        if (!m_visitedUrls.insert(entry.url).second) {
+            continue;
+        }
+        newLinks++;
+        if (entry.shape.pattern == sourcePattern) selfLinks++;
+        
+        // A URL the trap detector turns away stays visited, so it is judged only once
+        if (m_trapDetector.admit(entry.host, entry.url, entry.shape)) {
+            pushFrontier(std::move(entry));
+            queued++;
+        }
+    }
+    return queued;
+}
+
+// Dedup/enqueue stage. A single thread, so the frontier lock is taken once per
+// batch of pages instead of once per page by every fetch thread.
+void WebCrawler::enqueueWorker() {
+    std::vector<ParsedLinks> batch;
+    batch.reserve(kEnqueueBatchPages);
+    ParsedLinks parsed;
+    while (m_enqueueQueue->pop(parsed)) {
+        batch.push_back(std::move(parsed));
+        while (batch.size() < kEnqueueBatchPages && m_enqueueQueue->tryPop(parsed)) {
+            batch.push_back(std::move(parsed));
         }
         
-        // Add new entries to frontier queue (thread-safe)
         {
             std::lock_guard<std::mutex> lock(m_frontierMutex);
-            for (const auto& entry : entriesToAdd) {
-                // Double-check visited status while holding lock to prevent duplicates
-                if (m_visitedUrls.find(entry.url) == m_visitedUrls.end()) {
-                    // Mark as visited immediately to prevent other threads from adding it
-                    m_visitedUrls.insert(entry.url);
-                    
-                    // Only add to frontier if we haven't reached max pages
-                    if (m_pagesCrawled < m_maxPages) {
-                        m_frontier.push(entry);
-                        m_frontierCondition.notify_one();
-                    }
+            size_t queued = 0;
+            for (auto& page : batch) {
+                // The canonical URL has the content we just fetched
+                if (!page.canonicalUrl.empty()) {
+                    m_visitedUrls.insert(page.canonicalUrl);
                 }
+                size_t newLinks = 0;
+                size_t selfLinks = 0;
+                queued += enqueueLinks(page.links, page.shape.pattern, newLinks, selfLinks);
+                m_trapDetector.recordYield(page.host, page.result.url, page.shape, newLinks, selfLinks);
+                markWorkerIdle();
             }
+            // New URLs, or maybe the last page of the crawl
+            notifyFetchers(queued);
+        }
+        
+        for (auto& page : batch) {
+            m_sinkQueue->push(std::move(page.result));
         }
-    } else {
-        result.status = 0;
-        result.error = error;
-        result.linkCount = 0;
+        batch.clear();
     }
-    
-    // Record the crawled page result
-    {
-        std::lock_guard<std::mutex> lock(m_resultsMutex);
-        m_results.push_back(result);
+}
+
+// Result sink stage: streams results to the callback, or keeps them.
+void WebCrawler::sinkWorker() {
+    CrawlResult result;
+    while (m_sinkQueue->pop(result)) {
+        if (m_resultSink) {
+            m_resultSink(result);
+        } else {
+            std::lock_guard<std::mutex> lock(m_resultsMutex);
+            m_results.push_back(std::move(result));
+        }
+        m_pagesCrawled++;
     }
+}
+
+std::string WebCrawler::extractHost(const std::string& url) {
+    std::string urlHost;
+    CURLU* handle = curl_url();
+    if (!handle) return urlHost;
     
-    m_pagesCrawled++;
+    if (curl_url_set(handle, CURLUPART_URL, url.c_str(), 0) == CURLUE_OK) {
+        char* host = nullptr;
+        if (curl_url_get(handle, CURLUPART_HOST, &host, 0) == CURLUE_OK && host) {
+            urlHost = host;
+            curl_free(host);
+        }
+    }
+    curl_url_cleanup(handle);
+    return urlHost;
+}
+
+bool WebCrawler::shouldCrawl(const std::string& host) const {
+    // An empty host means the URL could not be parsed
+    if (host.empty()) return false;
     
-    // Notify waiting threads that new work may be available
-    m_frontierCondition.notify_all();
+    // Check the host against the allow/block lists (or the seed hosts)
+    // Note: We don't check visitedUrls here to avoid deadlock
+    // The caller will do a final check while holding the lock
+    return m_domainFilter.isAllowed(host);
 }
 
+std::string WebCrawler::normalizeUrl(const std::string& url) {
+    // Fragments, default ports, index pages, trailing slashes, tracking and
+    // learned parameters, parameter order and rel=canonical aliases
+    return m_canonicalizer.canonicalize(url);
+}
+
+std::string WebCrawler::resolveUrl(const std::string& baseUrl, const std::string& relativeUrl) {
+    // Let curl resolve the reference against the base as RFC 3986 describes,
+    // which also removes "." and ".." segments; otherwise relative links such
+    // as "../a/" on /a/ pages grow paths without end
+    CURLU* handle = curl_url();
+    if (!handle) return "";
+    
+    std::string result;
+    if (curl_url_set(handle, CURLUPART_URL, baseUrl.c_str(), 0) == CURLUE_OK &&
+        (relativeUrl.empty() || curl_url_set(handle, CURLUPART_URL, relativeUrl.c_str(), 0) == CURLUE_OK)) {
+        char* resolved = nullptr;
+        if (curl_url_get(handle, CURLUPART_URL, &resolved, 0) == CURLUE_OK && resolved) {
+            result = resolved;
+            curl_free(resolved);
+        }
+    }
+    
+    curl_url_cleanup(handle);
+    return result;
+}
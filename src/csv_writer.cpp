@@ -2,6 +2,8 @@
 
 #include <iostream>
 #include <sstream>
+#include <iomanip>
+#include <ctime>
 
 CsvWriter::CsvWriter(const std::string& filename)
     : m_filename(filename) {
@@ -22,7 +24,7 @@ bool CsvWriter::writeHeader() {
         return false;
     }
     
-    m_file << "URL,Title,Status Code,Link Count,Error\n";
+    m_file << "URL,Title,Status Code,Link Count,Error,Last Modified\n";
     return m_file.good();
 }
 
@@ -51,6 +53,19 @@ std::string CsvWriter::escapeCsvField(const std::string& field) {
     return escaped;
 }
 
+// Formats a UTC timestamp as ISO 8601; 0 (unknown) becomes an empty field.
+std::string CsvWriter::formatTimestamp(std::time_t timestamp) {
+    if (timestamp == 0) {
+        return "";
+    }
+    
+    std::tm utc {};
+    gmtime_r(&timestamp, &utc);
+    std::ostringstream oss;
+    oss << std::put_time(&utc, "%Y-%m-%dT%H:%M:%SZ");
+    return oss.str();
+}
+
 bool CsvWriter::writeResult(const CrawlResult& result) {
     if (!m_file.is_open()) {
         return false;
@@ -60,7 +75,8 @@ bool CsvWriter::writeResult(const CrawlResult& result) {
            << escapeCsvField(result.title) << ","
            << result.status << ","
            << result.linkCount << ","
-           << escapeCsvField(result.error) << "\n";
+           << escapeCsvField(result.error) << ","
+           << formatTimestamp(result.lastModified) << "\n";
     
     return m_file.good();
 }
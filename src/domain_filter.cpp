@@ -0,0 +1,217 @@
+#include "domain_filter.hpp"
+
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <unordered_map>
+
+static constexpr uint32_t kNoNode {UINT32_MAX};
+
+static char toLowerAscii(char c) {
+    return (c >= 'A' && c <= 'Z') ? static_cast<char>(c - 'A' + 'a') : c;
+}
+
+// Case-insensitive three-way compare of a stored (lowercase) label against a host label.
+// Bytes compare unsigned, the same order std::string::operator< keeps children in.
+static int compareLabel(std::string_view stored, std::string_view label) {
+    const size_t n {std::min(stored.size(), label.size())};
+    for (size_t i = 0; i < n; ++i) {
+        const auto a {static_cast<unsigned char>(stored[i])};
+        const auto b {static_cast<unsigned char>(toLowerAscii(label[i]))};
+        if (a != b) return a < b ? -1 : 1;
+    }
+    if (stored.size() == label.size()) return 0;
+    return stored.size() < label.size() ? -1 : 1;
+}
+
+static std::string_view trim(std::string_view s) {
+    while (!s.empty() && (s.front() == ' ' || s.front() == '\t' || s.front() == '\r')) s.remove_prefix(1);
+    while (!s.empty() && (s.back() == ' ' || s.back() == '\t' || s.back() == '\r')) s.remove_suffix(1);
+    return s;
+}
+
+// Children created or found during allowAll(), keyed by label plus parent node,
+// so each lookup is a hash probe while the touched nodes are left unsorted.
+struct DomainFilter::BulkInsert {
+    std::unordered_map<std::string, uint32_t> children;
+    std::vector<bool> touched;
+    std::vector<uint32_t> touchedNodes;
+};
+
+static std::string childKey(uint32_t node, std::string_view label) {
+    std::string key(label);
+    key.append(reinterpret_cast<const char*>(&node), sizeof(node));
+    return key;
+}
+
+DomainFilter::DomainFilter() {
+    m_nodes.emplace_back();  // Root
+}
+
+void DomainFilter::allow(std::string_view pattern) {
+    insert(pattern, false);
+}
+
+void DomainFilter::block(std::string_view pattern) {
+    insert(pattern, true);
+}
+
+void DomainFilter::allowAll(const std::vector<std::string_view>& patterns) {
+    BulkInsert bulk;
+    bulk.children.reserve(patterns.size());
+    for (auto pattern : patterns) {
+        insert(pattern, false, &bulk);
+    }
+    for (uint32_t node : bulk.touchedNodes) {
+        auto& children {m_nodes[node].children};
+        std::sort(children.begin(), children.end(),
+            [](const auto& a, const auto& b) { return a.first < b.first; });
+    }
+}
+
+bool DomainFilter::loadAllowList(const std::string& path) {
+    return loadList(path, false);
+}
+
+bool DomainFilter::loadBlockList(const std::string& path) {
+    return loadList(path, true);
+}
+
+bool DomainFilter::loadList(const std::string& path, bool blockRule) {
+    std::ifstream file(path);
+    if (!file.is_open()) {
+        std::cerr << "Error: could not open domain list: " << path << "\n";
+        return false;
+    }
+
+    std::string line;
+    while (std::getline(file, line)) {
+        std::string_view view {line};
+        size_t comment {view.find('#')};
+        if (comment != std::string_view::npos) view = view.substr(0, comment);
+        view = trim(view);
+        if (!view.empty()) insert(view, blockRule);
+    }
+    return true;
+}
+
+void DomainFilter::insert(std::string_view pattern, bool blockRule, BulkInsert* bulk) {
+    pattern = trim(pattern);
+
+    uint8_t flag {kMatchExact};
+    if (pattern.starts_with("*.")) {
+        flag = kMatchSubdomains;
+        pattern.remove_prefix(2);
+    } else if (pattern.starts_with(".")) {
+        flag = kMatchExact | kMatchSubdomains;
+        pattern.remove_prefix(1);
+    }
+    if (!pattern.empty() && pattern.back() == '.') pattern.remove_suffix(1);
+    if (pattern.empty()) return;
+
+    // Walk labels right to left, creating nodes as needed.
+    uint32_t node {0};
+    size_t end {pattern.size()};
+    while (true) {
+        size_t dot {end == 0 ? std::string_view::npos : pattern.rfind('.', end - 1)};
+        size_t begin {dot == std::string_view::npos ? 0 : dot + 1};
+        std::string label(pattern.substr(begin, end - begin));
+        std::transform(label.begin(), label.end(), label.begin(), toLowerAscii);
+
+        auto& children {m_nodes[node].children};
+        if (bulk) {
+            // The first visit registers the node's existing children
+            if (bulk->touched.size() <= node) bulk->touched.resize(m_nodes.size());
+            if (!bulk->touched[node]) {
+                bulk->touched[node] = true;
+                bulk->touchedNodes.push_back(node);
+                for (const auto& child : children) {
+                    bulk->children.emplace(childKey(node, child.first), child.second);
+                }
+            }
+            const uint32_t next {static_cast<uint32_t>(m_nodes.size())};
+            auto [found, added] = bulk->children.emplace(childKey(node, label), next);
+            if (added) {
+                children.emplace_back(std::move(label), next);
+                m_nodes.emplace_back();
+            }
+            node = found->second;
+        } else {
+            auto it {std::lower_bound(children.begin(), children.end(), label,
+                [](const auto& child, const std::string& key) { return child.first < key; })};
+            if (it != children.end() && it->first == label) {
+                node = it->second;
+            } else {
+                const uint32_t next {static_cast<uint32_t>(m_nodes.size())};
+                children.emplace(it, std::move(label), next);
+                m_nodes.emplace_back();
+                node = next;
+            }
+        }
+
+        if (begin == 0) break;
+        end = begin - 1;
+    }
+
+    if (blockRule) {
+        m_nodes[node].blockFlags |= flag;
+    } else {
+        if ((m_nodes[node].allowFlags & flag) != flag) m_allowRules++;
+        m_nodes[node].allowFlags |= flag;
+    }
+}
+
+uint32_t DomainFilter::findChild(uint32_t node, std::string_view label) const {
+    const auto& children {m_nodes[node].children};
+    size_t lo {0};
+    size_t hi {children.size()};
+    while (lo < hi) {
+        const size_t mid {lo + (hi - lo) / 2};
+        const int cmp {compareLabel(children[mid].first, label)};
+        if (cmp == 0) return children[mid].second;
+        if (cmp < 0) lo = mid + 1;
+        else hi = mid;
+    }
+    return kNoNode;
+}
+
+std::pair<bool, bool> DomainFilter::match(std::string_view host) const {
+    if (!host.empty() && host.back() == '.') host.remove_suffix(1);
+
+    bool allowed {false};
+    bool blocked {false};
+    if (host.empty()) return {allowed, blocked};
+
+    uint32_t node {0};
+    size_t end {host.size()};
+    while (true) {
+        size_t dot {end == 0 ? std::string_view::npos : host.rfind('.', end - 1)};
+        size_t begin {dot == std::string_view::npos ? 0 : dot + 1};
+
+        node = findChild(node, host.substr(begin, end - begin));
+        if (node == kNoNode) break;
+
+        const Node& current {m_nodes[node]};
+        if (begin == 0) {
+            // Consumed every label: the host is exactly this domain.
+            allowed |= (current.allowFlags & kMatchExact) != 0;
+            blocked |= (current.blockFlags & kMatchExact) != 0;
+            break;
+        }
+        // More labels remain, so the host is a subdomain of this node.
+        allowed |= (current.allowFlags & kMatchSubdomains) != 0;
+        blocked |= (current.blockFlags & kMatchSubdomains) != 0;
+        end = begin - 1;
+    }
+    return {allowed, blocked};
+}
+
+bool DomainFilter::isAllowed(std::string_view host) const {
+    auto [allowed, blocked] = match(host);
+    if (blocked) return false;
+    return allowed || m_allowRules == 0;
+}
+
+bool DomainFilter::isBlocked(std::string_view host) const {
+    return match(host).second;
+}
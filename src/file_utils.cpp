@@ -13,7 +13,7 @@ bool saveToFile(const HttpResult& output) {
         return false;
     }
 
-    outputFile << output.body;
+    outputFile << output.body.view();
 
     if (outputFile.bad()) {
         std::cerr << "Error: failed to write to a file." << "\n";
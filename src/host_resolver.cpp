@@ -0,0 +1,231 @@
+#include "host_resolver.hpp"
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+#include <cctype>
+#include <curl/curl.h>
+#include <netdb.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+
+// How long answers are used before they are refreshed.
+static constexpr std::chrono::seconds kDnsTtl {300};
+// How long a host that did not resolve is failed without asking again.
+static constexpr std::chrono::seconds kDnsNegativeTtl {60};
+// Addresses pinned per host; curl tries them in order.
+static constexpr size_t kMaxAddresses {8};
+
+static bool isAddressLiteral(const std::string& host) {
+    in_addr address {};
+    return host.starts_with('[') || inet_pton(AF_INET, host.c_str(), &address) == 1;
+}
+
+// Formats an address the way CURLOPT_RESOLVE expects it (IPv6 in brackets).
+static std::string formatAddress(const std::string& address) {
+    return address.find(':') == std::string::npos ? address : "[" + address + "]";
+}
+
+// Blocking system lookup; runs on the resolver threads only.
+static bool systemResolve(const std::string& host, std::vector<std::string>& addresses, std::string& error) {
+    addrinfo hints {};
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_flags = AI_ADDRCONFIG;
+
+    addrinfo* result {nullptr};
+    const int rc {getaddrinfo(host.c_str(), nullptr, &hints, &result)};
+    if (rc != 0) {
+        error = gai_strerror(rc);
+        return false;
+    }
+
+    for (const addrinfo* info = result; info && addresses.size() < kMaxAddresses; info = info->ai_next) {
+        char text[INET6_ADDRSTRLEN] {};
+        const void* address {info->ai_family == AF_INET
+                                 ? static_cast<const void*>(&reinterpret_cast<const sockaddr_in*>(info->ai_addr)->sin_addr)
+                                 : static_cast<const void*>(&reinterpret_cast<const sockaddr_in6*>(info->ai_addr)->sin6_addr)};
+        if ((info->ai_family != AF_INET && info->ai_family != AF_INET6) ||
+            !inet_ntop(info->ai_family, address, text, sizeof(text))) {
+            continue;
+        }
+        std::string formatted {formatAddress(text)};
+        if (std::find(addresses.begin(), addresses.end(), formatted) == addresses.end()) {
+            addresses.push_back(std::move(formatted));
+        }
+    }
+    freeaddrinfo(result);
+
+    if (addresses.empty()) {
+        error = "no IPv4 or IPv6 address";
+        return false;
+    }
+    return true;
+}
+
+HostResolver::HostResolver() = default;
+
+HostResolver::~HostResolver() {
+    stop();
+}
+
+bool HostResolver::loadHostsFile(const std::string& path) {
+    std::ifstream file(path);
+    if (!file.is_open()) {
+        std::cerr << "Error: could not open hosts file: " << path << "\n";
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    std::string line;
+    size_t lineNumber {0};
+    while (std::getline(file, line)) {
+        lineNumber++;
+        std::istringstream fields(line.substr(0, line.find('#')));
+        std::string address;
+        if (!(fields >> address)) continue;
+
+        in_addr v4 {};
+        in6_addr v6 {};
+        if (inet_pton(AF_INET, address.c_str(), &v4) != 1 && inet_pton(AF_INET6, address.c_str(), &v6) != 1) {
+            std::cerr << "Error: " << path << ":" << lineNumber << ": not an IP address: " << address << "\n";
+            return false;
+        }
+        for (std::string name; fields >> name;) {
+            std::transform(name.begin(), name.end(), name.begin(),
+                           [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+            Entry& entry {m_hosts[name]};
+            entry.state = State::Resolved;
+            entry.pinned = true;
+            entry.addresses.push_back(formatAddress(address));
+        }
+    }
+    return true;
+}
+
+void HostResolver::start(size_t threads) {
+    if (!m_threads.empty()) return;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stop = false;
+    }
+    for (size_t i = 0; i < threads; ++i) {
+        m_threads.emplace_back(&HostResolver::resolverThread, this);
+    }
+}
+
+void HostResolver::stop() {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stop = true;
+    }
+    m_queueCondition.notify_all();
+    for (auto& thread : m_threads) {
+        thread.join();
+    }
+    m_threads.clear();
+}
+
+HostResolver::State HostResolver::request(const std::string& host) {
+    if (host.empty()) return State::Unknown;
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto [it, inserted] = m_hosts.try_emplace(host);
+    Entry& entry {it->second};
+    if (inserted) {
+        // IP literals need no lookup and are not pinned
+        if (isAddressLiteral(host)) {
+            entry.state = State::Resolved;
+            entry.pinned = true;
+            return entry.state;
+        }
+        entry.state = State::Pending;
+    } else if (entry.pinned || entry.state == State::Pending || entry.refreshing ||
+               std::chrono::steady_clock::now() < entry.expires) {
+        return entry.state;
+    } else if (entry.state == State::Resolved) {
+        entry.refreshing = true;
+    } else {
+        entry.state = State::Pending;
+    }
+
+    m_queue.push_back(host);
+    m_queueCondition.notify_one();
+    return entry.state;
+}
+
+HostResolver::State HostResolver::lookup(const std::string& host, std::vector<std::string>& addresses,
+                                         std::string& error) const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto it = m_hosts.find(host);
+    if (it == m_hosts.end()) return State::Unknown;
+    addresses = it->second.addresses;
+    error = it->second.error;
+    return it->second.state;
+}
+
+void HostResolver::resolverThread() {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    while (true) {
+        m_queueCondition.wait(lock, [this] { return m_stop || !m_queue.empty(); });
+        if (m_stop) break;
+        std::string host {std::move(m_queue.front())};
+        m_queue.pop_front();
+        lock.unlock();
+
+        std::vector<std::string> addresses;
+        std::string error;
+        const bool resolved {m_resolve ? m_resolve(host, addresses, error) : systemResolve(host, addresses, error)};
+        if (resolved && addresses.size() > kMaxAddresses) {
+            addresses.resize(kMaxAddresses);
+        }
+        m_lookups++;
+        if (!resolved) m_failedLookups++;
+
+        lock.lock();
+        Entry& entry {m_hosts[host]};
+        const auto now = std::chrono::steady_clock::now();
+        entry.refreshing = false;
+        if (resolved && !addresses.empty()) {
+            entry.state = State::Resolved;
+            entry.addresses = std::move(addresses);
+            entry.error.clear();
+            entry.expires = now + kDnsTtl;
+        } else if (entry.state == State::Resolved) {
+            // A failed refresh keeps the last good answer until the next attempt
+            entry.expires = now + kDnsNegativeTtl;
+        } else {
+            entry.state = State::Failed;
+            entry.addresses.clear();
+            entry.error = error.empty() ? "no address" : std::move(error);
+            entry.expires = now + kDnsNegativeTtl;
+        }
+        lock.unlock();
+
+        if (m_onResolved) m_onResolved();
+        lock.lock();
+    }
+}
+
+std::string resolveEntry(const std::string& url, const std::string& host, const std::vector<std::string>& addresses) {
+    if (addresses.empty()) return {};
+
+    CURLU* handle {curl_url()};
+    if (!handle) return {};
+
+    std::string entry;
+    char* port {nullptr};
+    if (curl_url_set(handle, CURLUPART_URL, url.c_str(), 0) == CURLUE_OK &&
+        curl_url_get(handle, CURLUPART_PORT, &port, CURLU_DEFAULT_PORT) == CURLUE_OK && port) {
+        entry = host + ":" + port + ":";
+        for (size_t i = 0; i < addresses.size(); ++i) {
+            if (i > 0) entry += ',';
+            entry += addresses[i];
+        }
+    }
+    curl_free(port);
+    curl_url_cleanup(handle);
+
+    return entry;
+}
@@ -2,13 +2,24 @@
 
 #include <string_view>
 #include <iostream>
-#include <optional>
 #include <memory>
+#include <algorithm>
+#include <cctype>
+#include <charconv>
 
-// Write callback to collect the response chunks into a string.
+// Bodies are pre-sized from Content-Length up to this much; beyond it the
+// buffer grows as data arrives, so a bogus header cannot force a huge allocation.
+static constexpr size_t kMaxPresize {8 * 1024 * 1024};
+
+// Write callback to collect the response chunks into the pooled body buffer.
 static size_t writeCallback(char* contents, size_t size, size_t nmemb, void* userdata) {
     const size_t totalSize {size * nmemb};
     auto* out {static_cast<HttpResult*>(userdata)};
+    if (out->body.empty()) {
+        if (const size_t presize {bodyPresize(out->headers.contentLength())}; presize > 0) {
+            out->body.reserve(presize);
+        }
+    }
     out->body.append(contents, totalSize);
 
     return totalSize;
@@ -19,31 +30,121 @@ static bool isStatusLine(std::string_view line) {
     return line.rfind("HTTP/", 0) == 0;
 }
 
-// Write callback to collect the last response header into a vector.
+// Write callback to collect the last response's header lines.
 static size_t headerCallback(char* contents, size_t size, size_t nmemb, void* userdata) {
     const size_t totalSize {size * nmemb};
     auto* out {static_cast<HttpResult*>(userdata)};
-    std::string line(contents, totalSize);
-    if (isStatusLine(line)) out->headers.clear();
-    out->headers.emplace_back(std::move(line));
+    out->headers.append(std::string_view(contents, totalSize));
 
     return totalSize;
 }
 
-// Builds the URL to get robots.txt by parsing the original URL.
-static std::optional<std::string> buildRobotsUrl(const std::string&url) {
+static bool equalsIgnoreCase(std::string_view a, std::string_view b) {
+    if (a.size() != b.size()) return false;
+    for (size_t i = 0; i < a.size(); ++i) {
+        if (std::tolower(static_cast<unsigned char>(a[i])) != std::tolower(static_cast<unsigned char>(b[i]))) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static std::string_view trimHeaderValue(std::string_view value) {
+    while (!value.empty() && (value.front() == ' ' || value.front() == '\t')) value.remove_prefix(1);
+    while (!value.empty() && (value.back() == ' ' || value.back() == '\t' ||
+                              value.back() == '\r' || value.back() == '\n')) {
+        value.remove_suffix(1);
+    }
+    return value;
+}
+
+void HttpHeaders::append(std::string_view line) {
+    if (isStatusLine(line)) {
+        clear();
+    } else if (m_raw.capacity() == 0) {
+        m_raw.reset();
+    }
+    m_raw.append(line.data(), line.size());
+}
+
+void HttpHeaders::clear() {
+    m_raw.reset();
+}
+
+template <typename F>
+void HttpHeaders::forEachLine(F&& onLine) const {
+    const std::string_view raw {m_raw.view()};
+    size_t start {0};
+    while (start < raw.size()) {
+        size_t end {raw.find('\n', start)};
+        if (end == std::string_view::npos) end = raw.size();
+        std::string_view line {trimHeaderValue(raw.substr(start, end - start))};
+        // Skip the status line and the blank line that ends the headers
+        if (!line.empty() && !isStatusLine(line) && !onLine(line)) return;
+        start = end + 1;
+    }
+}
+
+size_t HttpHeaders::size() const {
+    size_t count {0};
+    forEachLine([&](std::string_view) {
+        count++;
+        return true;
+    });
+    return count;
+}
+
+std::string_view HttpHeaders::line(size_t index) const {
+    std::string_view found;
+    forEachLine([&](std::string_view line) {
+        if (index-- > 0) return true;
+        found = line;
+        return false;
+    });
+    return found;
+}
+
+std::string_view HttpHeaders::get(std::string_view name) const {
+    std::string_view value;
+    forEachLine([&](std::string_view header) {
+        const size_t colon {header.find(':')};
+        if (colon != std::string_view::npos && equalsIgnoreCase(header.substr(0, colon), name)) {
+            value = trimHeaderValue(header.substr(colon + 1));
+            return false;
+        }
+        return true;
+    });
+    return value;
+}
+
+std::optional<uint64_t> HttpHeaders::contentLength() const {
+    const std::string_view value {get("Content-Length")};
+    if (value.empty()) return std::nullopt;
+    // Signs, junk and values that overflow are all "unknown"
+    uint64_t length {0};
+    const auto [end, error] = std::from_chars(value.data(), value.data() + value.size(), length);
+    if (error != std::errc() || end != value.data() + value.size()) return std::nullopt;
+    return length;
+}
+
+size_t bodyPresize(std::optional<uint64_t> contentLength) {
+    return contentLength ? static_cast<size_t>(std::min<uint64_t>(*contentLength, kMaxPresize)) : 0;
+}
+
+// Builds scheme + host + path (e.g. "/robots.txt") by parsing the original URL.
+std::optional<std::string> buildHostUrl(const std::string& url, const char* path) {
     CURLU* handle {curl_url()};
 
     if (!handle) return std::nullopt;
 
     std::optional<std::string> out;
 
-    // Strips the URL of it's path, query, and fragment, so it's just scheme + host + '/robots.txt'.
+    // Strips the URL of it's path, query, and fragment, so it's just scheme + host + path.
     if (curl_url_set(handle, CURLUPART_URL, url.c_str(), 0L) == CURLUE_OK) {
         curl_url_set(handle, CURLUPART_PATH, "", 0L);
         curl_url_set(handle, CURLUPART_QUERY, NULL, 0L);
         curl_url_set(handle, CURLUPART_FRAGMENT, NULL, 0L);
-        curl_url_set(handle, CURLUPART_PATH, "/robots.txt", 0L);      
+        curl_url_set(handle, CURLUPART_PATH, path, 0L);
         
         // Build the URL.
         char* fullUrl {nullptr};
@@ -61,7 +162,7 @@ static std::optional<std::string> buildRobotsUrl(const std::string&url) {
 
 // Uses getHttp to get the robots.txt if there is one.
 bool getRobots(const std::string& url, HttpResult& output, std::string& error) {
-    auto robotsUrl {buildRobotsUrl(url)};
+    auto robotsUrl {buildHostUrl(url, "/robots.txt")};
     if (!robotsUrl) {
         error = "Failed to construct URL for robots.txt.";
         return false;
@@ -77,16 +178,49 @@ bool getRobots(const std::string& url, HttpResult& output, std::string& error) {
     return true;
 }
 
+// Each thread keeps one easy handle for all its requests. Reusing it keeps its
+// connection and DNS caches warm and avoids rebuilding libcurl's transfer state.
+static CURL* threadHandle() {
+    thread_local std::unique_ptr<CURL, CurlHandleDeleter> handle(curl_easy_init());
+    if (handle) curl_easy_reset(handle.get());
+    return handle.get();
+}
+
+// Applies the options shared by every request.
+static void configureHandle(CURL* curl, const std::string& url, char* errbuf, const FetchOptions& options) {
+    const char* userAgent {"CrawlerWIP (+https://example.local)"};
+
+    curl_easy_setopt(curl, CURLOPT_ERRORBUFFER, errbuf);
+    curl_easy_setopt(curl, CURLOPT_NOSIGNAL, 1L);
+    curl_easy_setopt(curl, CURLOPT_ACCEPT_ENCODING, "");
+    curl_easy_setopt(curl, CURLOPT_URL, url.c_str());
+    curl_easy_setopt(curl, CURLOPT_FOLLOWLOCATION, 1L);
+    curl_easy_setopt(curl, CURLOPT_MAXREDIRS, 5L);
+    curl_easy_setopt(curl, CURLOPT_USERAGENT, userAgent);
+    curl_easy_setopt(curl, CURLOPT_TIMEOUT_MS, static_cast<long>(options.timeout.count()));
+    curl_easy_setopt(curl, CURLOPT_CONNECTTIMEOUT_MS, static_cast<long>(options.connectTimeout.count()));
+    curl_easy_setopt(curl, CURLOPT_SSL_VERIFYPEER, 1L);
+    curl_easy_setopt(curl, CURLOPT_SSL_VERIFYHOST, 2L);
+}
+
+// Formats a failed transfer's error message.
+static std::string describeError(CURLcode rc, const char* errbuf) {
+    if (errbuf[0] != '\0') {
+        return std::string(curl_easy_strerror(rc)) + ": " + errbuf;
+    }
+    return curl_easy_strerror(rc);
+}
+
 // Performs an HTTP GET request.
-bool getHttp(const std::string& url, HttpResult& output, std::string& error) {
+bool getHttp(const std::string& url, HttpResult& output, std::string& error, const FetchOptions& options) {
     output.status = 0;
+    output.curlCode = CURLE_OK;
     output.url.clear();
-    output.body.clear();
+    output.body.reset();
     output.headers.clear();
     error.clear();
 
-    // Ensures that curl_easy_cleanup() runs automatically on scope exit.
-    std::unique_ptr<CURL, CurlHandleDeleter> curl(curl_easy_init());
+    CURL* curl {threadHandle()};
 
     if (!curl) {
         std::cerr << "Easy initializing failed." << "\n";
@@ -95,43 +229,105 @@ bool getHttp(const std::string& url, HttpResult& output, std::string& error) {
 
     char errbuf[CURL_ERROR_SIZE] = {};
 
-    const char* userAgent {"CrawlerWIP (+https://example.local)"};
+    configureHandle(curl, url, errbuf, options);
+    std::unique_ptr<curl_slist, SlistDeleter> resolve;
+    for (const auto& entry : options.resolve) {
+        curl_slist* appended {curl_slist_append(resolve.get(), entry.c_str())};
+        if (!appended) break;
+        resolve.release();
+        resolve.reset(appended);
+    }
+    if (resolve) curl_easy_setopt(curl, CURLOPT_RESOLVE, resolve.get());
+    curl_easy_setopt(curl, CURLOPT_HEADERFUNCTION, headerCallback);
+    curl_easy_setopt(curl, CURLOPT_HEADERDATA, &output);
+    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, writeCallback);
+    curl_easy_setopt(curl, CURLOPT_WRITEDATA, &output);
 
-    curl_easy_setopt(curl.get(), CURLOPT_ERRORBUFFER, errbuf);
-    curl_easy_setopt(curl.get(), CURLOPT_NOSIGNAL, 1L);
-    curl_easy_setopt(curl.get(), CURLOPT_ACCEPT_ENCODING, "");
-    curl_easy_setopt(curl.get(), CURLOPT_URL, url.c_str());
-    curl_easy_setopt(curl.get(), CURLOPT_FOLLOWLOCATION, 1L);
-    curl_easy_setopt(curl.get(), CURLOPT_MAXREDIRS, 5L);
-    curl_easy_setopt(curl.get(), CURLOPT_USERAGENT, userAgent);
-    curl_easy_setopt(curl.get(), CURLOPT_HEADERFUNCTION, headerCallback);
-    curl_easy_setopt(curl.get(), CURLOPT_HEADERDATA, &output);
-    curl_easy_setopt(curl.get(), CURLOPT_WRITEFUNCTION, writeCallback);
-    curl_easy_setopt(curl.get(), CURLOPT_WRITEDATA, &output);
-    curl_easy_setopt(curl.get(), CURLOPT_TIMEOUT, 20L);        
-    curl_easy_setopt(curl.get(), CURLOPT_CONNECTTIMEOUT, 10L);
-    curl_easy_setopt(curl.get(), CURLOPT_SSL_VERIFYPEER, 1L);
-    curl_easy_setopt(curl.get(), CURLOPT_SSL_VERIFYHOST, 2L);
-
-    CURLcode rc {curl_easy_perform(curl.get())};
+    CURLcode rc {curl_easy_perform(curl)};
+    // The handle outlives this call; do not leave it pointing at the stack
+    curl_easy_setopt(curl, CURLOPT_ERRORBUFFER, nullptr);
+    curl_easy_setopt(curl, CURLOPT_RESOLVE, nullptr);
     if (rc != CURLE_OK) {
-        if (errbuf[0] != '\0') {
-            error = std::string(curl_easy_strerror(rc)) + ": " + errbuf;
-        } else {
-            error = curl_easy_strerror(rc);
-        }
-
+        output.curlCode = rc;
+        error = describeError(rc, errbuf);
         return false;
     }
 
     long status {0};
-    curl_easy_getinfo(curl.get(), CURLINFO_RESPONSE_CODE, &status);
+    curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &status);
 
     char* eff {nullptr};
-    curl_easy_getinfo(curl.get(), CURLINFO_EFFECTIVE_URL, &eff);
+    curl_easy_getinfo(curl, CURLINFO_EFFECTIVE_URL, &eff);
 
     output.status = status;
     output.url = eff ? std::string(eff) : url;
 
     return true;
 }
+
+// State for streamHttp's write callback.
+struct StreamState {
+    CURL* curl;
+    const BodySink* sink;
+    bool rejected = false;
+};
+
+// Write callback that forwards successful response bodies to the sink.
+static size_t streamCallback(char* contents, size_t size, size_t nmemb, void* userdata) {
+    const size_t totalSize {size * nmemb};
+    auto* state {static_cast<StreamState*>(userdata)};
+
+    // Do not feed error pages to the sink.
+    long status {0};
+    curl_easy_getinfo(state->curl, CURLINFO_RESPONSE_CODE, &status);
+    if (status < 200 || status >= 300) {
+        state->rejected = true;
+        return 0;  // Anything other than totalSize aborts the transfer.
+    }
+
+    if (!(*state->sink)(contents, totalSize)) {
+        state->rejected = true;
+        return 0;
+    }
+
+    return totalSize;
+}
+
+// Performs an HTTP GET request and streams a 2XX body to sink without buffering it.
+bool streamHttp(const std::string& url, const BodySink& sink, long& status, std::string& error) {
+    status = 0;
+    error.clear();
+
+    CURL* curl {threadHandle()};
+
+    if (!curl) {
+        std::cerr << "Easy initializing failed." << "\n";
+        return false;
+    }
+
+    char errbuf[CURL_ERROR_SIZE] = {};
+    StreamState state {curl, &sink};
+
+    configureHandle(curl, url, errbuf, FetchOptions {});
+    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, streamCallback);
+    curl_easy_setopt(curl, CURLOPT_WRITEDATA, &state);
+
+    CURLcode rc {curl_easy_perform(curl)};
+    curl_easy_setopt(curl, CURLOPT_ERRORBUFFER, nullptr);
+    curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &status);
+
+    if (state.rejected) {
+        error = "Response rejected (HTTP " + std::to_string(status) + ").";
+        return false;
+    }
+    if (rc != CURLE_OK) {
+        error = describeError(rc, errbuf);
+        return false;
+    }
+    if (status < 200 || status >= 300) {
+        error = "HTTP " + std::to_string(status) + ".";
+        return false;
+    }
+
+    return true;
+}
@@ -0,0 +1,192 @@
+#include "inverted_index.hpp"
+#include "varint.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <sstream>
+
+bool IndexReader::open(const std::string& directory) {
+    m_terms.clear();
+    m_urls.clear();
+
+    MappedFile termsFile;
+    if (!termsFile.open(directory + "/terms.bin")) return false;
+
+    std::string_view terms {termsFile.data()};
+    const size_t magicLength {sizeof(kIndexMagic) - 1};
+    if (terms.size() < magicLength || terms.substr(0, magicLength) != kIndexMagic) {
+        std::cerr << "Error: not an index directory: " << directory << "\n";
+        return false;
+    }
+
+    const char* p {terms.data() + magicLength};
+    const char* end {terms.data() + terms.size()};
+    while (p < end) {
+        uint64_t length {0};
+        uint64_t frequency {0};
+        uint64_t offset {0};
+        if (!getVarint(p, end, length) || static_cast<uint64_t>(end - p) < length) {
+            std::cerr << "Error: corrupt term dictionary in " << directory << "\n";
+            return false;
+        }
+        std::string term(p, length);
+        p += length;
+        if (!getVarint(p, end, frequency) || !getVarint(p, end, offset)) {
+            std::cerr << "Error: corrupt term dictionary in " << directory << "\n";
+            return false;
+        }
+        m_terms.push_back(TermInfo {std::move(term), static_cast<uint32_t>(frequency), offset});
+    }
+
+    if (!m_postings.open(directory + "/postings.bin")) return false;
+
+    std::ifstream docs(directory + "/docs.tsv");
+    std::string line;
+    while (std::getline(docs, line)) {
+        size_t tab {line.find('\t')};
+        if (tab == std::string::npos) continue;
+        const uint32_t docId {static_cast<uint32_t>(std::stoul(line.substr(0, tab)))};
+        if (docId >= m_urls.size()) m_urls.resize(docId + 1);
+        m_urls[docId] = line.substr(tab + 1);
+    }
+
+    return true;
+}
+
+const std::string& IndexReader::url(uint32_t docId) const {
+    static const std::string unknown;
+    return docId < m_urls.size() ? m_urls[docId] : unknown;
+}
+
+const IndexReader::TermInfo* IndexReader::findTerm(std::string_view term) const {
+    auto it {std::lower_bound(m_terms.begin(), m_terms.end(), term,
+        [](const TermInfo& info, std::string_view key) { return info.term < key; })};
+    if (it == m_terms.end() || it->term != term) return nullptr;
+    return &*it;
+}
+
+// Decodes one block's payload into docIds and frequencies.
+static bool decodeBlock(const char* p, const char* end, uint64_t count, uint32_t previous,
+                        std::vector<Posting>& out) {
+    out.resize(count);
+    uint64_t docId {previous};
+    for (auto& posting : out) {
+        uint64_t delta {0};
+        if (!getVarint(p, end, delta)) return false;
+        docId += delta;
+        posting.docId = static_cast<uint32_t>(docId);
+    }
+    for (auto& posting : out) {
+        uint64_t frequency {0};
+        if (!getVarint(p, end, frequency)) return false;
+        posting.termFrequency = static_cast<uint32_t>(frequency);
+    }
+    return true;
+}
+
+std::vector<Posting> IndexReader::postings(std::string_view term) const {
+    std::vector<Posting> result;
+    const TermInfo* info {findTerm(term)};
+    if (!info) return result;
+
+    std::string_view data {m_postings.data()};
+    if (info->offset >= data.size()) return result;
+    const char* p {data.data() + info->offset};
+    const char* end {data.data() + data.size()};
+
+    std::vector<Posting> block;
+    uint32_t previous {0};
+    while (result.size() < info->documentFrequency) {
+        uint64_t count {0};
+        uint64_t last {0};
+        uint64_t bytes {0};
+        if (!getVarint(p, end, count) || !getVarint(p, end, last) || !getVarint(p, end, bytes) ||
+            static_cast<uint64_t>(end - p) < bytes) {
+            break;
+        }
+        if (!decodeBlock(p, p + bytes, count, previous, block)) break;
+        result.insert(result.end(), block.begin(), block.end());
+        p += bytes;
+        previous = static_cast<uint32_t>(last);
+    }
+    return result;
+}
+
+std::vector<IndexReader::Hit> IndexReader::search(const std::string& query, size_t limit) const {
+    std::vector<Hit> hits;
+
+    std::vector<std::string> queryTerms;
+    tokenize(query, [&](std::string_view term) { queryTerms.emplace_back(term); });
+    std::sort(queryTerms.begin(), queryTerms.end());
+    queryTerms.erase(std::unique(queryTerms.begin(), queryTerms.end()), queryTerms.end());
+    if (queryTerms.empty()) return hits;
+
+    std::vector<const TermInfo*> infos;
+    for (const auto& term : queryTerms) {
+        const TermInfo* info {findTerm(term)};
+        if (!info) return hits;  // Conjunctive query: a missing term matches nothing
+        infos.push_back(info);
+    }
+
+    // Rarest term first keeps the candidate list as short as possible.
+    std::sort(infos.begin(), infos.end(), [](const TermInfo* a, const TermInfo* b) {
+        return a->documentFrequency < b->documentFrequency;
+    });
+
+    const double totalDocs {static_cast<double>(std::max<size_t>(1, m_urls.size()))};
+    auto idf = [&](const TermInfo* info) {
+        return std::log(1.0 + totalDocs / static_cast<double>(std::max<uint32_t>(1, info->documentFrequency)));
+    };
+
+    for (const auto& posting : postings(infos[0]->term)) {
+        hits.push_back(Hit {posting.docId, posting.termFrequency * idf(infos[0])});
+    }
+
+    std::string_view data {m_postings.data()};
+    const char* end {data.data() + data.size()};
+    std::vector<Posting> block;
+    std::vector<Hit> kept;
+    for (size_t t = 1; t < infos.size() && !hits.empty(); ++t) {
+        const TermInfo* info {infos[t]};
+        const double weight {idf(info)};
+        const char* p {data.data() + std::min<uint64_t>(info->offset, data.size())};
+        uint64_t remaining {info->documentFrequency};
+        uint32_t previous {0};
+        size_t candidate {0};
+        kept.clear();
+
+        while (remaining > 0 && candidate < hits.size()) {
+            uint64_t count {0};
+            uint64_t last {0};
+            uint64_t bytes {0};
+            if (!getVarint(p, end, count) || !getVarint(p, end, last) || !getVarint(p, end, bytes) ||
+                static_cast<uint64_t>(end - p) < bytes) {
+                break;
+            }
+
+            // Skip blocks that end before the next candidate without decoding them.
+            if (last >= hits[candidate].docId && decodeBlock(p, p + bytes, count, previous, block)) {
+                for (const auto& posting : block) {
+                    while (candidate < hits.size() && hits[candidate].docId < posting.docId) ++candidate;
+                    if (candidate == hits.size()) break;
+                    if (hits[candidate].docId == posting.docId) {
+                        kept.push_back(Hit {posting.docId, hits[candidate].score + posting.termFrequency * weight});
+                        ++candidate;
+                    }
+                }
+            }
+
+            p += bytes;
+            previous = static_cast<uint32_t>(last);
+            remaining -= std::min(remaining, count);
+        }
+        hits.swap(kept);
+    }
+
+    const size_t top {std::min(limit, hits.size())};
+    std::partial_sort(hits.begin(), hits.begin() + static_cast<long>(top), hits.end(),
+        [](const Hit& a, const Hit& b) { return a.score > b.score; });
+    hits.resize(top);
+    return hits;
+}
@@ -0,0 +1,422 @@
+#include "inverted_index.hpp"
+#include "varint.hpp"
+
+#include <algorithm>
+#include <filesystem>
+#include <iostream>
+#include <queue>
+
+// Longer "words" are almost always base64 blobs or minified junk.
+static constexpr size_t kMaxTermLength {64};
+// Rough per-term overhead of the hash map node and vector in a postings buffer.
+static constexpr size_t kTermOverheadBytes {64};
+static constexpr size_t kReadBufferBytes {1u << 16};
+
+static bool isWordByte(unsigned char c) {
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c >= 0x80;
+}
+
+void tokenize(std::string_view text, const std::function<void(std::string_view term)>& onTerm) {
+    std::string lowered;
+    size_t i {0};
+    while (i < text.size()) {
+        while (i < text.size() && !isWordByte(static_cast<unsigned char>(text[i]))) ++i;
+        const size_t begin {i};
+        bool hasUpper {false};
+        while (i < text.size() && isWordByte(static_cast<unsigned char>(text[i]))) {
+            hasUpper |= text[i] >= 'A' && text[i] <= 'Z';
+            ++i;
+        }
+
+        const size_t length {i - begin};
+        if (length == 0 || length > kMaxTermLength) continue;
+
+        std::string_view term {text.substr(begin, length)};
+        if (hasUpper) {
+            lowered.assign(term);
+            for (char& c : lowered) {
+                if (c >= 'A' && c <= 'Z') c = static_cast<char>(c - 'A' + 'a');
+            }
+            term = lowered;
+        }
+        onTerm(term);
+    }
+}
+
+// Sequential reader over a run file written by IndexBuilder::writeRun().
+struct RunCursor {
+    std::ifstream in;
+    std::vector<char> buffer;
+    std::string term;
+    std::vector<Posting> postings;
+
+    bool open(const std::string& path) {
+        buffer.resize(kReadBufferBytes);
+        in.rdbuf()->pubsetbuf(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+        in.open(path, std::ios::binary);
+        return in.is_open();
+    }
+
+    // Loads the next term and its postings. Returns false at the end of the run.
+    bool next() {
+        uint64_t length {0};
+        if (!readVarint(in, length)) return false;
+        term.resize(length);
+        in.read(term.data(), static_cast<std::streamsize>(length));
+
+        uint64_t count {0};
+        if (!in || !readVarint(in, count)) return false;
+        postings.resize(count);
+        uint64_t docId {0};
+        for (auto& posting : postings) {
+            uint64_t delta {0};
+            uint64_t frequency {0};
+            if (!readVarint(in, delta) || !readVarint(in, frequency)) return false;
+            docId += delta;
+            posting.docId = static_cast<uint32_t>(docId);
+            posting.termFrequency = static_cast<uint32_t>(frequency);
+        }
+        return true;
+    }
+};
+
+// Appends one term's postings in run format.
+static void encodeRunRecord(std::string& out, std::string_view term, const std::vector<Posting>& postings) {
+    putVarint(out, term.size());
+    out.append(term);
+    putVarint(out, postings.size());
+    uint32_t previous {0};
+    for (const auto& posting : postings) {
+        putVarint(out, posting.docId - previous);
+        putVarint(out, posting.termFrequency);
+        previous = posting.docId;
+    }
+}
+
+// Appends one term's postings in the block-compressed final format.
+static void encodeFinalPostings(std::string& out, const std::vector<Posting>& postings) {
+    std::string payload;
+    uint32_t previous {0};
+    for (size_t begin = 0; begin < postings.size(); begin += kPostingsBlockSize) {
+        const size_t end {std::min(postings.size(), begin + kPostingsBlockSize)};
+        payload.clear();
+        for (size_t i = begin; i < end; ++i) {
+            putVarint(payload, postings[i].docId - previous);
+            previous = postings[i].docId;
+        }
+        for (size_t i = begin; i < end; ++i) {
+            putVarint(payload, postings[i].termFrequency);
+        }
+        putVarint(out, end - begin);
+        putVarint(out, previous);
+        putVarint(out, payload.size());
+        out += payload;
+    }
+}
+
+IndexBuilder::IndexBuilder(IndexOptions options)
+    : m_options(std::move(options)) {
+    m_options.numThreads = std::max<size_t>(1, m_options.numThreads);
+    m_options.queueCapacity = std::max<size_t>(1, m_options.queueCapacity);
+    m_options.mergeFanIn = std::max<size_t>(2, m_options.mergeFanIn);
+}
+
+IndexBuilder::~IndexBuilder() {
+    if (m_started) finish();
+}
+
+bool IndexBuilder::start() {
+    std::error_code ec;
+    std::filesystem::create_directories(m_options.directory, ec);
+    if (ec) {
+        std::cerr << "Error: could not create index directory: " << m_options.directory << "\n";
+        return false;
+    }
+
+    m_docs.open(m_options.directory + "/docs.tsv", std::ios::out | std::ios::trunc);
+    if (!m_docs.is_open()) {
+        std::cerr << "Error: could not open document table in " << m_options.directory << "\n";
+        return false;
+    }
+
+    m_started = true;
+    for (size_t i = 0; i < m_options.numThreads; ++i) {
+        m_indexers.emplace_back(&IndexBuilder::indexerThread, this);
+    }
+    m_merger = std::thread(&IndexBuilder::mergerThread, this);
+    return true;
+}
+
+void IndexBuilder::addDocument(const std::string& url, std::string text) {
+    std::unique_lock<std::mutex> lock(m_queueMutex);
+    m_queueNotFull.wait(lock, [this] {
+        return m_queue.size() < m_options.queueCapacity || m_finishing;
+    });
+    if (m_finishing) return;
+
+    // Ids are handed out in queue order, so each indexing thread sees them ascending
+    // and its postings lists stay sorted without extra work.
+    m_queue.push_back(Document {m_nextDocId++, url, std::move(text)});
+    m_queueNotEmpty.notify_one();
+}
+
+void IndexBuilder::flush() {
+    std::lock_guard<std::mutex> lock(m_queueMutex);
+    m_flushGeneration++;
+    m_queueNotEmpty.notify_all();
+}
+
+void IndexBuilder::indexerThread() {
+    PostingsBuffer buffer;
+    size_t bufferBytes {0};
+    uint64_t seenFlush {0};
+    std::unordered_map<std::string_view, uint32_t> counts;
+    std::string docLine;
+
+    while (true) {
+        Document doc;
+        bool spill {false};
+        {
+            std::unique_lock<std::mutex> lock(m_queueMutex);
+            m_queueNotEmpty.wait(lock, [&] {
+                return !m_queue.empty() || m_finishing || m_flushGeneration != seenFlush;
+            });
+
+            if (m_flushGeneration != seenFlush) {
+                seenFlush = m_flushGeneration;
+                spill = true;
+            } else if (!m_queue.empty()) {
+                doc = std::move(m_queue.front());
+                m_queue.pop_front();
+                m_queueNotFull.notify_one();
+            } else {
+                break;  // Finishing and drained
+            }
+        }
+
+        if (spill) {
+            if (!buffer.empty() && !writeRun(buffer)) m_failed = true;
+            bufferBytes = 0;
+            continue;
+        }
+
+        // Lowercase in place so every term is a view into the document text.
+        for (char& c : doc.text) {
+            if (c >= 'A' && c <= 'Z') c = static_cast<char>(c - 'A' + 'a');
+        }
+        counts.clear();
+        tokenize(doc.text, [&](std::string_view term) { counts[term]++; });
+
+        for (const auto& [term, frequency] : counts) {
+            auto it {buffer.find(term)};
+            if (it == buffer.end()) {
+                it = buffer.emplace(std::string(term), std::vector<Posting>()).first;
+                bufferBytes += term.size() + kTermOverheadBytes;
+            }
+            it->second.push_back(Posting {doc.id, frequency});
+            bufferBytes += sizeof(Posting);
+        }
+
+        docLine = std::to_string(doc.id);
+        docLine += '\t';
+        docLine += doc.url;
+        docLine += '\n';
+        {
+            std::lock_guard<std::mutex> lock(m_docsMutex);
+            m_docs << docLine;
+        }
+
+        if (bufferBytes >= m_options.runBytes) {
+            if (!writeRun(buffer)) m_failed = true;
+            bufferBytes = 0;
+        }
+    }
+
+    if (!buffer.empty() && !writeRun(buffer)) m_failed = true;
+}
+
+std::string IndexBuilder::nextRunPath() {
+    return m_options.directory + "/run-" + std::to_string(m_nextRunId++) + ".tmp";
+}
+
+bool IndexBuilder::writeRun(PostingsBuffer& buffer) {
+    std::vector<PostingsBuffer::value_type*> sorted;
+    sorted.reserve(buffer.size());
+    for (auto& item : buffer) sorted.push_back(&item);
+    std::sort(sorted.begin(), sorted.end(), [](const auto* a, const auto* b) {
+        return a->first < b->first;
+    });
+
+    const std::string path {nextRunPath()};
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    if (!out.is_open()) {
+        std::cerr << "Error: could not write index run: " << path << "\n";
+        buffer.clear();
+        return false;
+    }
+
+    std::string record;
+    uint64_t bytes {0};
+    for (const auto* item : sorted) {
+        record.clear();
+        encodeRunRecord(record, item->first, item->second);
+        out.write(record.data(), static_cast<std::streamsize>(record.size()));
+        bytes += record.size();
+    }
+    buffer.clear();
+    out.close();
+    if (!out) return false;
+
+    addRun(RunFile {path, bytes});
+    return true;
+}
+
+void IndexBuilder::addRun(RunFile run) {
+    std::lock_guard<std::mutex> lock(m_runsMutex);
+    m_runs.push_back(std::move(run));
+    m_runsChanged.notify_one();
+}
+
+void IndexBuilder::mergerThread() {
+    std::unique_lock<std::mutex> lock(m_runsMutex);
+    while (true) {
+        m_runsChanged.wait(lock, [this] {
+            return m_runs.size() >= m_options.mergeFanIn || m_indexersDone;
+        });
+        if (m_runs.size() < m_options.mergeFanIn) break;
+
+        // Merge the smallest runs first so each posting is rewritten O(log runs) times.
+        std::sort(m_runs.begin(), m_runs.end(), [](const RunFile& a, const RunFile& b) {
+            return a.bytes < b.bytes;
+        });
+        std::vector<RunFile> batch(m_runs.begin(), m_runs.begin() + static_cast<long>(m_options.mergeFanIn));
+        m_runs.erase(m_runs.begin(), m_runs.begin() + static_cast<long>(m_options.mergeFanIn));
+
+        lock.unlock();
+        const std::string path {nextRunPath()};
+        const bool ok {mergeRuns(batch, path, false)};
+        std::error_code ec;
+        for (const auto& run : batch) std::filesystem::remove(run.path, ec);
+        const uint64_t bytes {ok ? static_cast<uint64_t>(std::filesystem::file_size(path, ec)) : 0};
+        lock.lock();
+
+        if (ok) {
+            m_runs.push_back(RunFile {path, bytes});
+        } else {
+            m_failed = true;
+        }
+    }
+}
+
+bool IndexBuilder::mergeRuns(const std::vector<RunFile>& runs, const std::string& outPath, bool final) {
+    std::vector<RunCursor> cursors(runs.size());
+    for (size_t i = 0; i < runs.size(); ++i) {
+        if (!cursors[i].open(runs[i].path)) {
+            std::cerr << "Error: could not read index run: " << runs[i].path << "\n";
+            return false;
+        }
+    }
+
+    std::ofstream runOut;
+    std::ofstream termsOut;
+    std::ofstream postingsOut;
+    if (final) {
+        termsOut.open(outPath + "/terms.bin", std::ios::binary | std::ios::trunc);
+        postingsOut.open(outPath + "/postings.bin", std::ios::binary | std::ios::trunc);
+        if (!termsOut.is_open() || !postingsOut.is_open()) {
+            std::cerr << "Error: could not write index files in " << outPath << "\n";
+            return false;
+        }
+        termsOut.write(kIndexMagic, sizeof(kIndexMagic) - 1);
+    } else {
+        runOut.open(outPath, std::ios::binary | std::ios::trunc);
+        if (!runOut.is_open()) {
+            std::cerr << "Error: could not write index run: " << outPath << "\n";
+            return false;
+        }
+    }
+
+    // Min-heap of cursors ordered by their current term.
+    auto greater = [&](size_t a, size_t b) { return cursors[a].term > cursors[b].term; };
+    std::priority_queue<size_t, std::vector<size_t>, decltype(greater)> heap(greater);
+    for (size_t i = 0; i < cursors.size(); ++i) {
+        if (cursors[i].next()) heap.push(i);
+    }
+
+    std::string term;
+    std::vector<Posting> merged;
+    std::string record;
+    uint64_t postingsOffset {0};
+    while (!heap.empty()) {
+        term = cursors[heap.top()].term;
+        merged.clear();
+        while (!heap.empty() && cursors[heap.top()].term == term) {
+            const size_t i {heap.top()};
+            heap.pop();
+            merged.insert(merged.end(), cursors[i].postings.begin(), cursors[i].postings.end());
+            if (cursors[i].next()) heap.push(i);
+        }
+
+        // Each run is sorted by docId, but runs from different threads interleave.
+        std::sort(merged.begin(), merged.end(), [](const Posting& a, const Posting& b) {
+            return a.docId < b.docId;
+        });
+
+        record.clear();
+        if (final) {
+            encodeFinalPostings(record, merged);
+            postingsOut.write(record.data(), static_cast<std::streamsize>(record.size()));
+
+            std::string entry;
+            putVarint(entry, term.size());
+            entry += term;
+            putVarint(entry, merged.size());
+            putVarint(entry, postingsOffset);
+            termsOut.write(entry.data(), static_cast<std::streamsize>(entry.size()));
+            postingsOffset += record.size();
+        } else {
+            encodeRunRecord(record, term, merged);
+            runOut.write(record.data(), static_cast<std::streamsize>(record.size()));
+        }
+    }
+
+    if (final) {
+        termsOut.close();
+        postingsOut.close();
+        return termsOut.good() && postingsOut.good();
+    }
+    runOut.close();
+    return runOut.good();
+}
+
+bool IndexBuilder::finish() {
+    if (!m_started) return false;
+    m_started = false;
+
+    {
+        std::lock_guard<std::mutex> lock(m_queueMutex);
+        m_finishing = true;
+    }
+    m_queueNotEmpty.notify_all();
+    m_queueNotFull.notify_all();
+    for (auto& thread : m_indexers) {
+        if (thread.joinable()) thread.join();
+    }
+    m_indexers.clear();
+
+    {
+        std::lock_guard<std::mutex> lock(m_runsMutex);
+        m_indexersDone = true;
+    }
+    m_runsChanged.notify_all();
+    if (m_merger.joinable()) m_merger.join();
+
+    m_docs.close();
+
+    const bool ok {mergeRuns(m_runs, m_options.directory, true)};
+    std::error_code ec;
+    for (const auto& run : m_runs) std::filesystem::remove(run.path, ec);
+    m_runs.clear();
+
+    return ok && !m_failed;
+}
@@ -1,6 +1,8 @@
 #include "main.hpp"
 #include "crawler.hpp"
 #include "csv_writer.hpp"
+#include "result_file.hpp"
+#include "control_commands.hpp"
 
 #include <string>
 #include <curl/curl.h>
@@ -8,6 +10,12 @@
 #include <iomanip>
 #include <ctime>
 #include <sstream>
+#include <algorithm>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <chrono>
+#include <sys/resource.h>
 
 // Checks if the URL is valid.
 static bool isValidUrl(const std::string& url) {
@@ -18,81 +26,349 @@ static bool isValidUrl(const std::string& url) {
     return rc == CURLUE_OK;
 }
 
-// Generate CSV filename with timestamp
-static std::string generateCsvFilename() {
+// Generate the results filename with timestamp
+static std::string generateResultsFilename(const char* extension) {
     auto now = std::time(nullptr);
     auto* localTime = std::localtime(&now);
     
     std::ostringstream oss;
     oss << "crawl_results_"
         << std::put_time(localTime, "%Y%m%d_%H%M%S")
-        << ".csv";
+        << extension;
     return oss.str();
 }
 
-int main(int argc, char* argv[]) {
-    if (argc < 2 || argc > 3) {
-        std::cerr << "Usage: " << argv[0] << " <start_url> [max_pages]\n";
-        std::cerr << "  start_url: The starting URL to crawl\n";
-        std::cerr << "  max_pages: Maximum number of pages to crawl (default: 100)\n";
-        return 1;
+// User plus system CPU time of the whole process so far.
+static std::chrono::microseconds processCpuTime() {
+    rusage usage {};
+    getrusage(RUSAGE_SELF, &usage);
+    auto toMicros = [](const timeval& time) {
+        return std::chrono::seconds(time.tv_sec) + std::chrono::microseconds(time.tv_usec);
+    };
+    return toMicros(usage.ru_utime) + toMicros(usage.ru_stime);
+}
+
+// Command line settings.
+struct CrawlerOptions {
+    std::string startUrl;
+    std::string seedFile;
+    std::string allowFile;
+    std::string blockFile;
+    std::string canonicalRulesFile;
+    std::string trapLogFile;
+    std::string hostsFile;
+    std::string indexDir;
+    std::string controlSocket;
+    bool sitemaps = false;
+    bool columnar = false;    // Write a .ccr result file instead of CSV
+    size_t parseThreads = 0;  // 0 means one per core
+    BudgetLimits budget;
+    ConcurrencyLimits limits;
+};
+
+static void printUsage(const char* program) {
+    std::cerr << "Usage: " << program << " [options] [start_url] [max_pages] [max_concurrency]\n";
+    std::cerr << "  start_url: The starting URL to crawl (optional with --seeds)\n";
+    std::cerr << "  max_pages: Maximum number of pages to crawl (default: 100)\n";
+    std::cerr << "  max_concurrency: Upper bound for the adaptive fetch concurrency (default: 32)\n";
+    std::cerr << "Options:\n";
+    std::cerr << "  --seeds <file>  Seed URLs, one per line\n";
+    std::cerr << "  --allow <file>  Domains to crawl (example.com, *.example.com, .example.com)\n";
+    std::cerr << "                  Default: only the hosts of the seed URLs\n";
+    std::cerr << "  --block <file>  Domains never to crawl, same syntax as --allow\n";
+    std::cerr << "  --canon-rules <file>         URL canonicalization rules (strip, rewrite, ...)\n";
+    std::cerr << "  --trap-log <file>            Log every URL the trap detector throttles or drops\n";
+    std::cerr << "  --hosts-file <file>          Fixed host addresses (/etc/hosts format), used instead of DNS\n";
+    std::cerr << "  --sitemaps      Also fill the frontier from each seed host's sitemaps\n";
+    std::cerr << "  --index <dir>   Build an inverted index of page text in <dir>\n";
+    std::cerr << "  --columnar      Write results as a columnar .ccr file (see crawler_results) instead of CSV\n";
+    std::cerr << "  --control <socket>           Serve live stats and commands on a Unix socket (try: help)\n";
+    std::cerr << "  --parse-threads <n>          Threads parsing pages (default: one per core)\n";
+    std::cerr << "  --host-budget <n>            At most n pages per host\n";
+    std::cerr << "  --depth-budget <depth>:<n>   At most n pages at a link depth (seeds are 0)\n";
+    std::cerr << "  --prefix-budget <prefix>:<n> At most n pages under host/path prefix, e.g. example.com/blog/\n";
+}
+
+// Parses a positive integer argument, printing an error on failure.
+static bool parseCount(const char* value, const char* name, size_t& out) {
+    try {
+        out = std::stoul(value);
+    } catch (const std::exception& e) {
+        std::cerr << "Invalid " << name << " value: " << value << "\n";
+        return false;
+    }
+    return true;
+}
+
+// Parses "<key>:<count>" budget arguments; the key may itself contain ':'.
+static bool parseKeyedCount(const char* value, const char* name, std::string& key, size_t& count) {
+    std::string text = value;
+    size_t colon = text.rfind(':');
+    if (colon == std::string::npos || colon == 0) {
+        std::cerr << "Invalid " << name << " value: " << value << "\n";
+        return false;
     }
+    key = text.substr(0, colon);
+    return parseCount(text.c_str() + colon + 1, name, count);
+}
 
-    std::string startUrl = argv[1];
-    size_t maxPages = 100;
+static bool parseArgs(int argc, char* argv[], CrawlerOptions& options) {
+    std::vector<std::string> positional;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg.rfind("--", 0) != 0) {
+            positional.push_back(arg);
+            continue;
+        }
+        
+        // Flags without a value
+        if (arg == "--sitemaps") {
+            options.sitemaps = true;
+            continue;
+        }
+        if (arg == "--columnar") {
+            options.columnar = true;
+            continue;
+        }
+        
+        if (i + 1 >= argc) {
+            std::cerr << "Missing value for " << arg << "\n";
+            return false;
+        }
+        const char* value = argv[++i];
+        if (arg == "--seeds") {
+            options.seedFile = value;
+        } else if (arg == "--allow") {
+            options.allowFile = value;
+        } else if (arg == "--block") {
+            options.blockFile = value;
+        } else if (arg == "--canon-rules") {
+            options.canonicalRulesFile = value;
+        } else if (arg == "--trap-log") {
+            options.trapLogFile = value;
+        } else if (arg == "--hosts-file") {
+            options.hostsFile = value;
+        } else if (arg == "--index") {
+            options.indexDir = value;
+        } else if (arg == "--control") {
+            options.controlSocket = value;
+        } else if (arg == "--parse-threads") {
+            if (!parseCount(value, "--parse-threads", options.parseThreads)) return false;
+        } else if (arg == "--host-budget") {
+            if (!parseCount(value, "--host-budget", options.budget.maxPagesPerHost)) return false;
+        } else if (arg == "--depth-budget") {
+            std::string depth;
+            size_t count = 0;
+            size_t depthValue = 0;
+            if (!parseKeyedCount(value, "--depth-budget", depth, count)) return false;
+            if (!parseCount(depth.c_str(), "--depth-budget", depthValue)) return false;
+            options.budget.maxPagesPerDepth[depthValue] = count;
+        } else if (arg == "--prefix-budget") {
+            std::string prefix;
+            size_t count = 0;
+            if (!parseKeyedCount(value, "--prefix-budget", prefix, count)) return false;
+            options.budget.maxPagesPerPrefix.emplace_back(prefix, count);
+        } else {
+            std::cerr << "Unknown option: " << arg << "\n";
+            return false;
+        }
+    }
     
-    if (argc == 3) {
-        try {
-            maxPages = std::stoul(argv[2]);
-        } catch (const std::exception& e) {
-            std::cerr << "Invalid max_pages value: " << argv[2] << "\n";
-            return 1;
+    // The start URL may be omitted when seeds come from a file.
+    size_t next = 0;
+    if (next < positional.size() && (options.seedFile.empty() || isValidUrl(positional[next]))) {
+        options.startUrl = positional[next++];
+    }
+    if (options.startUrl.empty() && options.seedFile.empty()) {
+        return false;
+    }
+    if (next < positional.size() && !parseCount(positional[next++].c_str(), "max_pages", options.budget.maxPages)) {
+        return false;
+    }
+    if (next < positional.size()) {
+        if (!parseCount(positional[next++].c_str(), "max_concurrency", options.limits.maxLimit)) {
+            return false;
+        }
+        if (options.limits.maxLimit == 0) {
+            std::cerr << "max_concurrency must be at least 1\n";
+            return false;
         }
+        options.limits.initialLimit = std::min(options.limits.initialLimit, options.limits.maxLimit);
+    }
+    if (next < positional.size()) {
+        return false;
+    }
+    return true;
+}
+
+int main(int argc, char* argv[]) {
+    CrawlerOptions options;
+    if (!parseArgs(argc, argv, options)) {
+        printUsage(argv[0]);
+        return 1;
     }
 
-    if (!isValidUrl(startUrl)) {
-        std::cerr << "URL is invalid: " << startUrl << "\n";
+    if (!options.startUrl.empty() && !isValidUrl(options.startUrl)) {
+        std::cerr << "URL is invalid: " << options.startUrl << "\n";
+        return 1;
+    }
+
+    DomainFilter domainFilter;
+    if (!options.allowFile.empty() && !domainFilter.loadAllowList(options.allowFile)) {
+        return 1;
+    }
+    if (!options.blockFile.empty() && !domainFilter.loadBlockList(options.blockFile)) {
+        return 1;
+    }
+
+    UrlCanonicalizer canonicalizer;
+    if (!options.canonicalRulesFile.empty() && !canonicalizer.loadRules(options.canonicalRulesFile)) {
         return 1;
     }
 
-    const size_t numThreads = 4;
-    
     std::cout << "Starting multithreaded web crawler...\n";
-    std::cout << "Start URL: " << startUrl << "\n";
-    std::cout << "Max pages: " << maxPages << "\n";
-    std::cout << "Threads: " << numThreads << "\n\n";
+    if (!options.startUrl.empty()) {
+        std::cout << "Start URL: " << options.startUrl << "\n";
+    }
+    if (!options.seedFile.empty()) {
+        std::cout << "Seed file: " << options.seedFile << "\n";
+    }
+    std::cout << "Max pages: " << options.budget.maxPages << "\n";
+    std::cout << "Concurrency: " << options.limits.initialLimit << " (adaptive, up to "
+              << options.limits.maxLimit << ")\n\n";
 
-    // Create crawler with specified number of threads
-    WebCrawler crawler(numThreads, maxPages);
+    // Create crawler; the concurrency limit adapts to server latency and errors
+    WebCrawler crawler(options.limits, options.budget);
+    crawler.setDomainFilter(std::move(domainFilter));
+    crawler.setCanonicalizer(std::move(canonicalizer));
+    if (!options.trapLogFile.empty() && !crawler.setTrapLog(options.trapLogFile)) {
+        return 1;
+    }
+    if (!options.hostsFile.empty() && !crawler.loadHostsFile(options.hostsFile)) {
+        return 1;
+    }
+    crawler.setSitemapDiscovery(options.sitemaps);
+    crawler.setParseThreads(options.parseThreads);
     
-    // Start crawling
-    crawler.start(startUrl);
+    // Optional indexing stage, running on its own threads
+    std::unique_ptr<IndexBuilder> indexer;
+    if (!options.indexDir.empty()) {
+        IndexOptions indexOptions;
+        indexOptions.directory = options.indexDir;
+        indexer = std::make_unique<IndexBuilder>(indexOptions);
+        if (!indexer->start()) {
+            return 1;
+        }
+        crawler.setIndexBuilder(indexer.get());
+    }
     
-    // Get results
-    auto results = crawler.getResults();
+    // Load seeds
+    size_t seeds = 0;
+    if (!options.startUrl.empty()) {
+        seeds += crawler.addSeeds({options.startUrl});
+    }
+    if (!options.seedFile.empty()) {
+        seeds += crawler.loadSeedFile(options.seedFile);
+    }
+    if (seeds == 0) {
+        std::cerr << "No seed URLs to crawl\n";
+        return 1;
+    }
+    std::cout << "Seeds: " << seeds << "\n";
     
-    // Generate CSV filename
-    std::string csvFilename = generateCsvFilename();
+    // Rows are written by the crawler's result sink as pages finish, so
+    // results are never all held in memory
+    std::string resultsFilename = generateResultsFilename(options.columnar ? ".ccr" : ".csv");
+    std::unique_ptr<CsvWriter> csvWriter;
+    std::unique_ptr<ResultFileWriter> columnarWriter;
+    if (options.columnar) {
+        columnarWriter = std::make_unique<ResultFileWriter>(resultsFilename);
+        if (!columnarWriter->writeHeader()) {
+            std::cerr << "Failed to write result file header\n";
+            return 1;
+        }
+    } else {
+        csvWriter = std::make_unique<CsvWriter>(resultsFilename);
+        if (!csvWriter->writeHeader()) {
+            std::cerr << "Failed to write CSV header\n";
+            return 1;
+        }
+    }
+    bool writeFailed = false;
+    std::mutex writerMutex;  // The control server may flush while the sink writes
+    crawler.setResultSink([&](const CrawlResult& result) {
+        std::lock_guard<std::mutex> lock(writerMutex);
+        const bool written = columnarWriter ? columnarWriter->writeResult(result) : csvWriter->writeResult(result);
+        if (!written && !writeFailed) {
+            std::cerr << "Failed to write result to " << resultsFilename << "\n";
+            writeFailed = true;
+        }
+    });
     
-    // Write results to CSV
-    CsvWriter csvWriter(csvFilename);
-    if (!csvWriter.writeHeader()) {
-        std::cerr << "Failed to write CSV header\n";
-        return 1;
+    // Live stats and runtime controls. Commands run on the control server's
+    // thread; stats are read from the crawler's published snapshot.
+    ControlServer control;
+    if (!options.controlSocket.empty()) {
+        crawler.setStatsInterval(std::chrono::seconds(1));
+        addCrawlCommands(control, crawler, [&](std::string& error) {
+            if (indexer) {
+                indexer->flush();
+            }
+            std::lock_guard<std::mutex> lock(writerMutex);
+            if (!(columnarWriter ? columnarWriter->flush() : csvWriter->flush())) {
+                error = "failed to flush " + resultsFilename;
+                return false;
+            }
+            return true;
+        });
+        
+        if (!control.start(options.controlSocket)) {
+            return 1;
+        }
+        std::cout << "Control socket: " << options.controlSocket << "\n";
     }
     
-    for (const auto& result : results) {
-        if (!csvWriter.writeResult(result)) {
-            std::cerr << "Failed to write result to CSV\n";
+    // Start crawling
+    const auto wallStart = std::chrono::steady_clock::now();
+    const auto cpuStart = processCpuTime();
+    crawler.start();
+    const std::chrono::duration<double> wallTime = std::chrono::steady_clock::now() - wallStart;
+    const std::chrono::duration<double, std::milli> cpuTime = processCpuTime() - cpuStart;
+    control.stop();
+    
+    if (indexer) {
+        std::cout << "Merging index...\n";
+        if (!indexer->finish()) {
+            std::cerr << "Failed to write index to " << options.indexDir << "\n";
             return 1;
         }
+        std::cout << "Indexed " << indexer->documentCount() << " pages into " << options.indexDir << "\n";
     }
     
-    csvWriter.flush();
+    const bool closed = columnarWriter ? columnarWriter->finish() : csvWriter->flush();
+    if (!closed || writeFailed) {
+        return 1;
+    }
     
     std::cout << "\nCrawling completed!\n";
-    std::cout << "Total pages crawled: " << results.size() << "\n";
-    std::cout << "Results saved to: " << csvFilename << "\n";
+    std::cout << "Total pages crawled: " << crawler.pagesCrawled() << "\n";
+    // The benchmark scripts parse these two lines
+    const size_t pages = std::max<size_t>(1, crawler.pagesCrawled());
+    std::cout << std::fixed << std::setprecision(1)
+              << "Throughput: " << crawler.pagesCrawled() / wallTime.count() << " pages/sec over "
+              << wallTime.count() << " s\n"
+              << std::setprecision(3)
+              << "CPU per page: " << cpuTime.count() / pages << " ms (" << cpuTime.count() / 1000.0 << " s total)\n"
+              << std::defaultfloat;
+    std::cout << "Retries: " << crawler.retriesScheduled() << " scheduled\n";
+    std::cout << "DNS: " << crawler.resolver().lookups() << " lookups, "
+              << crawler.resolver().failedLookups() << " failed, "
+              << crawler.unresolvedUrls() << " URLs of unresolvable hosts dropped\n";
+    std::cout << "Trap detector: " << crawler.trapDetector().throttled() << " URLs throttled, "
+              << crawler.trapDetector().dropped() << " dropped\n";
+    std::cout << "Canonicalizer: " << crawler.canonicalizer().learnedParameters() << " parameter rules learned, "
+              << crawler.canonicalizer().revokedParameters() << " revoked\n";
+    std::cout << "Results saved to: " << resultsFilename << "\n";
 
     return 0;
 }
@@ -0,0 +1,56 @@
+#include "mapped_file.hpp"
+
+#include <iostream>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+MappedFile::~MappedFile() {
+    close();
+}
+
+void MappedFile::close() {
+    if (m_data && m_size > 0) {
+        munmap(const_cast<char*>(m_data), m_size);
+    }
+    m_data = nullptr;
+    m_size = 0;
+}
+
+bool MappedFile::open(const std::string& path) {
+    // Reopening replaces the previous mapping
+    close();
+
+    int fd {::open(path.c_str(), O_RDONLY)};
+    if (fd < 0) {
+        std::cerr << "Error: could not open file: " << path << "\n";
+        return false;
+    }
+
+    struct stat st {};
+    if (fstat(fd, &st) != 0) {
+        std::cerr << "Error: could not stat file: " << path << "\n";
+        ::close(fd);
+        return false;
+    }
+
+    m_size = static_cast<size_t>(st.st_size);
+    if (m_size == 0) {
+        ::close(fd);
+        return true;
+    }
+
+    void* mapped {mmap(nullptr, m_size, PROT_READ, MAP_PRIVATE, fd, 0)};
+    ::close(fd);
+    if (mapped == MAP_FAILED) {
+        std::cerr << "Error: could not map file: " << path << "\n";
+        m_size = 0;
+        return false;
+    }
+
+    // Seed lists and index files are mostly scanned front to back.
+    madvise(mapped, m_size, MADV_SEQUENTIAL);
+    m_data = static_cast<const char*>(mapped);
+    return true;
+}
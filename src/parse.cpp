@@ -1,6 +1,9 @@
 #include "parse.hpp"
 
 #include <iostream>
+#include <string_view>
+#include <algorithm>
+#include <cctype>
 
 extern "C" {
 #include <lexbor/dom/interfaces/element.h>
@@ -126,3 +129,127 @@ std::vector<std::string> extractLinks(const std::string& html) {
 
     return links;
 }
+
+
+// Elements whose text content is never shown to a reader.
+static bool isInvisibleElement(lxb_tag_id_t tag) {
+    return tag == LXB_TAG_SCRIPT || tag == LXB_TAG_STYLE || tag == LXB_TAG_NOSCRIPT ||
+           tag == LXB_TAG_TEMPLATE || tag == LXB_TAG_HEAD;
+}
+
+// Returns an attribute's value, or an empty view if it is missing.
+static std::string_view attributeValue(lxb_dom_element_t* element, const char* name, size_t nameLength) {
+    lxb_dom_attr_t* attribute {lxb_dom_element_attr_by_name(element, reinterpret_cast<const lxb_char_t*>(name), nameLength)};
+    if (!attribute) return {};
+    size_t length {};
+    const lxb_char_t* data {lxb_dom_attr_value(attribute, &length)};
+    return data ? std::string_view(reinterpret_cast<const char*>(data), length) : std::string_view();
+}
+
+// True if a space-separated rel attribute contains "canonical" (in any case).
+static bool isCanonicalRel(std::string_view rel) {
+    constexpr std::string_view token {"canonical"};
+    size_t start {0};
+    while (start < rel.size()) {
+        size_t end {rel.find_first_of(" \t\n\r\f", start)};
+        if (end == std::string_view::npos) end = rel.size();
+        std::string_view word {rel.substr(start, end - start)};
+        if (word.size() == token.size() &&
+            std::equal(word.begin(), word.end(), token.begin(), [](char a, char b) {
+                return std::tolower(static_cast<unsigned char>(a)) == b;
+            })) {
+            return true;
+        }
+        start = end + 1;
+    }
+    return false;
+}
+
+// Performs a DFS collecting links and, if withText, visible text into the page.
+static void collectPageDfs(lxb_dom_node_t* node, ParsedPage& page, bool withText) {
+    for (lxb_dom_node_t* curr {node}; curr; curr = lxb_dom_node_next(curr)) {
+        bool childText {withText};
+
+        if (curr->type == LXB_DOM_NODE_TYPE_ELEMENT) {
+            auto* element {lxb_dom_interface_element(curr)};
+            lxb_tag_id_t tag {lxb_dom_element_tag_id(element)};
+
+            if (tag == LXB_TAG_A) {
+                const lxb_char_t* name {(const lxb_char_t*)"href"};
+                lxb_dom_attr_t* attribute {lxb_dom_element_attr_by_name(element, name, 4)};
+                if (attribute) {
+                    size_t length {};
+                    const lxb_char_t* data {lxb_dom_attr_value(attribute, &length)};
+                    if (data) {
+                        page.links.emplace_back(reinterpret_cast<const char*>(data), length);
+                    }
+                }
+            }
+
+            // The first <link rel="canonical"> wins, like in browsers' tooling
+            if (tag == LXB_TAG_LINK && page.canonical.empty() &&
+                isCanonicalRel(attributeValue(element, "rel", 3))) {
+                page.canonical = attributeValue(element, "href", 4);
+            }
+
+            if (isInvisibleElement(tag)) childText = false;
+        } else if (withText && curr->type == LXB_DOM_NODE_TYPE_TEXT) {
+            lxb_dom_character_data_t* textData {lxb_dom_interface_character_data(curr)};
+            size_t textLength {0};
+            const lxb_char_t* textContent {lxb_dom_character_data_data(textData, &textLength)};
+            if (textContent && textLength > 0) {
+                // Separate text nodes so words from adjacent elements do not merge.
+                if (!page.text.empty()) page.text += ' ';
+                page.text.append(reinterpret_cast<const char*>(textContent), textLength);
+            }
+        }
+
+        auto* child {lxb_dom_node_first_child(curr)};
+        if (child) {
+            collectPageDfs(child, page, childText);
+        }
+    }
+}
+
+// Parses the HTML once and extracts the title, links and (optionally) visible text.
+ParsedPage parsePage(const std::string& html, bool withText) {
+    ParsedPage page;
+
+    lxb_html_document_t* document = lxb_html_document_create();
+    if (document == nullptr) {
+        std::cerr << "Failed to create HTML Document.\n";
+        return page;
+    }
+
+    lxb_status_t status = lxb_html_document_parse(document, reinterpret_cast<const lxb_char_t*>(html.data()), html.size());
+    if (status != LXB_STATUS_OK) {
+        std::cerr << "Failed to parse HTML.\n";
+        lxb_html_document_destroy(document);
+        return page;
+    }
+
+    // Title, collected the same way as extractTitle()
+    lxb_dom_element_t* titleElement = lxb_html_document_title_element(document);
+    if (titleElement != nullptr) {
+        lxb_dom_node_t* child = lxb_dom_node_first_child(lxb_dom_interface_node(titleElement));
+        for (; child != nullptr; child = lxb_dom_node_next(child)) {
+            if (child->type == LXB_DOM_NODE_TYPE_TEXT) {
+                lxb_dom_character_data_t* textData = lxb_dom_interface_character_data(child);
+                size_t textLength = 0;
+                const lxb_char_t* textContent = lxb_dom_character_data_data(textData, &textLength);
+                if (textContent && textLength > 0) {
+                    page.title.append(reinterpret_cast<const char*>(textContent), textLength);
+                }
+            }
+        }
+    }
+
+    // Walk the whole document; the head is visited for links but contributes no text.
+    auto* root = lxb_dom_interface_node(lxb_dom_interface_document(document));
+    lxb_dom_node_t* start = lxb_dom_node_first_child(root);
+    if (start) collectPageDfs(start, page, withText);
+
+    lxb_html_document_destroy(document);
+
+    return page;
+}
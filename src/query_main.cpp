@@ -0,0 +1,35 @@
+#include "inverted_index.hpp"
+
+#include <iostream>
+#include <string>
+
+// Small query tool for indexes written by `crawler --index <dir>`.
+int main(int argc, char* argv[]) {
+    if (argc < 3) {
+        std::cerr << "Usage: " << argv[0] << " <index_dir> <term> [term...]\n";
+        std::cerr << "  Prints the pages containing every term, best match first.\n";
+        return 1;
+    }
+
+    IndexReader reader;
+    if (!reader.open(argv[1])) {
+        std::cerr << "Failed to open index: " << argv[1] << "\n";
+        return 1;
+    }
+
+    std::string query;
+    for (int i = 2; i < argc; ++i) {
+        if (!query.empty()) query += ' ';
+        query += argv[i];
+    }
+
+    const size_t maxHits = 20;
+    auto hits = reader.search(query, maxHits);
+    for (const auto& hit : hits) {
+        std::cout << hit.score << "\t" << reader.url(hit.docId) << "\n";
+    }
+
+    std::cerr << hits.size() << " result(s) from " << reader.documentCount()
+              << " documents, " << reader.termCount() << " terms\n";
+    return 0;
+}
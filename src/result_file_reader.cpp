@@ -0,0 +1,271 @@
+#include "result_file.hpp"
+#include "varint.hpp"
+
+#include <iostream>
+#include <algorithm>
+
+static constexpr size_t kMagicLength {sizeof(kResultFileMagic) - 1};
+static constexpr size_t kTrailerLength {8 + kMagicLength};
+
+static int64_t unzigzag(uint64_t value) {
+    return static_cast<int64_t>(value >> 1) ^ -static_cast<int64_t>(value & 1);
+}
+
+// Walks a front-coded string chunk row by row, rebuilding each value in place.
+class FrontCodedCursor {
+public:
+    explicit FrontCodedCursor(std::string_view chunk)
+        : m_p(chunk.data()), m_end(chunk.data() + chunk.size()) {}
+
+    bool next() {
+        uint64_t shared {0};
+        uint64_t length {0};
+        if (!getVarint(m_p, m_end, shared) || !getVarint(m_p, m_end, length) ||
+            shared > m_value.size() || static_cast<uint64_t>(m_end - m_p) < length) {
+            return false;
+        }
+        m_value.resize(shared);
+        m_value.append(m_p, length);
+        m_p += length;
+        return true;
+    }
+
+    const std::string& value() const { return m_value; }
+
+private:
+    const char* m_p;
+    const char* m_end;
+    std::string m_value;
+};
+
+// Decodes a status chunk into its dictionary and per-row dictionary indexes.
+static bool decodeStatus(std::string_view chunk, uint64_t rows, std::vector<long>& dictionary,
+                         std::vector<uint32_t>& indexes) {
+    const char* p {chunk.data()};
+    const char* end {chunk.data() + chunk.size()};
+    uint64_t entries {0};
+    if (!getVarint(p, end, entries) || entries > rows) return false;
+    dictionary.resize(entries);
+    for (auto& status : dictionary) {
+        uint64_t value {0};
+        if (!getVarint(p, end, value)) return false;
+        status = static_cast<long>(unzigzag(value));
+    }
+    indexes.resize(rows);
+    for (auto& index : indexes) {
+        uint64_t value {0};
+        if (!getVarint(p, end, value) || value >= entries) return false;
+        index = static_cast<uint32_t>(value);
+    }
+    return true;
+}
+
+static bool decodeVarints(std::string_view chunk, uint64_t rows, std::vector<uint64_t>& out) {
+    const char* p {chunk.data()};
+    const char* end {chunk.data() + chunk.size()};
+    out.resize(rows);
+    for (auto& value : out) {
+        if (!getVarint(p, end, value)) return false;
+    }
+    return true;
+}
+
+bool ResultFileReader::open(const std::string& path) {
+    m_groups.clear();
+    m_rowCount = 0;
+    if (!m_file.open(path)) return false;
+
+    const std::string_view data {m_file.data()};
+    if (data.size() < kMagicLength + kTrailerLength || data.substr(0, kMagicLength) != kResultFileMagic ||
+        data.substr(data.size() - kMagicLength) != kResultFileMagic) {
+        std::cerr << "Error: not a result file (or not finished): " << path << "\n";
+        return false;
+    }
+
+    uint64_t footerOffset {0};
+    const size_t trailer {data.size() - kTrailerLength};
+    for (int i = 0; i < 8; ++i) {
+        footerOffset |= static_cast<uint64_t>(static_cast<unsigned char>(data[trailer + i])) << (8 * i);
+    }
+    if (footerOffset < kMagicLength || footerOffset > trailer) {
+        std::cerr << "Error: corrupt footer in " << path << "\n";
+        return false;
+    }
+
+    const char* p {data.data() + footerOffset};
+    const char* end {data.data() + trailer};
+    uint64_t groups {0};
+    if (!getVarint(p, end, groups)) {
+        std::cerr << "Error: corrupt footer in " << path << "\n";
+        return false;
+    }
+
+    uint64_t previousEnd {kMagicLength};
+    for (uint64_t i = 0; i < groups; ++i) {
+        RowGroupInfo info;
+        uint64_t values[6] {};
+        bool ok {getVarint(p, end, info.rows)};
+        for (auto& offset : info.offsets) {
+            ok = ok && getVarint(p, end, offset);
+        }
+        for (auto& value : values) {
+            ok = ok && getVarint(p, end, value);
+        }
+        // Chunks must follow each other inside the row group area
+        for (size_t c = 0; ok && c < std::size(info.offsets); ++c) {
+            ok = info.offsets[c] >= previousEnd && info.offsets[c] <= footerOffset;
+            previousEnd = info.offsets[c];
+        }
+        // Every row takes at least one byte of the link count chunk
+        const size_t links {static_cast<size_t>(ResultColumn::LinkCount)};
+        ok = ok && info.rows <= info.offsets[links + 1] - info.offsets[links];
+        if (!ok) {
+            std::cerr << "Error: corrupt footer in " << path << "\n";
+            m_groups.clear();
+            return false;
+        }
+        info.minStatus = static_cast<long>(unzigzag(values[0]));
+        info.maxStatus = static_cast<long>(unzigzag(values[1]));
+        info.minLinkCount = values[2];
+        info.maxLinkCount = values[3];
+        info.minLastModified = static_cast<std::time_t>(unzigzag(values[4]));
+        info.maxLastModified = static_cast<std::time_t>(unzigzag(values[5]));
+        m_rowCount += info.rows;
+        m_groups.push_back(info);
+    }
+    return true;
+}
+
+std::string_view ResultFileReader::chunk(size_t group, ResultColumn column) const {
+    const RowGroupInfo& info {m_groups[group]};
+    const size_t c {static_cast<size_t>(column)};
+    return m_file.data().substr(info.offsets[c], info.offsets[c + 1] - info.offsets[c]);
+}
+
+bool ResultFileReader::readStrings(size_t group, ResultColumn column, std::vector<std::string>& out) const {
+    if (column != ResultColumn::Url && column != ResultColumn::Title && column != ResultColumn::Error) {
+        return false;
+    }
+    FrontCodedCursor cursor(chunk(group, column));
+    out.resize(m_groups[group].rows);
+    for (auto& value : out) {
+        if (!cursor.next()) return false;
+        value = cursor.value();
+    }
+    return true;
+}
+
+bool ResultFileReader::readStatus(size_t group, std::vector<long>& out) const {
+    std::vector<long> dictionary;
+    std::vector<uint32_t> indexes;
+    if (!decodeStatus(chunk(group, ResultColumn::Status), m_groups[group].rows, dictionary, indexes)) {
+        return false;
+    }
+    out.resize(indexes.size());
+    for (size_t i = 0; i < indexes.size(); ++i) {
+        out[i] = dictionary[indexes[i]];
+    }
+    return true;
+}
+
+bool ResultFileReader::readLinkCounts(size_t group, std::vector<uint64_t>& out) const {
+    return decodeVarints(chunk(group, ResultColumn::LinkCount), m_groups[group].rows, out);
+}
+
+bool ResultFileReader::readLastModified(size_t group, std::vector<std::time_t>& out) const {
+    std::vector<uint64_t> values;
+    if (!decodeVarints(chunk(group, ResultColumn::LastModified), m_groups[group].rows, values)) {
+        return false;
+    }
+    out.resize(values.size());
+    for (size_t i = 0; i < values.size(); ++i) {
+        out[i] = static_cast<std::time_t>(unzigzag(values[i]));
+    }
+    return true;
+}
+
+// Row group statistics rule out groups without any possible match.
+bool ResultFileReader::mayMatch(const RowGroupInfo& group, const ResultFilter& filter) const {
+    if (group.rows == 0) return false;
+    if (filter.status && (*filter.status < group.minStatus || *filter.status > group.maxStatus)) return false;
+    return group.maxLinkCount >= filter.minLinkCount && group.minLinkCount <= filter.maxLinkCount;
+}
+
+// Collects the indexes of the matching rows of a group, decoding only the
+// columns whose statistics do not already settle the filter.
+bool ResultFileReader::selectRows(size_t group, const ResultFilter& filter, std::vector<uint32_t>& rows) const {
+    rows.clear();
+    const RowGroupInfo& info {m_groups[group]};
+    if (!mayMatch(info, filter)) return true;
+
+    const bool checkStatus {filter.status && (info.minStatus != *filter.status || info.maxStatus != *filter.status)};
+    const bool checkLinks {info.minLinkCount < filter.minLinkCount || info.maxLinkCount > filter.maxLinkCount};
+
+    uint32_t wanted {UINT32_MAX};
+    std::vector<long> dictionary;
+    std::vector<uint32_t> indexes;
+    if (checkStatus) {
+        if (!decodeStatus(chunk(group, ResultColumn::Status), info.rows, dictionary, indexes)) return false;
+        auto it {std::find(dictionary.begin(), dictionary.end(), *filter.status)};
+        if (it == dictionary.end()) return true;  // Within min/max, but absent
+        wanted = static_cast<uint32_t>(it - dictionary.begin());
+    }
+
+    std::vector<uint64_t> links;
+    if (checkLinks && !readLinkCounts(group, links)) return false;
+
+    rows.reserve(info.rows);
+    for (uint32_t row = 0; row < info.rows; ++row) {
+        if (checkStatus && indexes[row] != wanted) continue;
+        if (checkLinks && (links[row] < filter.minLinkCount || links[row] > filter.maxLinkCount)) continue;
+        rows.push_back(row);
+    }
+    return true;
+}
+
+std::optional<uint64_t> ResultFileReader::count(const ResultFilter& filter) const {
+    uint64_t total {0};
+    std::vector<uint32_t> rows;
+    for (size_t group = 0; group < m_groups.size(); ++group) {
+        if (!selectRows(group, filter, rows)) return std::nullopt;
+        total += rows.size();
+    }
+    return total;
+}
+
+bool ResultFileReader::scan(const ResultFilter& filter, const std::function<void(const CrawlResult&)>& onRow) const {
+    std::vector<uint32_t> rows;
+    std::vector<long> status;
+    std::vector<uint64_t> links;
+    std::vector<std::time_t> lastModified;
+    CrawlResult result;
+
+    for (size_t group = 0; group < m_groups.size(); ++group) {
+        if (!selectRows(group, filter, rows)) return false;
+        if (rows.empty()) continue;
+
+        if (!readStatus(group, status) || !readLinkCounts(group, links) || !readLastModified(group, lastModified)) {
+            return false;
+        }
+
+        // Front coding needs every row decoded in order; only matches are copied out
+        FrontCodedCursor urls(chunk(group, ResultColumn::Url));
+        FrontCodedCursor titles(chunk(group, ResultColumn::Title));
+        FrontCodedCursor errors(chunk(group, ResultColumn::Error));
+        size_t next {0};
+        for (uint32_t row = 0; row < m_groups[group].rows && next < rows.size(); ++row) {
+            if (!urls.next() || !titles.next() || !errors.next()) return false;
+            if (rows[next] != row) continue;
+            next++;
+
+            result.url = urls.value();
+            result.title = titles.value();
+            result.error = errors.value();
+            result.status = status[row];
+            result.linkCount = static_cast<size_t>(links[row]);
+            result.lastModified = lastModified[row];
+            onRow(result);
+        }
+    }
+    return true;
+}
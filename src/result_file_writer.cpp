@@ -0,0 +1,175 @@
+#include "result_file.hpp"
+#include "varint.hpp"
+
+#include <iostream>
+#include <algorithm>
+
+static uint64_t zigzag(int64_t value) {
+    return (static_cast<uint64_t>(value) << 1) ^ static_cast<uint64_t>(value >> 63);
+}
+
+// Front coding: each value is stored as the length of the prefix it shares
+// with the previous row plus the rest. Consecutive URLs of a host, and titles
+// ending in the site name, mostly differ in a short tail.
+static void putFrontCoded(std::string& out, const std::vector<CrawlResult>& rows,
+                          const std::string CrawlResult::*field) {
+    std::string_view previous;
+    for (const auto& row : rows) {
+        const std::string& value {row.*field};
+        const size_t limit {std::min(previous.size(), value.size())};
+        size_t shared {0};
+        while (shared < limit && previous[shared] == value[shared]) ++shared;
+        putVarint(out, shared);
+        putVarint(out, value.size() - shared);
+        out.append(value, shared, std::string::npos);
+        previous = value;
+    }
+}
+
+// Status codes take a handful of distinct values, so each row's index into the
+// group's dictionary fits in one varint byte.
+static void putStatusDictionary(std::string& out, const std::vector<CrawlResult>& rows) {
+    std::vector<long> dictionary;
+    for (const auto& row : rows) dictionary.push_back(row.status);
+    std::sort(dictionary.begin(), dictionary.end());
+    dictionary.erase(std::unique(dictionary.begin(), dictionary.end()), dictionary.end());
+
+    putVarint(out, dictionary.size());
+    for (long status : dictionary) putVarint(out, zigzag(status));
+    for (const auto& row : rows) {
+        putVarint(out, static_cast<uint64_t>(
+            std::lower_bound(dictionary.begin(), dictionary.end(), row.status) - dictionary.begin()));
+    }
+}
+
+ResultFileWriter::ResultFileWriter(const std::string& filename)
+    : m_filename(filename) {
+    m_file.open(filename, std::ios::out | std::ios::binary | std::ios::trunc);
+    if (!m_file.is_open()) {
+        std::cerr << "Error: could not open result file for writing: " << filename << "\n";
+    }
+}
+
+ResultFileWriter::~ResultFileWriter() {
+    if (m_file.is_open() && !m_finished) {
+        finish();
+    }
+}
+
+bool ResultFileWriter::writeHeader() {
+    if (!m_file.is_open()) {
+        return false;
+    }
+
+    m_file.write(kResultFileMagic, sizeof(kResultFileMagic) - 1);
+    m_offset = sizeof(kResultFileMagic) - 1;
+    return m_file.good();
+}
+
+bool ResultFileWriter::writeResult(const CrawlResult& result) {
+    if (!m_file.is_open() || m_finished) {
+        return false;
+    }
+
+    if (m_rows.empty()) m_rows.reserve(kResultRowGroupSize);
+    m_rows.push_back(result);
+    if (m_rows.size() == kResultRowGroupSize) {
+        return writeRowGroup();
+    }
+    return true;
+}
+
+bool ResultFileWriter::writeRowGroup() {
+    if (m_rows.empty()) return true;
+
+    RowGroupInfo info;
+    info.rows = m_rows.size();
+    std::string buffer;
+    auto startColumn = [&](ResultColumn column) {
+        info.offsets[static_cast<size_t>(column)] = m_offset + buffer.size();
+    };
+
+    startColumn(ResultColumn::Url);
+    putFrontCoded(buffer, m_rows, &CrawlResult::url);
+    startColumn(ResultColumn::Title);
+    putFrontCoded(buffer, m_rows, &CrawlResult::title);
+    startColumn(ResultColumn::Error);
+    putFrontCoded(buffer, m_rows, &CrawlResult::error);
+    startColumn(ResultColumn::Status);
+    putStatusDictionary(buffer, m_rows);
+    startColumn(ResultColumn::LinkCount);
+    for (const auto& row : m_rows) putVarint(buffer, row.linkCount);
+    startColumn(ResultColumn::LastModified);
+    for (const auto& row : m_rows) putVarint(buffer, zigzag(row.lastModified));
+    startColumn(ResultColumn::Count);
+
+    info.minStatus = info.maxStatus = m_rows.front().status;
+    info.minLinkCount = info.maxLinkCount = m_rows.front().linkCount;
+    info.minLastModified = info.maxLastModified = m_rows.front().lastModified;
+    for (const auto& row : m_rows) {
+        info.minStatus = std::min(info.minStatus, row.status);
+        info.maxStatus = std::max(info.maxStatus, row.status);
+        info.minLinkCount = std::min<uint64_t>(info.minLinkCount, row.linkCount);
+        info.maxLinkCount = std::max<uint64_t>(info.maxLinkCount, row.linkCount);
+        info.minLastModified = std::min(info.minLastModified, row.lastModified);
+        info.maxLastModified = std::max(info.maxLastModified, row.lastModified);
+    }
+
+    m_file.write(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+    m_offset += buffer.size();
+    m_groups.push_back(info);
+    m_rows.clear();
+    return m_file.good();
+}
+
+bool ResultFileWriter::flush() {
+    if (!m_file.is_open() || m_finished) {
+        return false;
+    }
+    if (!writeRowGroup()) {
+        return false;
+    }
+    m_file.flush();
+    return m_file.good();
+}
+
+bool ResultFileWriter::finish() {
+    if (!m_file.is_open()) {
+        return false;
+    }
+    if (m_finished) {
+        return m_file.good();
+    }
+    m_finished = true;
+    if (!writeRowGroup()) {
+        return false;
+    }
+
+    std::string footer;
+    putVarint(footer, m_groups.size());
+    for (const auto& group : m_groups) {
+        putVarint(footer, group.rows);
+        for (uint64_t offset : group.offsets) putVarint(footer, offset);
+        putVarint(footer, zigzag(group.minStatus));
+        putVarint(footer, zigzag(group.maxStatus));
+        putVarint(footer, group.minLinkCount);
+        putVarint(footer, group.maxLinkCount);
+        putVarint(footer, zigzag(group.minLastModified));
+        putVarint(footer, zigzag(group.maxLastModified));
+    }
+
+    // Fixed-size trailer, so readers can find the footer from the end of the file
+    const uint64_t footerOffset {m_offset};
+    for (int i = 0; i < 8; ++i) {
+        footer += static_cast<char>((footerOffset >> (8 * i)) & 0xFF);
+    }
+    footer.append(kResultFileMagic, sizeof(kResultFileMagic) - 1);
+
+    m_file.write(footer.data(), static_cast<std::streamsize>(footer.size()));
+    m_file.flush();
+    if (!m_file.good()) {
+        std::cerr << "Error: could not write result file: " << m_filename << "\n";
+        return false;
+    }
+    return true;
+}
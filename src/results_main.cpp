@@ -0,0 +1,116 @@
+#include "result_file.hpp"
+#include "csv_writer.hpp"
+
+#include <iostream>
+#include <string>
+#include <memory>
+
+static void printUsage(const char* program) {
+    std::cerr << "Usage: " << program << " <results.ccr> [options]\n";
+    std::cerr << "  Prints status, link count and URL of every matching page.\n";
+    std::cerr << "Options:\n";
+    std::cerr << "  --status <code>     Only pages with this status (0: transfer failed)\n";
+    std::cerr << "  --min-links <n>     Only pages with at least n links\n";
+    std::cerr << "  --max-links <n>     Only pages with at most n links\n";
+    std::cerr << "  --count             Print the number of matching pages only\n";
+    std::cerr << "  --csv <file>        Write the matching pages to a CSV file instead\n";
+}
+
+// Parses a non-negative integer argument, printing an error on failure.
+static bool parseNumber(const char* value, const char* name, uint64_t& out) {
+    try {
+        out = std::stoull(value);
+    } catch (const std::exception& e) {
+        std::cerr << "Invalid " << name << " value: " << value << "\n";
+        return false;
+    }
+    return true;
+}
+
+// Filters and converts result files written by `crawler --columnar`.
+int main(int argc, char* argv[]) {
+    if (argc < 2) {
+        printUsage(argv[0]);
+        return 1;
+    }
+
+    ResultFilter filter;
+    bool countOnly = false;
+    std::string csvFile;
+    for (int i = 2; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--count") {
+            countOnly = true;
+            continue;
+        }
+        if (i + 1 >= argc) {
+            printUsage(argv[0]);
+            return 1;
+        }
+        const char* value = argv[++i];
+        uint64_t number = 0;
+        if (arg == "--status") {
+            if (!parseNumber(value, "--status", number)) return 1;
+            filter.status = static_cast<long>(number);
+        } else if (arg == "--min-links") {
+            if (!parseNumber(value, "--min-links", filter.minLinkCount)) return 1;
+        } else if (arg == "--max-links") {
+            if (!parseNumber(value, "--max-links", filter.maxLinkCount)) return 1;
+        } else if (arg == "--csv") {
+            csvFile = value;
+        } else {
+            std::cerr << "Unknown option: " << arg << "\n";
+            printUsage(argv[0]);
+            return 1;
+        }
+    }
+
+    ResultFileReader reader;
+    if (!reader.open(argv[1])) {
+        std::cerr << "Failed to open result file: " << argv[1] << "\n";
+        return 1;
+    }
+
+    // Counting needs neither the strings nor the rows that cannot match
+    if (countOnly) {
+        auto matches = reader.count(filter);
+        if (!matches) {
+            std::cerr << "Corrupt result file: " << argv[1] << "\n";
+            return 1;
+        }
+        std::cout << *matches << "\n";
+        return 0;
+    }
+
+    std::unique_ptr<CsvWriter> csvWriter;
+    if (!csvFile.empty()) {
+        csvWriter = std::make_unique<CsvWriter>(csvFile);
+        if (!csvWriter->writeHeader()) {
+            std::cerr << "Failed to write CSV header\n";
+            return 1;
+        }
+    }
+
+    uint64_t matches = 0;
+    bool csvFailed = false;
+    const bool ok = reader.scan(filter, [&](const CrawlResult& result) {
+        matches++;
+        if (!csvWriter) {
+            std::cout << result.status << "\t" << result.linkCount << "\t" << result.url << "\n";
+        } else if (!csvFailed && !csvWriter->writeResult(result)) {
+            std::cerr << "Failed to write result to CSV\n";
+            csvFailed = true;
+        }
+    });
+    if (!ok) {
+        std::cerr << "Corrupt result file: " << argv[1] << "\n";
+        return 1;
+    }
+    if (csvWriter && (!csvWriter->flush() || csvFailed)) {
+        return 1;
+    }
+
+    std::cerr << matches << " of " << reader.rowCount() << " pages matched ("
+              << reader.rowGroupCount() << " row groups)\n";
+    return 0;
+}
@@ -0,0 +1,203 @@
+#include "retry_policy.hpp"
+
+#include <algorithm>
+#include <random>
+#include <cmath>
+#include <ctime>
+
+using namespace std::chrono_literals;
+
+// Consecutive failures that open a host's circuit breaker.
+static constexpr uint32_t kBreakerThreshold {5};
+// Cooldown after the first trip; doubles with every further trip.
+static constexpr std::chrono::seconds kBreakerCooldown {30s};
+static constexpr std::chrono::seconds kMaxBreakerCooldown {10min};
+// Trips after which a host is considered down for the rest of the crawl.
+static constexpr uint32_t kMaxBreakerTrips {4};
+// How long other requests wait while a half-open host's probe is running.
+static constexpr std::chrono::seconds kProbeWait {1s};
+
+// Exponential backoff: first retry waits up to kBackoffBase, then doubling.
+static constexpr std::chrono::milliseconds kBackoffBase {1s};
+static constexpr std::chrono::milliseconds kMinBackoff {250ms};
+static constexpr std::chrono::milliseconds kMaxBackoff {5min};
+// Retry-After values beyond this are cut short; the retry will find out.
+static constexpr std::chrono::seconds kMaxRetryAfter {10min};
+
+// Timeouts used until a host has enough latency samples (the old fixed values).
+static constexpr std::chrono::milliseconds kDefaultTimeout {20s};
+static constexpr std::chrono::milliseconds kDefaultConnectTimeout {10s};
+static constexpr uint32_t kMinLatencySamples {20};
+// Transfer timeout = this multiple of the host's p99 latency, within bounds.
+static constexpr double kTimeoutP99Multiple {4.0};
+static constexpr std::chrono::milliseconds kMinTimeout {2s};
+static constexpr std::chrono::milliseconds kMaxRetryTimeout {60s};
+static constexpr std::chrono::milliseconds kMinConnectTimeout {1s};
+// Latency histogram: bucket i holds samples up to kFirstBucketMs * kBucketGrowth^i.
+static constexpr double kFirstBucketMs {50.0};
+static constexpr double kBucketGrowth {1.5};
+
+FailureClass classifyFailure(bool transferOk, CURLcode code, long status) {
+    if (!transferOk) {
+        switch (code) {
+            case CURLE_OPERATION_TIMEDOUT:
+            case CURLE_COULDNT_CONNECT:
+            case CURLE_SEND_ERROR:
+            case CURLE_RECV_ERROR:
+            case CURLE_GOT_NOTHING:
+            case CURLE_PARTIAL_FILE:
+            case CURLE_SSL_CONNECT_ERROR:
+            case CURLE_HTTP2:
+            case CURLE_HTTP2_STREAM:
+                return FailureClass::Retryable;
+            // Hosts are resolved ahead of the fetch, and a host that did not
+            // resolve is not retried there either
+            case CURLE_COULDNT_RESOLVE_HOST:
+            default:
+                return FailureClass::Permanent;
+        }
+    }
+
+    switch (status) {
+        case 408:  // Request Timeout
+        case 429:  // Too Many Requests
+        case 500:
+        case 502:
+        case 503:
+        case 504:
+            return FailureClass::Retryable;
+        default:
+            return FailureClass::None;
+    }
+}
+
+std::optional<std::chrono::seconds> parseRetryAfter(std::string_view value) {
+    if (value.empty()) return std::nullopt;
+
+    if (std::all_of(value.begin(), value.end(), [](char c) { return c >= '0' && c <= '9'; })) {
+        if (value.size() > 9) return kMaxRetryAfter;
+        return std::chrono::seconds(std::stol(std::string(value)));
+    }
+
+    const std::time_t date {curl_getdate(std::string(value).c_str(), nullptr)};
+    if (date < 0) return std::nullopt;
+    const std::time_t now {std::time(nullptr)};
+    return std::chrono::seconds(date > now ? date - now : 0);
+}
+
+static std::mt19937_64& randomEngine() {
+    thread_local std::mt19937_64 engine {std::random_device {}()};
+    return engine;
+}
+
+std::chrono::milliseconds retryDelay(unsigned attempt, std::optional<std::chrono::seconds> retryAfter) {
+    if (retryAfter) {
+        // Honour the server, plus up to 10% so retries for one host do not arrive together
+        const auto base {std::chrono::duration_cast<std::chrono::milliseconds>(std::min(*retryAfter, kMaxRetryAfter))};
+        std::uniform_int_distribution<long long> jitter(0, base.count() / 10);
+        return std::max(kMinBackoff, base + std::chrono::milliseconds(jitter(randomEngine())));
+    }
+
+    // Full jitter: uniform in [0, base * 2^(attempt-1)]
+    const unsigned exponent {std::min(attempt > 0 ? attempt - 1 : 0u, 16u)};
+    const auto cap {std::min(kMaxBackoff, std::chrono::milliseconds(kBackoffBase.count() << exponent))};
+    std::uniform_int_distribution<long long> jitter(0, cap.count());
+    return std::max(kMinBackoff, std::chrono::milliseconds(jitter(randomEngine())));
+}
+
+bool HostHealth::allowRequest(const std::string& host, std::chrono::steady_clock::time_point& retryAt,
+                              std::chrono::steady_clock::time_point now) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto it {m_hosts.find(host)};
+    if (it == m_hosts.end()) return true;
+
+    Host& state {it->second};
+    switch (state.breaker) {
+        case Breaker::Closed:
+            return true;
+        case Breaker::Open:
+            if (state.trips > kMaxBreakerTrips) {
+                retryAt = std::chrono::steady_clock::time_point::max();
+                return false;
+            }
+            if (now < state.openUntil) {
+                retryAt = state.openUntil;
+                return false;
+            }
+            state.breaker = Breaker::HalfOpen;  // This request is the probe
+            return true;
+        case Breaker::HalfOpen:
+            retryAt = now + kProbeWait;  // Wait for the probe's result
+            return false;
+    }
+    return true;
+}
+
+void HostHealth::addLatency(Host& host, std::chrono::milliseconds latency) {
+    const double ms {std::max(1.0, static_cast<double>(latency.count()))};
+    size_t bucket {0};
+    if (ms > kFirstBucketMs) {
+        bucket = static_cast<size_t>(std::ceil(std::log(ms / kFirstBucketMs) / std::log(kBucketGrowth)));
+    }
+    host.latency[std::min(bucket, kLatencyBuckets - 1)]++;
+    host.samples++;
+}
+
+void HostHealth::recordSuccess(const std::string& host, std::chrono::milliseconds latency) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    Host& state {m_hosts[host]};
+    addLatency(state, latency);
+    state.consecutiveFailures = 0;
+    state.trips = 0;
+    state.breaker = Breaker::Closed;
+}
+
+void HostHealth::recordFailure(const std::string& host, bool timedOut, std::chrono::milliseconds timeout, bool retry,
+                               std::chrono::steady_clock::time_point now) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    Host& state {m_hosts[host]};
+    if (timedOut) addLatency(state, timeout);
+    if (retry && state.breaker != Breaker::HalfOpen) return;
+    state.consecutiveFailures++;
+
+    // A failed probe reopens at once; otherwise wait for a run of failures
+    if (state.breaker == Breaker::HalfOpen || (state.breaker == Breaker::Closed &&
+                                               state.consecutiveFailures >= kBreakerThreshold)) {
+        const auto cooldown {std::min<std::chrono::seconds>(kMaxBreakerCooldown,
+                                                            std::chrono::seconds(kBreakerCooldown.count() << std::min(state.trips, 16u)))};
+        state.trips++;
+        state.breaker = Breaker::Open;
+        state.openUntil = now + cooldown;
+    }
+}
+
+FetchOptions HostHealth::timeoutsFor(const std::string& host, unsigned attempt) const {
+    FetchOptions options;
+    options.timeout = kDefaultTimeout;
+    options.connectTimeout = kDefaultConnectTimeout;
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto it {m_hosts.find(host)};
+        if (it != m_hosts.end() && it->second.samples >= kMinLatencySamples) {
+            const Host& state {it->second};
+            const uint32_t target {state.samples - state.samples / 100};  // 99th percentile
+            uint32_t seen {0};
+            size_t bucket {0};
+            for (; bucket < kLatencyBuckets; ++bucket) {
+                seen += state.latency[bucket];
+                if (seen >= target) break;
+            }
+            const double p99Ms {kFirstBucketMs * std::pow(kBucketGrowth, static_cast<double>(bucket))};
+            options.timeout = std::clamp(std::chrono::milliseconds(static_cast<long long>(p99Ms * kTimeoutP99Multiple)),
+                                         kMinTimeout, kDefaultTimeout);
+            options.connectTimeout = std::clamp(options.timeout / 2, kMinConnectTimeout, kDefaultConnectTimeout);
+        }
+    }
+
+    // Each retry doubles the time allowed, in case the timeout itself was the problem
+    for (unsigned i = 0; i < attempt && options.timeout < kMaxRetryTimeout; ++i) {
+        options.timeout = std::min(kMaxRetryTimeout, options.timeout * 2);
+    }
+    return options;
+}
@@ -0,0 +1,60 @@
+#include "seed_loader.hpp"
+
+#include <algorithm>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+static std::string_view trimLine(std::string_view s) {
+    while (!s.empty() && (s.front() == ' ' || s.front() == '\t')) s.remove_prefix(1);
+    while (!s.empty() && (s.back() == ' ' || s.back() == '\t' || s.back() == '\r')) s.remove_suffix(1);
+    return s;
+}
+
+static void scanChunk(std::string_view chunk, size_t index,
+                      const std::function<void(size_t, std::string_view)>& visit) {
+    while (!chunk.empty()) {
+        size_t newline {chunk.find('\n')};
+        std::string_view line {chunk.substr(0, newline)};
+        chunk.remove_prefix(newline == std::string_view::npos ? chunk.size() : newline + 1);
+
+        line = trimLine(line);
+        if (line.empty() || line.front() == '#') continue;
+        visit(index, line);
+    }
+}
+
+size_t forEachSeedLine(std::string_view data, size_t numChunks,
+                       const std::function<void(size_t, std::string_view)>& visit) {
+    if (data.empty()) return 0;
+    if (numChunks == 0) numChunks = 1;
+
+    // Cut at the first newline after each even split point so no line is shared.
+    std::vector<std::string_view> chunks;
+    size_t begin {0};
+    for (size_t i = 1; i <= numChunks && begin < data.size(); ++i) {
+        size_t end {data.size()};
+        if (i < numChunks) {
+            size_t target {std::max(begin, data.size() * i / numChunks)};
+            size_t newline {data.find('\n', target)};
+            end = newline == std::string_view::npos ? data.size() : newline + 1;
+        }
+        chunks.push_back(data.substr(begin, end - begin));
+        begin = end;
+    }
+
+    if (chunks.size() == 1) {
+        scanChunk(chunks[0], 0, visit);
+        return 1;
+    }
+
+    std::vector<std::thread> threads;
+    threads.reserve(chunks.size());
+    for (size_t i = 0; i < chunks.size(); ++i) {
+        threads.emplace_back(scanChunk, chunks[i], i, std::cref(visit));
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    return chunks.size();
+}
@@ -0,0 +1,374 @@
+#include "sitemap.hpp"
+#include "http_client.hpp"
+
+#include <iostream>
+#include <queue>
+#include <unordered_set>
+#include <cstdio>
+#include <cstring>
+#include <strings.h>
+
+// The sitemap protocol caps a file at 50MB uncompressed; allow some slack.
+static constexpr size_t kMaxXmlBytes {64u * 1024u * 1024u};
+// Longest <loc>/<lastmod> value we keep; the protocol limits URLs to 2048 characters.
+static constexpr size_t kMaxTextLength {8192};
+// Tags longer than this are attribute-heavy headers we do not need to read in full.
+static constexpr size_t kMaxTagLength {256};
+static constexpr size_t kInflateChunk {16384};
+
+// Tokenizer sub-states inside a tag, encoded in m_tag's first bytes.
+static const char* const kCommentOpen {"!--"};
+static const char* const kCDataOpen {"![CDATA["};
+
+SitemapParser::SitemapParser(EntryCallback onUrl, EntryCallback onSitemap)
+    : m_onUrl(std::move(onUrl)), m_onSitemap(std::move(onSitemap)) {
+}
+
+SitemapParser::~SitemapParser() {
+    if (m_inflateReady) inflateEnd(&m_zstream);
+}
+
+bool SitemapParser::feed(const char* data, size_t size) {
+    if (size == 0) return true;
+
+    if (!m_sniffed) {
+        // 0x1f is the first byte of the gzip magic and can never start an XML document.
+        m_sniffed = true;
+        m_gzip = static_cast<unsigned char>(data[0]) == 0x1f;
+        if (m_gzip) {
+            // 16 + MAX_WBITS asks zlib for gzip framing.
+            if (inflateInit2(&m_zstream, 16 + MAX_WBITS) != Z_OK) return false;
+            m_inflateReady = true;
+        }
+    }
+
+    if (!m_gzip) {
+        m_xmlBytes += size;
+        if (m_xmlBytes > kMaxXmlBytes) return false;
+        feedXml(data, size);
+        return true;
+    }
+
+    char out[kInflateChunk];
+    m_zstream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(data));
+    m_zstream.avail_in = static_cast<uInt>(size);
+    // Loop until the input is used up and zlib has nothing left to hand out: a
+    // full output buffer can leave decompressed bytes behind even without input.
+    do {
+        m_zstream.next_out = reinterpret_cast<Bytef*>(out);
+        m_zstream.avail_out = sizeof(out);
+
+        int rc {inflate(&m_zstream, Z_NO_FLUSH)};
+        if (rc != Z_OK && rc != Z_STREAM_END && rc != Z_BUF_ERROR) return false;
+
+        const size_t produced {sizeof(out) - m_zstream.avail_out};
+        m_xmlBytes += produced;
+        if (m_xmlBytes > kMaxXmlBytes) return false;
+        feedXml(out, produced);
+
+        if (rc == Z_STREAM_END) {
+            // All output of this member is out. Concatenated gzip members are
+            // valid; start on the next one.
+            if (m_zstream.avail_in == 0) break;
+            if (inflateReset(&m_zstream) != Z_OK) return false;
+        } else if (rc == Z_BUF_ERROR) {
+            // No progress possible until more input arrives
+            break;
+        }
+    } while (m_zstream.avail_in > 0 || m_zstream.avail_out == 0);
+    return true;
+}
+
+// Appends a character to the current field, decoding XML entities.
+void SitemapParser::appendText(char c) {
+    if (m_inEntity) {
+        if (c != ';') {
+            if (m_entity.size() < 10) m_entity += c;
+            return;
+        }
+        m_inEntity = false;
+
+        std::string decoded;
+        if (m_entity == "amp") decoded = "&";
+        else if (m_entity == "lt") decoded = "<";
+        else if (m_entity == "gt") decoded = ">";
+        else if (m_entity == "quot") decoded = "\"";
+        else if (m_entity == "apos") decoded = "'";
+        else if (m_entity.size() > 1 && m_entity[0] == '#') {
+            const bool hex {m_entity[1] == 'x' || m_entity[1] == 'X'};
+            unsigned long code {std::strtoul(m_entity.c_str() + (hex ? 2 : 1), nullptr, hex ? 16 : 10)};
+            // Encode the code point as UTF-8.
+            if (code < 0x80) {
+                decoded += static_cast<char>(code);
+            } else if (code < 0x800) {
+                decoded += static_cast<char>(0xC0 | (code >> 6));
+                decoded += static_cast<char>(0x80 | (code & 0x3F));
+            } else if (code < 0x10000) {
+                decoded += static_cast<char>(0xE0 | (code >> 12));
+                decoded += static_cast<char>(0x80 | ((code >> 6) & 0x3F));
+                decoded += static_cast<char>(0x80 | (code & 0x3F));
+            } else if (code < 0x110000) {
+                decoded += static_cast<char>(0xF0 | (code >> 18));
+                decoded += static_cast<char>(0x80 | ((code >> 12) & 0x3F));
+                decoded += static_cast<char>(0x80 | ((code >> 6) & 0x3F));
+                decoded += static_cast<char>(0x80 | (code & 0x3F));
+            }
+        } else {
+            decoded = "&" + m_entity + ";";
+        }
+        if (m_text.size() + decoded.size() <= kMaxTextLength) m_text += decoded;
+        return;
+    }
+
+    if (c == '&') {
+        m_inEntity = true;
+        m_entity.clear();
+        return;
+    }
+    if (m_text.size() < kMaxTextLength) m_text += c;
+}
+
+static std::string trimmed(const std::string& s) {
+    size_t begin {s.find_first_not_of(" \t\r\n")};
+    if (begin == std::string::npos) return "";
+    size_t end {s.find_last_not_of(" \t\r\n")};
+    return s.substr(begin, end - begin + 1);
+}
+
+void SitemapParser::handleTag() {
+    // Declarations, processing instructions and self-closing tags carry nothing we need.
+    if (m_tag.empty() || m_tag[0] == '?' || m_tag[0] == '!' || m_tag.back() == '/') return;
+
+    const bool closing {m_tag[0] == '/'};
+    size_t begin {closing ? 1u : 0u};
+    size_t end {m_tag.find_first_of(" \t\r\n/", begin)};
+    if (end == std::string::npos) end = m_tag.size();
+
+    // Ignore namespace prefixes such as <sm:loc>.
+    size_t colon {m_tag.find(':', begin)};
+    if (colon != std::string::npos && colon < end) begin = colon + 1;
+    std::string_view name {std::string_view(m_tag).substr(begin, end - begin)};
+
+    if (!closing) {
+        if (name == "url" || name == "sitemap") {
+            m_current = SitemapEntry {};
+        } else if (name == "loc") {
+            m_field = Field::Loc;
+            m_text.clear();
+        } else if (name == "lastmod") {
+            m_field = Field::LastMod;
+            m_text.clear();
+        }
+        return;
+    }
+
+    if (name == "loc" && m_field == Field::Loc) {
+        m_current.loc = trimmed(m_text);
+        m_field = Field::None;
+    } else if (name == "lastmod" && m_field == Field::LastMod) {
+        m_current.lastModified = parseW3cDatetime(trimmed(m_text));
+        m_field = Field::None;
+    } else if (name == "url") {
+        if (!m_current.loc.empty() && m_onUrl) m_onUrl(std::move(m_current));
+        m_current = SitemapEntry {};
+    } else if (name == "sitemap") {
+        if (!m_current.loc.empty() && m_onSitemap) m_onSitemap(std::move(m_current));
+        m_current = SitemapEntry {};
+    }
+}
+
+void SitemapParser::feedXml(const char* data, size_t size) {
+    for (size_t i = 0; i < size; ++i) {
+        const char c {data[i]};
+
+        if (!m_inTag) {
+            if (c == '<') {
+                m_inTag = true;
+                m_tag.clear();
+            } else if (m_field != Field::None) {
+                appendText(c);
+            }
+            continue;
+        }
+
+        // Inside a comment: wait for "-->".
+        if (m_tag.starts_with(kCommentOpen)) {
+            if (c == '>' && m_tag.size() >= 5 && m_tag.ends_with("--")) {
+                m_inTag = false;
+            } else {
+                // Only the last two characters matter for finding the end.
+                if (m_tag.size() >= 5) m_tag.erase(3, m_tag.size() - 4);
+                m_tag += c;
+            }
+            continue;
+        }
+
+        // Inside CDATA: everything up to "]]>" is literal text.
+        if (m_tag.starts_with(kCDataOpen)) {
+            const size_t openLength {std::strlen(kCDataOpen)};
+            if (c == '>' && m_tag.size() >= openLength + 2 && m_tag.ends_with("]]")) {
+                m_inTag = false;
+                continue;
+            }
+            m_tag += c;
+            // Hold back up to two ']' that could start the terminator.
+            while (m_tag.size() > openLength + 2 ||
+                   (m_tag.size() > openLength && m_tag.back() != ']')) {
+                const char literal {m_tag[openLength]};
+                m_tag.erase(openLength, 1);
+                if (m_field != Field::None && m_text.size() < kMaxTextLength) m_text += literal;
+                if (m_tag.size() <= openLength) break;
+            }
+            continue;
+        }
+
+        if (c == '>') {
+            m_inTag = false;
+            handleTag();
+        } else if (m_tag.size() < kMaxTagLength) {
+            m_tag += c;
+        }
+    }
+}
+
+// Reads exactly n digits starting at pos.
+static bool readDigits(const std::string& text, size_t& pos, size_t n, int& out) {
+    if (pos + n > text.size()) return false;
+    out = 0;
+    for (size_t i = 0; i < n; ++i) {
+        const char c {text[pos + i]};
+        if (c < '0' || c > '9') return false;
+        out = out * 10 + (c - '0');
+    }
+    pos += n;
+    return true;
+}
+
+std::time_t parseW3cDatetime(const std::string& text) {
+    std::tm tm {};
+    size_t pos {0};
+    int year {0};
+    int month {1};
+    int day {1};
+    if (!readDigits(text, pos, 4, year)) return 0;
+    if (pos < text.size() && text[pos] == '-') {
+        ++pos;
+        if (!readDigits(text, pos, 2, month)) return 0;
+        if (pos < text.size() && text[pos] == '-') {
+            ++pos;
+            if (!readDigits(text, pos, 2, day)) return 0;
+        }
+    }
+    tm.tm_year = year - 1900;
+    tm.tm_mon = month - 1;
+    tm.tm_mday = day;
+
+    long offsetSeconds {0};
+    if (pos < text.size() && text[pos] == 'T') {
+        ++pos;
+        if (!readDigits(text, pos, 2, tm.tm_hour)) return 0;
+        if (pos >= text.size() || text[pos++] != ':') return 0;
+        if (!readDigits(text, pos, 2, tm.tm_min)) return 0;
+        if (pos < text.size() && text[pos] == ':') {
+            ++pos;
+            if (!readDigits(text, pos, 2, tm.tm_sec)) return 0;
+            // Fractional seconds
+            if (pos < text.size() && text[pos] == '.') {
+                ++pos;
+                while (pos < text.size() && text[pos] >= '0' && text[pos] <= '9') ++pos;
+            }
+        }
+        if (pos < text.size() && (text[pos] == '+' || text[pos] == '-')) {
+            const int sign {text[pos] == '-' ? -1 : 1};
+            ++pos;
+            int hours {0};
+            int minutes {0};
+            if (!readDigits(text, pos, 2, hours)) return 0;
+            if (pos < text.size() && text[pos] == ':') ++pos;
+            if (!readDigits(text, pos, 2, minutes)) return 0;
+            offsetSeconds = sign * (hours * 3600L + minutes * 60L);
+        }
+    }
+
+    std::time_t utc {timegm(&tm)};
+    if (utc == static_cast<std::time_t>(-1)) return 0;
+    return utc - offsetSeconds;
+}
+
+std::vector<std::string> parseRobotsSitemaps(const std::string& robotsBody) {
+    std::vector<std::string> sitemaps;
+    size_t pos {0};
+    while (pos < robotsBody.size()) {
+        size_t newline {robotsBody.find('\n', pos)};
+        if (newline == std::string::npos) newline = robotsBody.size();
+        std::string line {trimmed(robotsBody.substr(pos, newline - pos))};
+        pos = newline + 1;
+
+        if (line.size() > 8 && strncasecmp(line.c_str(), "sitemap:", 8) == 0) {
+            std::string url {trimmed(line.substr(8))};
+            if (!url.empty()) sitemaps.push_back(std::move(url));
+        }
+    }
+    return sitemaps;
+}
+
+size_t ingestSitemaps(const std::string& siteUrl,
+                      const std::function<bool(std::vector<SitemapEntry>& batch)>& onBatch,
+                      const SitemapLimits& limits) {
+    std::queue<std::string> pending;
+    std::unordered_set<std::string> seen;
+
+    HttpResult robots;
+    std::string error;
+    if (getRobots(siteUrl, robots, error)) {
+        for (auto& url : parseRobotsSitemaps(robots.body.str())) {
+            if (seen.insert(url).second) pending.push(std::move(url));
+        }
+    }
+    if (pending.empty()) {
+        auto fallback {buildHostUrl(siteUrl, "/sitemap.xml")};
+        if (!fallback) return 0;
+        seen.insert(*fallback);
+        pending.push(*fallback);
+    }
+
+    size_t found {0};
+    size_t fetched {0};
+    bool stopped {false};
+    std::vector<SitemapEntry> batch;
+    batch.reserve(limits.batchSize);
+
+    auto flush = [&] {
+        if (batch.empty() || stopped) return;
+        found += batch.size();
+        if (!onBatch(batch)) stopped = true;
+        batch.clear();
+    };
+
+    while (!pending.empty() && !stopped && fetched < limits.maxSitemaps) {
+        std::string sitemapUrl {std::move(pending.front())};
+        pending.pop();
+        fetched++;
+
+        SitemapParser parser(
+            [&](SitemapEntry&& entry) {
+                batch.push_back(std::move(entry));
+                if (batch.size() >= limits.batchSize) flush();
+            },
+            [&](SitemapEntry&& entry) {
+                if (seen.insert(entry.loc).second) pending.push(std::move(entry.loc));
+            });
+
+        long status {0};
+        bool ok {streamHttp(sitemapUrl, [&](const char* data, size_t size) {
+            return !stopped && parser.feed(data, size);
+        }, status, error)};
+        if (!ok && !stopped) {
+            std::cerr << "Sitemap " << sitemapUrl << " failed: " << error << "\n";
+        }
+        // Keep whatever was parsed before a failure.
+        flush();
+    }
+
+    return found;
+}
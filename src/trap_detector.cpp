@@ -0,0 +1,270 @@
+#include "trap_detector.hpp"
+#include "fnv1a.hpp"
+
+#include <iostream>
+#include <vector>
+#include <algorithm>
+#include <iomanip>
+#include <sstream>
+
+// URLs deeper than this are never fetched.
+static constexpr size_t kMaxPathDepth {24};
+// URLs or query strings beyond these sizes are generated, not written by people.
+static constexpr size_t kMaxUrlLength {2048};
+static constexpr size_t kMaxQueryParams {16};
+// A path segment occurring this often means a relative-link loop.
+static constexpr size_t kMaxSegmentRepeats {3};
+// Longest block of segments checked for immediate repetition (/a/b/a/b).
+static constexpr size_t kMaxRepeatBlock {4};
+
+// Throttled URLs: one in this many is still enqueued, to keep measuring.
+static constexpr uint32_t kThrottleKeepEvery {8};
+// Pages of a template fetched before its yield is judged.
+static constexpr uint32_t kMinTrapSamples {50};
+// ... and before a template that never yields anything else is dropped.
+static constexpr uint32_t kDropAfterFetches {200};
+// A template is a trap when its pages yield fewer new links than this outside
+// the template, and keep linking to a few more of themselves (next day, next
+// page). Pages fanning out into many of their own kind are a catalog instead.
+static constexpr double kMinOtherYield {0.05};
+static constexpr double kMaxChainYield {2.0};
+// Accepted URLs on a host before its depth distribution is trusted.
+static constexpr uint32_t kMinDepthSamples {200};
+// Depth beyond the host's 95th percentile that is still normal.
+static constexpr size_t kDepthSlack {3};
+// Templates tracked per host. A full table forgets the templates without a
+// verdict; if most of them have one, new templates are not judged.
+static constexpr size_t kMaxTemplatesPerHost {4096};
+
+static const char* verdictName(TrapVerdict verdict) {
+    switch (verdict) {
+        case TrapVerdict::Accept: return "accept";
+        case TrapVerdict::Throttle: return "throttle";
+        case TrapVerdict::Drop: return "drop";
+    }
+    return "";
+}
+
+// Never 0, which marks an unclassified URL.
+static uint64_t hashTemplate(std::string_view text) {
+    const uint64_t hash {fnv1a64(text)};
+    return hash == 0 ? 1 : hash;
+}
+
+// Splits a URL into path segments and query parameter names.
+static void splitPathAndQuery(std::string_view url, std::vector<std::string_view>& segments,
+                              std::vector<std::string_view>& params) {
+    url = url.substr(0, url.find('#'));
+    const size_t scheme {url.find("://")};
+    size_t pathStart {url.find_first_of("/?", scheme == std::string_view::npos ? 0 : scheme + 3)};
+    if (pathStart == std::string_view::npos) pathStart = url.size();
+    size_t queryStart {url.find('?', pathStart)};
+    if (queryStart == std::string_view::npos) queryStart = url.size();
+
+    std::string_view path {url.substr(pathStart, queryStart - pathStart)};
+    while (!path.empty()) {
+        size_t slash {path.find('/')};
+        std::string_view segment {path.substr(0, slash)};
+        if (!segment.empty()) segments.push_back(segment);
+        if (slash == std::string_view::npos) break;
+        path.remove_prefix(slash + 1);
+    }
+
+    std::string_view query {queryStart < url.size() ? url.substr(queryStart + 1) : std::string_view()};
+    while (!query.empty()) {
+        size_t amp {query.find('&')};
+        std::string_view param {query.substr(0, amp)};
+        if (!param.empty()) params.push_back(param.substr(0, param.find('=')));
+        if (amp == std::string_view::npos) break;
+        query.remove_prefix(amp + 1);
+    }
+}
+
+// "/cal/2024/05?view=day&date=..." -> "/cal/N/N?date&view"
+static std::string buildTemplate(const std::vector<std::string_view>& segments,
+                                 std::vector<std::string_view>& params) {
+    std::string out;
+    for (std::string_view segment : segments) {
+        out += '/';
+        bool inDigits {false};
+        for (char c : segment) {
+            const bool digit {c >= '0' && c <= '9'};
+            if (!digit) {
+                out += c;
+            } else if (!inDigits) {
+                out += 'N';
+            }
+            inDigits = digit;
+        }
+    }
+    std::sort(params.begin(), params.end());
+    for (size_t i = 0; i < params.size(); ++i) {
+        out += i == 0 ? '?' : '&';
+        out += params[i];
+    }
+    return out;
+}
+
+static bool hasRepeatingSegments(const std::vector<std::string_view>& segments) {
+    for (size_t i = 0; i < segments.size(); ++i) {
+        if (static_cast<size_t>(std::count(segments.begin(), segments.end(), segments[i])) >= kMaxSegmentRepeats) {
+            return true;
+        }
+    }
+    for (size_t block = 2; block <= kMaxRepeatBlock; ++block) {
+        for (size_t i = 0; i + 2 * block <= segments.size(); ++i) {
+            if (std::equal(segments.begin() + i, segments.begin() + i + block, segments.begin() + i + block)) {
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+UrlShape TrapDetector::classify(std::string_view url) {
+    std::vector<std::string_view> segments;
+    std::vector<std::string_view> params;
+    splitPathAndQuery(url, segments, params);
+
+    UrlShape shape;
+    shape.depth = static_cast<uint16_t>(std::min<size_t>(segments.size(), UINT16_MAX));
+    shape.repeating = hasRepeatingSegments(segments);
+    shape.oversized = url.size() > kMaxUrlLength || params.size() > kMaxQueryParams;
+    shape.pattern = hashTemplate(buildTemplate(segments, params));
+    return shape;
+}
+
+bool TrapDetector::openLog(const std::string& path) {
+    m_log.open(path, std::ios::out | std::ios::trunc);
+    if (!m_log.is_open()) {
+        std::cerr << "Error: could not open trap log for writing: " << path << "\n";
+        return false;
+    }
+    return true;
+}
+
+void TrapDetector::logDecision(TrapVerdict verdict, const char* reason, const std::string& url) {
+    if (verdict == TrapVerdict::Drop) {
+        m_dropped++;
+    } else if (verdict == TrapVerdict::Throttle) {
+        m_throttled++;
+    }
+    if (m_log.is_open()) {
+        m_log << verdictName(verdict) << '\t' << reason << '\t' << url << '\n';
+    }
+}
+
+size_t TrapDetector::depthCutoff(const HostStats& host) const {
+    if (host.accepted < kMinDepthSamples) return 0;
+    const uint32_t target {host.accepted - host.accepted / 20};  // 95th percentile
+    uint32_t seen {0};
+    for (size_t depth = 0; depth < kDepthBuckets; ++depth) {
+        seen += host.depths[depth];
+        if (seen >= target) return depth + kDepthSlack;
+    }
+    return 0;
+}
+
+// The host's stats, created if needed. Before a new host is added to a full
+// table, hosts not seen since the previous pass are forgotten; the next pass
+// runs once the table has doubled again, so passes cost O(1) per new host.
+TrapDetector::HostStats& TrapDetector::hostStats(const std::string& host) {
+    if (m_hosts.size() >= m_evictAt && !m_hosts.contains(host)) {
+        std::erase_if(m_hosts, [this](const auto& item) { return item.second.generation != m_generation; });
+        m_generation++;
+        m_evictAt = std::max(kMaxHosts, m_hosts.size() * 2);
+    }
+    HostStats& stats {m_hosts[host]};
+    stats.generation = m_generation;
+    return stats;
+}
+
+// The template's stats, created if the host's table has room; null otherwise.
+TrapDetector::TemplateStats* TrapDetector::templateStats(HostStats& host, uint64_t pattern) {
+    auto it {host.templates.find(pattern)};
+    if (it != host.templates.end()) return &it->second;
+
+    if (host.templates.size() >= kMaxTemplatesPerHost && !host.templatesFull) {
+        std::erase_if(host.templates, [](const auto& item) { return item.second.state == TrapVerdict::Accept; });
+        host.templatesFull = host.templates.size() >= kMaxTemplatesPerHost / 2;
+    }
+    if (host.templates.size() >= kMaxTemplatesPerHost) return nullptr;
+    return &host.templates[pattern];
+}
+
+bool TrapDetector::admit(const std::string& host, const std::string& url, const UrlShape& shape) {
+    if (shape.pattern == 0) return true;  // Not classified (seeds)
+
+    if (shape.repeating) {
+        logDecision(TrapVerdict::Drop, "repeating-segments", url);
+        return false;
+    }
+    if (shape.oversized) {
+        logDecision(TrapVerdict::Drop, "oversized-url", url);
+        return false;
+    }
+    if (shape.depth > kMaxPathDepth) {
+        logDecision(TrapVerdict::Drop, "too-deep", url);
+        return false;
+    }
+
+    HostStats& stats {hostStats(host)};
+    TemplateStats* pattern {templateStats(stats, shape.pattern)};
+
+    if (pattern && pattern->state == TrapVerdict::Drop) {
+        logDecision(TrapVerdict::Drop, "trap-template", url);
+        return false;
+    }
+    if (pattern && pattern->state == TrapVerdict::Throttle && pattern->throttleCounter++ % kThrottleKeepEvery != 0) {
+        logDecision(TrapVerdict::Throttle, "trap-template", url);
+        return false;
+    }
+
+    const size_t cutoff {depthCutoff(stats)};
+    if (cutoff > 0 && shape.depth > cutoff && stats.deepCounter++ % kThrottleKeepEvery != 0) {
+        logDecision(TrapVerdict::Throttle, "unusually-deep", url);
+        return false;
+    }
+
+    if (pattern) pattern->enqueued++;
+    stats.depths[std::min<size_t>(shape.depth, kDepthBuckets - 1)]++;
+    stats.accepted++;
+    return true;
+}
+
+void TrapDetector::recordYield(const std::string& host, const std::string& url, const UrlShape& shape,
+                               size_t newLinks, size_t selfLinks) {
+    if (shape.pattern == 0) return;
+
+    TemplateStats* found {templateStats(hostStats(host), shape.pattern)};
+    if (!found) return;
+    TemplateStats& pattern {*found};
+    pattern.fetched++;
+    pattern.newLinks += static_cast<uint32_t>(newLinks);
+    pattern.selfLinks += static_cast<uint32_t>(selfLinks);
+    if (pattern.fetched < kMinTrapSamples) return;
+
+    // Pages that keep producing URLs of their own template and nothing else
+    const double otherYield {static_cast<double>(pattern.newLinks - pattern.selfLinks) / pattern.fetched};
+    const double selfYield {static_cast<double>(pattern.selfLinks) / pattern.fetched};
+    TrapVerdict state {TrapVerdict::Accept};
+    if (pattern.selfLinks > 0 && otherYield < kMinOtherYield && selfYield <= kMaxChainYield) {
+        state = pattern.fetched >= kDropAfterFetches && pattern.newLinks == pattern.selfLinks
+            ? TrapVerdict::Drop : TrapVerdict::Throttle;
+    }
+    if (state == pattern.state) return;
+    pattern.state = state;
+
+    std::vector<std::string_view> segments;
+    std::vector<std::string_view> params;
+    splitPathAndQuery(url, segments, params);
+    const std::string templateText {buildTemplate(segments, params)};
+    std::ostringstream message;
+    message << "Trap detector: " << verdictName(state) << " " << host << templateText
+            << " (" << pattern.fetched << " pages, " << std::fixed << std::setprecision(2)
+            << otherYield << " new links elsewhere per page)\n";
+    std::cout << message.str();
+    if (m_log.is_open()) {
+        m_log << verdictName(state) << "\ttemplate\t" << host << templateText << '\n';
+    }
+}
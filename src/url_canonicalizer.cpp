@@ -0,0 +1,398 @@
+#include "url_canonicalizer.hpp"
+#include "fnv1a.hpp"
+
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <mutex>
+#include <cctype>
+
+// Distinct paths, and distinct values, that must show identical content before
+// a parameter is stripped automatically.
+static constexpr size_t kLearnConfirmations {3};
+// One in this many values of a learned parameter is kept, so its variants are still fetched.
+static constexpr uint64_t kLearnedSampleEvery {16};
+// Bounds on the learned state, so a crawl of endless query variants cannot exhaust memory.
+static constexpr size_t kMaxSamples {200000};
+static constexpr size_t kMaxParamStats {100000};
+static constexpr size_t kMaxAliases {200000};
+// Sample value of a URL that lacks the parameter; cannot occur in a URL.
+static constexpr std::string_view kAbsent {"\x1f"};
+
+// Last path segments that serve the directory itself.
+static constexpr std::string_view kIndexPages[] {
+    "index.html", "index.htm", "index.php", "default.htm", "default.html", "default.aspx"
+};
+
+// An absolute URL split into the parts the rules work on.
+struct UrlParts {
+    std::string origin;   // "scheme://host[:port]", lowercased, default port dropped
+    std::string host;     // Host name only
+    std::string path;
+    std::vector<std::string_view> params;  // Views into the original URL
+};
+
+static std::string toLower(std::string_view text) {
+    std::string out(text);
+    for (char& c : out) c = static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+    return out;
+}
+
+static std::string_view paramName(std::string_view param) {
+    return param.substr(0, param.find('='));
+}
+
+static std::string_view paramValue(std::string_view param) {
+    size_t eq {param.find('=')};
+    return eq == std::string_view::npos ? std::string_view() : param.substr(eq + 1);
+}
+
+// Case-insensitive glob match supporting '*' and '?'.
+static bool globMatch(std::string_view pattern, std::string_view text) {
+    size_t p {0}, t {0};
+    size_t star {std::string_view::npos}, resume {0};
+    while (t < text.size()) {
+        if (p < pattern.size() && (pattern[p] == '?' ||
+            std::tolower(static_cast<unsigned char>(pattern[p])) == std::tolower(static_cast<unsigned char>(text[t])))) {
+            ++p;
+            ++t;
+        } else if (p < pattern.size() && pattern[p] == '*') {
+            star = p++;
+            resume = t;
+        } else if (star != std::string_view::npos) {
+            p = star + 1;
+            t = ++resume;
+        } else {
+            return false;
+        }
+    }
+    while (p < pattern.size() && pattern[p] == '*') ++p;
+    return p == pattern.size();
+}
+
+// Splits an absolute URL. Returns false for anything without "scheme://".
+static bool splitUrl(std::string_view url, UrlParts& parts) {
+    url = url.substr(0, url.find('#'));
+    const size_t schemeEnd {url.find("://")};
+    if (schemeEnd == std::string_view::npos || schemeEnd == 0) return false;
+
+    const size_t authorityStart {schemeEnd + 3};
+    size_t pathStart {url.find_first_of("/?", authorityStart)};
+    if (pathStart == std::string_view::npos) pathStart = url.size();
+    size_t queryStart {url.find('?', pathStart)};
+    if (queryStart == std::string_view::npos) queryStart = url.size();
+
+    const std::string scheme {toLower(url.substr(0, schemeEnd))};
+    std::string authority {toLower(url.substr(authorityStart, pathStart - authorityStart))};
+    if (scheme == "http" && authority.ends_with(":80")) authority.resize(authority.size() - 3);
+    if (scheme == "https" && authority.ends_with(":443")) authority.resize(authority.size() - 4);
+
+    parts.origin = scheme + "://" + authority;
+    const size_t at {authority.rfind('@')};
+    parts.host = at == std::string::npos ? authority : authority.substr(at + 1);
+    if (parts.host.empty()) return false;
+    if (parts.host.front() == '[') {
+        parts.host = parts.host.substr(0, parts.host.find(']') + 1);  // IPv6 literal
+    } else {
+        parts.host = parts.host.substr(0, parts.host.find(':'));
+    }
+    parts.path.assign(url.substr(pathStart, queryStart - pathStart));
+
+    parts.params.clear();
+    std::string_view query {queryStart < url.size() ? url.substr(queryStart + 1) : std::string_view()};
+    while (!query.empty()) {
+        size_t amp {query.find('&')};
+        std::string_view param {query.substr(0, amp)};
+        if (!param.empty()) parts.params.push_back(param);
+        if (amp == std::string_view::npos) break;
+        query.remove_prefix(amp + 1);
+    }
+    return true;
+}
+
+// Learned rules apply to a host and path template: the path with every digit
+// run replaced by '#' ("/item/42/reviews" -> "/item/#/reviews").
+static std::string scopeKey(const UrlParts& parts) {
+    std::string scope {parts.host};
+    scope += '\x1f';
+    for (size_t i = 0; i < parts.path.size(); ++i) {
+        const bool digit {parts.path[i] >= '0' && parts.path[i] <= '9'};
+        if (!digit) {
+            scope += parts.path[i];
+        } else if (i == 0 || parts.path[i - 1] < '0' || parts.path[i - 1] > '9') {
+            scope += '#';
+        }
+    }
+    return scope;
+}
+
+// Adds hash to a set kept as a short vector, up to kLearnConfirmations entries.
+static void addDistinct(std::vector<uint64_t>& set, uint64_t hash) {
+    if (set.size() < kLearnConfirmations && std::find(set.begin(), set.end(), hash) == set.end()) {
+        set.push_back(hash);
+    }
+}
+
+static std::string joinUrl(const UrlParts& parts) {
+    std::string out {parts.origin};
+    out += parts.path;
+    for (size_t i = 0; i < parts.params.size(); ++i) {
+        out += i == 0 ? '?' : '&';
+        out += parts.params[i];
+    }
+    return out;
+}
+
+UrlCanonicalizer::UrlCanonicalizer(CanonicalRules rules)
+    : m_rules(std::move(rules)) {
+}
+
+UrlCanonicalizer::UrlCanonicalizer(UrlCanonicalizer&& other) noexcept
+    : m_rules(std::move(other.m_rules)),
+      m_samples(std::move(other.m_samples)),
+      m_paramStats(std::move(other.m_paramStats)),
+      m_learned(std::move(other.m_learned)),
+      m_aliases(std::move(other.m_aliases)),
+      m_learnedCount(other.m_learnedCount),
+      m_revokedCount(other.m_revokedCount) {
+}
+
+UrlCanonicalizer& UrlCanonicalizer::operator=(UrlCanonicalizer&& other) noexcept {
+    m_rules = std::move(other.m_rules);
+    m_samples = std::move(other.m_samples);
+    m_paramStats = std::move(other.m_paramStats);
+    m_learned = std::move(other.m_learned);
+    m_aliases = std::move(other.m_aliases);
+    m_learnedCount = other.m_learnedCount;
+    m_revokedCount = other.m_revokedCount;
+    return *this;
+}
+
+bool UrlCanonicalizer::loadRules(const std::string& path) {
+    std::ifstream file(path);
+    if (!file.is_open()) {
+        std::cerr << "Error: could not open canonicalization rules: " << path << "\n";
+        return false;
+    }
+
+    std::string line;
+    size_t lineNumber {0};
+    while (std::getline(file, line)) {
+        ++lineNumber;
+        line = line.substr(0, line.find('#'));
+        std::istringstream words(line);
+        std::string directive;
+        if (!(words >> directive)) continue;
+
+        if (directive == "strip") {
+            std::string pattern;
+            if (words >> pattern) {
+                m_rules.stripParameters.push_back(pattern);
+                continue;
+            }
+        } else if (directive == "rewrite") {
+            RewriteRule rule;
+            if (words >> rule.host >> rule.from >> rule.to) {
+                rule.host = toLower(rule.host);
+                m_rules.rewrites.push_back(std::move(rule));
+                continue;
+            }
+        } else if (directive == "keep-order") {
+            m_rules.sortParameters = false;
+            continue;
+        } else if (directive == "keep-index") {
+            m_rules.stripIndexPages = false;
+            continue;
+        } else if (directive == "no-learn") {
+            m_rules.learnParameters = false;
+            continue;
+        }
+        std::cerr << "Error: bad canonicalization rule at " << path << ":" << lineNumber << "\n";
+        return false;
+    }
+    return true;
+}
+
+bool UrlCanonicalizer::isStripped(const std::string& scope, std::string_view name, std::string_view value) const {
+    for (const auto& pattern : m_rules.stripParameters) {
+        if (globMatch(pattern, name)) return true;
+    }
+    // Called with m_mutex held (shared)
+    auto it {m_learned.find(scope)};
+    if (it == m_learned.end() || !it->second.count(std::string(name))) return false;
+    // The sampled values keep the parameter, so their pages are fetched and
+    // compared with the stripped URL's
+    return hashContent(value) % kLearnedSampleEvery != 0;
+}
+
+std::string UrlCanonicalizer::canonicalize(std::string_view url) const {
+    UrlParts parts;
+    if (!splitUrl(url, parts)) {
+        // Not something the rules understand; only drop the fragment
+        return std::string(url.substr(0, url.find('#')));
+    }
+
+    // ";jsessionid=..." session ids embedded in the path
+    size_t session {toLower(parts.path).find(";jsessionid=")};
+    if (session != std::string::npos) parts.path.resize(session);
+
+    for (const auto& rule : m_rules.rewrites) {
+        if ((rule.host == "*" || rule.host == parts.host) && parts.path.starts_with(rule.from)) {
+            parts.path = rule.to + parts.path.substr(rule.from.size());
+            break;
+        }
+    }
+
+    if (m_rules.stripIndexPages) {
+        size_t slash {parts.path.rfind('/')};
+        if (slash != std::string::npos) {
+            const std::string last {toLower(std::string_view(parts.path).substr(slash + 1))};
+            if (std::find(std::begin(kIndexPages), std::end(kIndexPages), last) != std::end(kIndexPages)) {
+                parts.path.resize(slash + 1);
+            }
+        }
+    }
+
+    // "https://example.com/" and "https://example.com/page/" lose the slash
+    if (!parts.path.empty() && parts.path.back() == '/') parts.path.pop_back();
+
+    std::shared_lock<std::shared_mutex> lock(m_mutex);
+    const std::string scope {m_learned.empty() ? std::string() : scopeKey(parts)};
+    std::erase_if(parts.params, [&](std::string_view param) {
+        return isStripped(scope, paramName(param), paramValue(param));
+    });
+    if (m_rules.sortParameters) {
+        std::stable_sort(parts.params.begin(), parts.params.end(), [](std::string_view a, std::string_view b) {
+            return paramName(a) < paramName(b);
+        });
+    }
+
+    std::string canonical {joinUrl(parts)};
+    auto alias {m_aliases.find(canonical)};
+    if (alias != m_aliases.end()) return alias->second;
+    return canonical;
+}
+
+void UrlCanonicalizer::recordEvidence(const std::string& scope, std::string_view name, std::string_view path,
+                                      std::string_view firstValue, std::string_view value, bool sameContent) {
+    // Called with m_mutex held (exclusive)
+    std::string key {scope};
+    key += '\x1f';
+    key += name;
+    auto it {m_paramStats.find(key)};
+    if (it == m_paramStats.end()) {
+        if (m_paramStats.size() >= kMaxParamStats) return;
+        it = m_paramStats.emplace(std::move(key), ParamStats {}).first;
+    }
+    ParamStats& stats {it->second};
+
+    if (!sameContent) {
+        // One counter-example keeps the parameter for the rest of the crawl
+        stats.different++;
+        auto learned {m_learned.find(scope)};
+        if (learned != m_learned.end() && learned->second.erase(std::string(name))) {
+            m_revokedCount++;
+        }
+        return;
+    }
+
+    // Identical error, login or consent pages from one path (or for one value)
+    // must not be enough to strip a parameter that carries content elsewhere
+    addDistinct(stats.paths, hashContent(path));
+    addDistinct(stats.values, hashContent(firstValue));
+    addDistinct(stats.values, hashContent(value));
+    if (stats.different == 0 && stats.paths.size() >= kLearnConfirmations &&
+        stats.values.size() >= kLearnConfirmations) {
+        if (m_learned[scope].insert(std::string(name)).second) {
+            m_learnedCount++;
+        }
+    }
+}
+
+void UrlCanonicalizer::observeContent(const std::string& url, std::string_view content) {
+    if (!m_rules.learnParameters) return;
+
+    UrlParts parts;
+    if (!splitUrl(url, parts)) return;
+    std::sort(parts.params.begin(), parts.params.end());
+    const std::string scope {scopeKey(parts)};
+
+    // Learned parameters the URL lacks: its content is what sampled values of
+    // them are compared with
+    std::vector<std::string> absent;
+    {
+        std::shared_lock<std::shared_mutex> lock(m_mutex);
+        auto learned {m_learned.find(scope)};
+        if (learned != m_learned.end()) {
+            for (const auto& name : learned->second) {
+                if (std::none_of(parts.params.begin(), parts.params.end(),
+                                 [&](std::string_view param) { return paramName(param) == name; })) {
+                    absent.push_back(name);
+                }
+            }
+        }
+    }
+    if (parts.params.empty() && absent.empty()) return;
+    const uint64_t contentHash {hashContent(content)};
+
+    std::unique_lock<std::shared_mutex> lock(m_mutex);
+    // Key: the URL without the parameter (skip), plus the parameter's name
+    auto observe = [&](size_t skip, std::string_view name, std::string_view value) {
+        std::string key {parts.host};
+        key += parts.path;
+        for (size_t j = 0; j < parts.params.size(); ++j) {
+            if (j == skip) continue;
+            key += '&';
+            key += parts.params[j];
+        }
+        key += '\x1f';
+        key += name;
+
+        auto it {m_samples.find(key)};
+        if (it == m_samples.end()) {
+            if (m_samples.size() < kMaxSamples) {
+                m_samples.emplace(std::move(key), Sample {std::string(value), contentHash});
+            }
+            return;
+        }
+        if (it->second.value == value) return;  // Same variant fetched again
+        recordEvidence(scope, name, parts.path, it->second.value, value, it->second.hash == contentHash);
+    };
+    for (size_t i = 0; i < parts.params.size(); ++i) {
+        observe(i, paramName(parts.params[i]), paramValue(parts.params[i]));
+    }
+    for (const auto& name : absent) {
+        observe(parts.params.size(), name, kAbsent);
+    }
+}
+
+std::string UrlCanonicalizer::addCanonicalHint(const std::string& url, std::string_view canonicalUrl) {
+    UrlParts page;
+    UrlParts target;
+    const std::string canonical {canonicalize(canonicalUrl)};
+    if (canonical == url || !splitUrl(url, page) || !splitUrl(canonical, target)) return {};
+    // A page may only speak for its own host
+    if (page.host != target.host) return {};
+
+    // One page's markup only speaks for that page, so no rule is learned from it
+    std::unique_lock<std::shared_mutex> lock(m_mutex);
+    if (m_aliases.size() < kMaxAliases) {
+        m_aliases.emplace(url, canonical);
+    }
+    return canonical;
+}
+
+uint64_t UrlCanonicalizer::hashContent(std::string_view content) {
+    return fnv1a64(content);
+}
+
+size_t UrlCanonicalizer::learnedParameters() const {
+    std::shared_lock<std::shared_mutex> lock(m_mutex);
+    return m_learnedCount;
+}
+
+size_t UrlCanonicalizer::revokedParameters() const {
+    std::shared_lock<std::shared_mutex> lock(m_mutex);
+    return m_revokedCount;
+}
@@ -0,0 +1,1781 @@
+#include "crawler.hpp"
+#include "sitemap.hpp"
+#include "timer_wheel.hpp"
+#include "retry_policy.hpp"
+#include "result_file.hpp"
+#include "domain_filter.hpp"
+#include "inverted_index.hpp"
+#include "control_commands.hpp"
+
+#include <iostream>
+#include <algorithm>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <unordered_map>
+#include <unordered_set>
+#include <thread>
+#include <atomic>
+#include <functional>
+#include <fstream>
+#include <sstream>
+#include <filesystem>
+#include <chrono>
+#include <random>
+#include <ctime>
+#include <cmath>
+#include <map>
+#include <cerrno>
+#include <csignal>
+#include <cstring>
+#include <spawn.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <poll.h>
+#include <zlib.h>
+
+extern char** environ;
+
+// Failed checks of the running test.
+static size_t g_failures {0};
+
+#define CHECK(condition)                                                                  \
+    do {                                                                                  \
+        if (!(condition)) {                                                               \
+            std::cerr << __FILE__ << ":" << __LINE__ << ": check failed: " #condition "\n"; \
+            g_failures++;                                                                 \
+        }                                                                                 \
+    } while (false)
+
+// Path of the crawler_bench_site executable, from the command line.
+static std::string g_sitePath;
+
+// A port nothing listens on right now, picked by the kernel.
+static uint16_t freePort() {
+    int fd {::socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0)};
+    sockaddr_in address {};
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    socklen_t length {sizeof(address)};
+    if (fd < 0 || ::bind(fd, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0 ||
+        ::getsockname(fd, reinterpret_cast<sockaddr*>(&address), &length) != 0) {
+        std::cerr << "Failed to pick a port: " << std::strerror(errno) << "\n";
+        std::exit(1);
+    }
+    ::close(fd);
+    return ntohs(address.sin_port);
+}
+
+// A crawler_bench_site process on 127.0.0.1, killed when this goes out of scope.
+class BenchSite {
+public:
+    explicit BenchSite(const std::vector<std::string>& options) : m_port(freePort()) {
+        std::vector<std::string> args {g_sitePath, "--port", std::to_string(m_port)};
+        args.insert(args.end(), options.begin(), options.end());
+        std::vector<char*> argv;
+        for (auto& arg : args) {
+            argv.push_back(arg.data());
+        }
+        argv.push_back(nullptr);
+
+        posix_spawn_file_actions_t actions;
+        posix_spawn_file_actions_init(&actions);
+        posix_spawn_file_actions_addopen(&actions, STDOUT_FILENO, "/dev/null", O_WRONLY, 0);
+        const int rc {posix_spawn(&m_pid, g_sitePath.c_str(), &actions, nullptr, argv.data(), environ)};
+        posix_spawn_file_actions_destroy(&actions);
+        if (rc != 0) {
+            std::cerr << "Failed to start " << g_sitePath << ": " << std::strerror(rc) << "\n";
+            std::exit(1);
+        }
+
+        for (int attempt = 0; attempt < 100; ++attempt) {
+            int fd {::socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0)};
+            sockaddr_in address {};
+            address.sin_family = AF_INET;
+            address.sin_port = htons(m_port);
+            address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+            const bool connected {::connect(fd, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) == 0};
+            ::close(fd);
+            if (connected) return;
+            std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        }
+        std::cerr << "Bench site did not start listening on port " << m_port << "\n";
+        std::exit(1);
+    }
+
+    ~BenchSite() {
+        ::kill(m_pid, SIGTERM);
+        ::waitpid(m_pid, nullptr, 0);
+    }
+
+    BenchSite(const BenchSite&) = delete;
+    BenchSite& operator=(const BenchSite&) = delete;
+
+    uint16_t port() const { return m_port; }
+    // URL of a page, under a host name the test resolver maps to 127.0.0.1.
+    std::string url(const std::string& host, uint64_t page) const {
+        return "http://" + host + ":" + std::to_string(m_port) + "/p/" + std::to_string(page);
+    }
+
+private:
+    uint16_t m_port;
+    pid_t m_pid {-1};
+};
+
+// Every test host resolves to the bench site, so one server plays many hosts.
+static bool resolveToLoopback(const std::string&, std::vector<std::string>& addresses, std::string&) {
+    addresses.push_back("127.0.0.1");
+    return true;
+}
+
+static std::string testHost(size_t index) {
+    std::string host {"h"};
+    host += std::to_string(index);
+    host += ".test";
+    return host;
+}
+
+// Many fetch threads at once, so fetches race for the last budget slots.
+static ConcurrencyLimits wideLimits() {
+    ConcurrencyLimits limits;
+    limits.initialLimit = 64;
+    limits.maxLimit = 64;
+    limits.hostInitialLimit = 16;
+    limits.hostMaxLimit = 16;
+    return limits;
+}
+
+// Crawls the seeds and returns every result, in completion order.
+static std::vector<CrawlResult> crawl(WebCrawler& crawler, const std::vector<std::string>& seeds,
+                                      HostResolver::ResolveFunction resolve = resolveToLoopback) {
+    std::vector<CrawlResult> results;
+    crawler.setResolveFunction(std::move(resolve));
+    crawler.setResultSink([&](const CrawlResult& result) { results.push_back(result); });
+    crawler.addSeeds(seeds);
+    crawler.start();
+    return results;
+}
+
+// Host of a result URL, without the port.
+static std::string resultHost(const std::string& url) {
+    const size_t begin {url.find("://") + 3};
+    return url.substr(begin, url.find_first_of(":/", begin) - begin);
+}
+
+static void checkDistinctAndOk(const std::vector<CrawlResult>& results) {
+    std::unordered_set<std::string> urls;
+    for (const auto& result : results) {
+        CHECK(urls.insert(result.url).second);
+        CHECK(result.error.empty() && result.status == 200);
+    }
+}
+
+// The global page budget is hit exactly, crawl after crawl, however many
+// fetch threads race for its last slots.
+static void testBudgetExact() {
+    BenchSite site({"--pages", "5000", "--links", "20"});
+    for (size_t run = 0; run < 5; ++run) {
+        std::vector<std::string> seeds;
+        for (size_t host = 0; host < 8; ++host) {
+            seeds.push_back(site.url(testHost(host), host * 100));
+        }
+        BudgetLimits budget;
+        budget.maxPages = 400 + run * 37;
+
+        WebCrawler crawler(wideLimits(), budget);
+        const std::vector<CrawlResult> results = crawl(crawler, seeds);
+        CHECK(crawler.pagesCrawled() == budget.maxPages);
+        CHECK(results.size() == budget.maxPages);
+        checkDistinctAndOk(results);
+    }
+}
+
+// Per-host and path-prefix quotas are never exceeded while the global
+// budget is still filled exactly.
+static void testBudgetScoped() {
+    BenchSite site({"--pages", "5000", "--links", "20"});
+    const std::string limitedPrefix {testHost(0) + ":" + std::to_string(site.port()) + "/p/1"};
+    std::vector<std::string> seeds;
+    for (size_t host = 0; host < 16; ++host) {
+        seeds.push_back(site.url(testHost(host), 0));
+    }
+    BudgetLimits budget;
+    budget.maxPages = 300;
+    budget.maxPagesPerHost = 20;
+    budget.maxPagesPerPrefix.emplace_back(limitedPrefix, 4);
+
+    WebCrawler crawler(wideLimits(), budget);
+    const std::vector<CrawlResult> results = crawl(crawler, seeds);
+    CHECK(crawler.pagesCrawled() == budget.maxPages);
+    CHECK(results.size() == budget.maxPages);
+    checkDistinctAndOk(results);
+
+    std::unordered_map<std::string, size_t> perHost;
+    size_t underPrefix {0};
+    for (const auto& result : results) {
+        perHost[resultHost(result.url)]++;
+        if (std::string_view(result.url).substr(7).starts_with(limitedPrefix)) underPrefix++;
+    }
+    for (const auto& [host, pages] : perHost) {
+        if (pages > budget.maxPagesPerHost) {
+            std::cerr << host << ": " << pages << " pages\n";
+        }
+        CHECK(pages <= budget.maxPagesPerHost);
+    }
+    CHECK(underPrefix <= 4);
+}
+
+// A depth quota is exact. With one link per page the site is a chain per host,
+// so page N of a host is at depth N and the expected total is known.
+static void testBudgetDepth() {
+    const size_t chainLength {20};
+    const size_t hosts {32};
+    const size_t depthQuota {5};
+    const size_t limitedDepth {3};
+    BenchSite site({"--pages", std::to_string(chainLength), "--links", "1"});
+    std::vector<std::string> seeds;
+    for (size_t host = 0; host < hosts; ++host) {
+        seeds.push_back(site.url(testHost(host), 0));
+    }
+    BudgetLimits budget;
+    budget.maxPages = 10000;
+    budget.maxPagesPerDepth[limitedDepth] = depthQuota;
+
+    WebCrawler crawler(wideLimits(), budget);
+    const std::vector<CrawlResult> results = crawl(crawler, seeds);
+    checkDistinctAndOk(results);
+
+    size_t atLimitedDepth {0};
+    for (const auto& result : results) {
+        if (result.url.ends_with("/p/" + std::to_string(limitedDepth))) atLimitedDepth++;
+    }
+    CHECK(atLimitedDepth == depthQuota);
+    // Every host up to the limited depth, then only the chains that got through it
+    CHECK(crawler.pagesCrawled() == hosts * limitedDepth + depthQuota * (chainLength - limitedDepth));
+}
+
+// URLs of hosts that do not resolve are dropped before they take a page of
+// budget or a fetch slot, and do not keep the crawl waiting for retries.
+static void testUnresolvableHosts() {
+    BenchSite site({"--pages", "5000", "--links", "20"});
+    auto resolve = [](const std::string& host, std::vector<std::string>& addresses, std::string& error) {
+        if (host.starts_with("dead")) {
+            error = "Name or service not known";
+            return false;
+        }
+        addresses.push_back("127.0.0.1");
+        return true;
+    };
+    std::vector<std::string> deadSeeds;
+    for (size_t host = 0; host < 8; ++host) {
+        for (uint64_t page = 0; page < 50; ++page) {
+            deadSeeds.push_back(site.url("dead" + testHost(host), page));
+        }
+    }
+
+    // Only dead hosts: nothing is fetched and the crawl ends at once
+    {
+        BudgetLimits budget;
+        budget.maxPages = 100;
+        WebCrawler crawler(wideLimits(), budget);
+        const auto start = std::chrono::steady_clock::now();
+        const std::vector<CrawlResult> results = crawl(crawler, deadSeeds, resolve);
+        CHECK(std::chrono::steady_clock::now() - start < std::chrono::seconds(10));
+        CHECK(results.empty());
+        CHECK(crawler.pagesCrawled() == 0);
+        CHECK(crawler.retriesScheduled() == 0);
+        CHECK(crawler.unresolvedUrls() == deadSeeds.size());
+    }
+
+    // Dead hosts queued first spend none of the budget the live hosts need
+    {
+        std::vector<std::string> seeds {deadSeeds};
+        for (size_t host = 0; host < 8; ++host) {
+            seeds.push_back(site.url(testHost(host), host * 100));
+        }
+        BudgetLimits budget;
+        budget.maxPages = 100;
+        WebCrawler crawler(wideLimits(), budget);
+        const auto start = std::chrono::steady_clock::now();
+        const std::vector<CrawlResult> results = crawl(crawler, seeds, resolve);
+        CHECK(std::chrono::steady_clock::now() - start < std::chrono::seconds(10));
+        CHECK(crawler.pagesCrawled() == budget.maxPages);
+        CHECK(results.size() == budget.maxPages);
+        checkDistinctAndOk(results);
+    }
+}
+
+// Fetches url from several threads until done() holds or the timeout passes,
+// acquiring and releasing slots of one host the way the fetch threads do.
+// Returns whether done() held.
+static bool fetchUntil(ConcurrencyController& controller, const std::string& url,
+                       const std::function<bool()>& done, std::chrono::seconds timeout,
+                       const std::string& host = "limited.test") {
+    const auto deadline = std::chrono::steady_clock::now() + timeout;
+    std::atomic<bool> finished {false};
+    std::vector<std::thread> threads;
+    for (size_t i = 0; i < 8; ++i) {
+        threads.emplace_back([&] {
+            while (!finished && std::chrono::steady_clock::now() < deadline) {
+                if (!controller.tryAcquire(host)) {
+                    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+                    continue;
+                }
+                HttpResult result;
+                std::string error;
+                const auto start = std::chrono::steady_clock::now();
+                const bool ok {getHttp(url, result, error)};
+                FetchOutcome outcome {FetchOutcome::Success};
+                if (!ok) {
+                    outcome = FetchOutcome::Error;
+                } else if (result.status == 429 || result.status == 503) {
+                    outcome = FetchOutcome::Throttled;
+                }
+                controller.release(host, outcome, std::chrono::duration_cast<std::chrono::milliseconds>(
+                                                      std::chrono::steady_clock::now() - start));
+                if (done()) finished = true;
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    return finished;
+}
+
+// The per-host limit backs off while a server rate-limits (429/503) or its
+// latency inflates, and climbs back to the maximum once it is healthy again.
+// Meanwhile a second, healthy host keeps its concurrency and the global limit.
+static void testConcurrencyBackoff() {
+    ConcurrencyLimits limits;
+    limits.initialLimit = 16;
+    limits.maxLimit = 16;
+    limits.hostInitialLimit = 2;
+    limits.hostMaxLimit = 8;
+    ConcurrencyController controller(limits);
+    const std::string host {"limited.test"};
+    const std::chrono::seconds timeout {15};
+    auto atMost = [&](size_t limit) { return [&controller, &host, limit] { return controller.hostLimit(host) <= limit; }; };
+    auto atMax = [&] { return controller.hostLimit(host) >= limits.hostMaxLimit; };
+
+    BenchSite healthy({"--pages", "1000"});
+    const std::string healthyUrl {"http://127.0.0.1:" + std::to_string(healthy.port()) + "/p/1"};
+    CHECK(fetchUntil(controller, healthyUrl, atMax, timeout));
+
+    const std::vector<std::vector<std::string>> stressed {
+        {"--pages", "1000", "--reject-rate", "0.5", "--reject-status", "429"},
+        {"--pages", "1000", "--reject-rate", "1", "--reject-status", "503"},
+        {"--pages", "1000", "--latency-ms", "50"},
+    };
+    const std::string otherHost {"other.test"};
+    CHECK(fetchUntil(controller, healthyUrl, [&] { return controller.hostLimit(otherHost) >= limits.hostMaxLimit; },
+                     timeout, otherHost));
+    for (const auto& options : stressed) {
+        {
+            BenchSite site(options);
+            const std::string url {"http://127.0.0.1:" + std::to_string(site.port()) + "/p/1"};
+            std::atomic<bool> stressDone {false};
+            std::atomic<size_t> lowestGlobal {controller.limit()};
+            std::atomic<size_t> lowestOther {controller.hostLimit(otherHost)};
+            std::thread other([&] {
+                fetchUntil(controller, healthyUrl, [&] {
+                    lowestGlobal = std::min<size_t>(lowestGlobal, controller.limit());
+                    lowestOther = std::min<size_t>(lowestOther, controller.hostLimit(otherHost));
+                    return stressDone.load();
+                }, timeout, otherHost);
+            });
+            const bool backedOff {fetchUntil(controller, url, atMost(2), timeout)};
+            stressDone = true;
+            other.join();
+            if (!backedOff) {
+                std::cerr << options[2] << " " << options[3] << ": host limit stayed at "
+                          << controller.hostLimit(host) << "\n";
+            }
+            CHECK(backedOff);
+            if (lowestGlobal < limits.maxLimit || lowestOther + 1 < limits.hostMaxLimit) {
+                std::cerr << options[2] << " " << options[3] << ": global limit fell to " << lowestGlobal
+                          << ", healthy host limit to " << lowestOther << "\n";
+            }
+            CHECK(lowestGlobal == limits.maxLimit);
+            // One slot of latency noise on loopback is tolerated
+            CHECK(lowestOther + 1 >= limits.hostMaxLimit);
+        }
+        const bool recovered {fetchUntil(controller, healthyUrl, atMax, timeout)};
+        if (!recovered) {
+            std::cerr << "After " << options[2] << " " << options[3] << ": host limit only recovered to "
+                      << controller.hostLimit(host) << "\n";
+        }
+        CHECK(recovered);
+    }
+}
+
+// Limiters of idle hosts are evicted once many hosts were seen, but a host
+// that is still backing off keeps its reduced limit.
+static void testConcurrencyEviction() {
+    ConcurrencyLimits limits;
+    limits.maxLimit = 4;
+    limits.hostInitialLimit = 4;
+    ConcurrencyController controller(limits);
+
+    CHECK(controller.tryAcquire("throttled.test"));
+    controller.release("throttled.test", FetchOutcome::Throttled, std::chrono::milliseconds(1));
+    CHECK(controller.hostLimit("throttled.test") == 2);
+    CHECK(controller.tryAcquire("busy.test"));
+
+    const size_t hosts {ConcurrencyController::kMaxHosts * 3};
+    for (size_t i = 0; i < hosts; ++i) {
+        const std::string host {testHost(i)};
+        CHECK(controller.tryAcquire(host));
+        controller.release(host, FetchOutcome::Success, std::chrono::milliseconds(1));
+    }
+    CHECK(controller.trackedHosts() <= ConcurrencyController::kMaxHosts * 2);
+    CHECK(controller.hostLimit("throttled.test") == 2);
+    // The slot held across the evictions is still accounted for
+    CHECK(controller.inFlightByHost().at("busy.test") == 1);
+    controller.release("busy.test", FetchOutcome::Success, std::chrono::milliseconds(1));
+    CHECK(controller.inFlight() == 0);
+}
+
+// A value of the parameter whose URLs are still fetched once it is learned.
+static std::string sampledValue() {
+    for (size_t i = 0;; ++i) {
+        std::string value {"v" + std::to_string(i)};
+        if (UrlCanonicalizer::hashContent(value) % 16 == 0) return value;
+    }
+}
+
+// Parameters are learned per host and path template, from distinct paths and
+// values only, never from rel=canonical, and sampled variants revoke them.
+static void testCanonicalizerLearning() {
+    UrlCanonicalizer canonicalizer;
+
+    // One path answering everything with the same page (a soft 404) teaches nothing
+    for (const char* query : {"q=a", "q=b", "q=c", "q=d", "q=e"}) {
+        canonicalizer.observeContent(std::string("https://a.test/search?") + query, "Nothing found");
+    }
+    CHECK(canonicalizer.canonicalize("https://a.test/search?q=z") == "https://a.test/search?q=z");
+
+    // Neither do canonical hints, however many pages carry them
+    for (int page = 0; page < 10; ++page) {
+        const std::string url {"https://a.test/list/" + std::to_string(page) + "?sort=" + std::to_string(page)};
+        canonicalizer.addCanonicalHint(url, "https://a.test/list/" + std::to_string(page));
+    }
+    CHECK(canonicalizer.canonicalize("https://a.test/list/99?sort=new") == "https://a.test/list/99?sort=new");
+    CHECK(canonicalizer.learnedParameters() == 0);
+
+    // Identical content from three items and several values strips ref on /item/#
+    for (int item = 1; item <= 3; ++item) {
+        const std::string base {"https://a.test/item/" + std::to_string(item) + "?ref="};
+        const std::string content {"Item " + std::to_string(item)};
+        canonicalizer.observeContent(base + "x" + std::to_string(item), content);
+        canonicalizer.observeContent(base + "y" + std::to_string(item), content);
+    }
+    CHECK(canonicalizer.learnedParameters() == 1);
+    CHECK(canonicalizer.canonicalize("https://a.test/item/7?ref=home") == "https://a.test/item/7");
+    // ... but only there
+    CHECK(canonicalizer.canonicalize("https://a.test/about?ref=home") == "https://a.test/about?ref=home");
+    CHECK(canonicalizer.canonicalize("https://b.test/item/7?ref=home") == "https://b.test/item/7?ref=home");
+
+    // A sampled value is still fetched; different content from the stripped URL revokes the rule
+    const std::string sampled {"https://a.test/item/8?ref=" + sampledValue()};
+    CHECK(canonicalizer.canonicalize(sampled) == sampled);
+    canonicalizer.observeContent("https://a.test/item/8", "Item 8");
+    canonicalizer.observeContent(sampled, "Item 8, as seen from elsewhere");
+    CHECK(canonicalizer.revokedParameters() == 1);
+    CHECK(canonicalizer.canonicalize("https://a.test/item/7?ref=home") == "https://a.test/item/7?ref=home");
+}
+
+// Parses a sitemap fed in chunks of chunkSize bytes; returns false if the parser failed.
+static bool parseSitemap(const std::string& document, size_t chunkSize, std::vector<SitemapEntry>& urls,
+                         std::vector<SitemapEntry>& sitemaps) {
+    SitemapParser parser([&](SitemapEntry&& entry) { urls.push_back(std::move(entry)); },
+                         [&](SitemapEntry&& entry) { sitemaps.push_back(std::move(entry)); });
+    for (size_t pos = 0; pos < document.size(); pos += chunkSize) {
+        if (!parser.feed(document.data() + pos, std::min(chunkSize, document.size() - pos))) return false;
+    }
+    return true;
+}
+
+static std::string gzip(const std::string& data) {
+    z_stream stream {};
+    deflateInit2(&stream, Z_BEST_COMPRESSION, Z_DEFLATED, 16 + MAX_WBITS, 8, Z_DEFAULT_STRATEGY);
+    std::string out(deflateBound(&stream, data.size()), '\0');
+    stream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(data.data()));
+    stream.avail_in = static_cast<uInt>(data.size());
+    stream.next_out = reinterpret_cast<Bytef*>(out.data());
+    stream.avail_out = static_cast<uInt>(out.size());
+    deflate(&stream, Z_FINISH);
+    out.resize(stream.total_out);
+    deflateEnd(&stream);
+    return out;
+}
+
+// Entities, CDATA, comments, namespace prefixes and index files parse the
+// same whichever way the bytes are split.
+static void testSitemapParser() {
+    const std::string document {
+        "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+        "<urlset xmlns=\"http://www.sitemaps.org/schemas/sitemap/0.9\">\n"
+        "<!-- <url><loc>https://commented.test/</loc></url> -->\n"
+        "<url><loc> https://e.test/?a=1&amp;b=2&#x41;&#66;&#233;&#x1F600;&nbsp; </loc>"
+        "<lastmod>2024-01-15T10:00:00+02:00</lastmod></url>\n"
+        "<url><loc><![CDATA[https://c.test/?x=1&y=]2]]]></loc><priority>0.5</priority></url>\n"
+        "<sm:url><sm:loc>https://ns.test/</sm:loc><sm:lastmod>2024</sm:lastmod></sm:url>\n"
+        "<url><lastmod>2024-01-15</lastmod></url>\n"
+        "</urlset>\n"};
+    for (size_t chunkSize : {size_t {1}, size_t {7}, document.size()}) {
+        std::vector<SitemapEntry> urls;
+        std::vector<SitemapEntry> sitemaps;
+        CHECK(parseSitemap(document, chunkSize, urls, sitemaps));
+        CHECK(sitemaps.empty());
+        CHECK(urls.size() == 3);
+        if (urls.size() != 3) continue;
+        CHECK(urls[0].loc == "https://e.test/?a=1&b=2AB\xC3\xA9\xF0\x9F\x98\x80&nbsp;");
+        CHECK(urls[0].lastModified == 1705305600);
+        CHECK(urls[1].loc == "https://c.test/?x=1&y=]2]");
+        CHECK(urls[1].lastModified == 0);
+        CHECK(urls[2].loc == "https://ns.test/");
+        CHECK(urls[2].lastModified == 1704067200);
+    }
+
+    std::vector<SitemapEntry> urls;
+    std::vector<SitemapEntry> sitemaps;
+    CHECK(parseSitemap("<sitemapindex><sitemap><loc>https://i.test/a.xml.gz</loc></sitemap>"
+                       "<sitemap><loc>https://i.test/b.xml</loc></sitemap></sitemapindex>", 5, urls, sitemaps));
+    CHECK(urls.empty());
+    CHECK(sitemaps.size() == 2 && sitemaps.back().loc == "https://i.test/b.xml");
+
+    CHECK(parseW3cDatetime("2024-01-15") == 1705276800);
+    CHECK(parseW3cDatetime("2024-01") == 1704067200);
+    CHECK(parseW3cDatetime("2024-01-15T10:00Z") == 1705312800);
+    CHECK(parseW3cDatetime("2024-01-15T10:00:00.123-05:30") == 1705332600);
+    CHECK(parseW3cDatetime("2024-1-15") == 0);
+    CHECK(parseW3cDatetime("2024-01-15T10") == 0);
+    CHECK(parseW3cDatetime("yesterday") == 0);
+}
+
+// A gzipped sitemap many times larger than the inflate buffer yields every
+// entry, the last ones included, however the compressed bytes arrive.
+static void testSitemapGzip() {
+    const size_t entries {5000};
+    std::string document {"<urlset>\n"};
+    for (size_t i = 0; i < entries; ++i) {
+        document += "<url><loc>https://s.test/page/" + std::to_string(i) + "</loc><lastmod>2024-01-15</lastmod></url>\n";
+    }
+    document += "</urlset>\n";
+    const std::string compressed {gzip(document)};
+    CHECK(document.size() > 16 * 16384);
+
+    // Two concatenated members are one valid gzip file
+    for (const std::string& input : {compressed, compressed + compressed}) {
+        const size_t expected {input.size() == compressed.size() ? entries : entries * 2};
+        for (size_t chunkSize : {size_t {1}, size_t {100}, size_t {4096}, input.size()}) {
+            std::vector<SitemapEntry> urls;
+            std::vector<SitemapEntry> sitemaps;
+            CHECK(parseSitemap(input, chunkSize, urls, sitemaps));
+            if (urls.size() != expected) {
+                std::cerr << "Chunks of " << chunkSize << ": " << urls.size() << " of " << expected << " entries\n";
+            }
+            CHECK(urls.size() == expected);
+            CHECK(!urls.empty() && urls.back().loc == "https://s.test/page/" + std::to_string(entries - 1));
+            CHECK(!urls.empty() && urls.back().lastModified == 1705276800);
+        }
+    }
+
+    // A transfer cut short keeps every entry that fully arrived: output zlib
+    // still holds when the last bytes are fed must not be dropped
+    std::string shortDocument {"<urlset>\n"};
+    for (size_t i = 0; i < 3000; ++i) {
+        shortDocument += "<url><loc>https://s.test/" + std::to_string(i) + "</loc></url>\n";
+    }
+    const std::string shortCompressed {gzip(shortDocument)};
+    size_t mismatches {0};
+    for (size_t cut = 400; cut < std::min<size_t>(shortCompressed.size(), 3000); ++cut) {
+        // Reference: everything zlib can decode from the truncated stream
+        z_stream stream {};
+        inflateInit2(&stream, 16 + MAX_WBITS);
+        std::string decoded(shortDocument.size(), '\0');
+        stream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(shortCompressed.data()));
+        stream.avail_in = static_cast<uInt>(cut);
+        stream.next_out = reinterpret_cast<Bytef*>(decoded.data());
+        stream.avail_out = static_cast<uInt>(decoded.size());
+        inflate(&stream, Z_NO_FLUSH);
+        decoded.resize(stream.total_out);
+        inflateEnd(&stream);
+        size_t expected {0};
+        for (size_t pos = decoded.find("</url>"); pos != std::string::npos; pos = decoded.find("</url>", pos + 1)) {
+            expected++;
+        }
+
+        std::vector<SitemapEntry> urls;
+        std::vector<SitemapEntry> sitemaps;
+        parseSitemap(shortCompressed.substr(0, cut), cut, urls, sitemaps);
+        if (urls.size() != expected) mismatches++;
+    }
+    CHECK(mismatches == 0);
+
+    // Corrupt compressed data is an error, not a silently short sitemap
+    std::string corrupt {compressed};
+    corrupt[corrupt.size() / 2] ^= 0x55;
+    corrupt[corrupt.size() / 2 + 1] ^= 0x55;
+    std::vector<SitemapEntry> urls;
+    std::vector<SitemapEntry> sitemaps;
+    CHECK(!parseSitemap(corrupt, corrupt.size(), urls, sitemaps));
+}
+
+// Timers at every level of the wheel, scheduled before and while it turns,
+// fire on the first advance that reaches their deadline and never before it;
+// deadlines beyond the top level fire at the horizon.
+static void testTimerWheel() {
+    using Clock = std::chrono::steady_clock;
+    using Ticks = std::chrono::milliseconds;
+    const Clock::time_point start {};
+    const uint64_t horizon {(uint64_t {1} << 24) - 1};
+    TimerWheel<size_t> wheel(Ticks(1), start);
+    std::mt19937_64 random {42};
+
+    // Expected firing tick of every timer, by value
+    std::vector<uint64_t> due;
+    auto schedule = [&](uint64_t now, uint64_t delay) {
+        wheel.schedule(due.size(), start + Ticks(now + delay));
+        due.push_back(now + std::min(delay, horizon));
+    };
+    // One span per level, plus past the top level
+    const uint64_t spans[] {64, 4096, uint64_t {1} << 18, horizon, horizon * 2};
+    for (uint64_t span : spans) {
+        for (size_t i = 0; i < 50; ++i) {
+            schedule(0, std::uniform_int_distribution<uint64_t>(0, span)(random));
+        }
+    }
+    schedule(0, 0);
+    schedule(0, horizon);
+    schedule(0, horizon + 1);
+
+    std::vector<bool> fired(due.size(), false);
+    std::vector<size_t> out;
+    uint64_t previous {0};
+    wheel.advance(start, out);
+    for (size_t value : out) {
+        CHECK(due[value] == 0);
+        fired[value] = true;
+    }
+    size_t early {0};
+    size_t late {0};
+    // Every deadline is within twice the horizon; a lost timer must not hang the test
+    while (!wheel.empty() && previous <= horizon * 2) {
+        const uint64_t now {previous + std::uniform_int_distribution<uint64_t>(1, 20000)(random)};
+        out.clear();
+        wheel.advance(start + Ticks(now), out);
+        for (size_t value : out) {
+            if (due[value] > now) early++;
+            if (due[value] <= previous) late++;
+            CHECK(!fired[value]);
+            fired[value] = true;
+        }
+        // Timers added while the wheel turns are placed relative to it
+        if (now < horizon && random() % 4 == 0) {
+            schedule(now, std::uniform_int_distribution<uint64_t>(0, spans[random() % 4])(random));
+            if (due.back() <= now) due.back() = now + 1;  // Fires on the next advance at the earliest
+            fired.push_back(false);
+        }
+        previous = now;
+    }
+    CHECK(wheel.empty());
+    CHECK(early == 0);
+    CHECK(late == 0);
+    CHECK(std::all_of(fired.begin(), fired.end(), [](bool value) { return value; }));
+
+    // A deadline in the past fires on the next advance; drain empties the wheel
+    TimerWheel<int> small(Ticks(10), start);
+    small.schedule(1, start - Ticks(50));
+    small.schedule(2, start + Ticks(15));
+    small.schedule(3, start + std::chrono::hours(1));
+    std::vector<int> values;
+    small.advance(start + Ticks(10), values);
+    CHECK(values == std::vector<int> {1});
+    small.advance(start + Ticks(19), values);
+    CHECK(values.size() == 1);
+    small.advance(start + Ticks(20), values);
+    CHECK((values == std::vector<int> {1, 2}));
+    values.clear();
+    small.drain(values);
+    CHECK(values == std::vector<int> {3});
+    CHECK(small.empty());
+}
+
+// Failure classes, Retry-After in both forms and the backoff bounds.
+static void testRetryPolicy() {
+    CHECK(classifyFailure(false, CURLE_OPERATION_TIMEDOUT, 0) == FailureClass::Retryable);
+    CHECK(classifyFailure(false, CURLE_COULDNT_CONNECT, 0) == FailureClass::Retryable);
+    CHECK(classifyFailure(false, CURLE_RECV_ERROR, 0) == FailureClass::Retryable);
+    CHECK(classifyFailure(false, CURLE_COULDNT_RESOLVE_HOST, 0) == FailureClass::Permanent);
+    CHECK(classifyFailure(false, CURLE_PEER_FAILED_VERIFICATION, 0) == FailureClass::Permanent);
+    CHECK(classifyFailure(false, CURLE_TOO_MANY_REDIRECTS, 0) == FailureClass::Permanent);
+    for (long status : {408L, 429L, 500L, 502L, 503L, 504L}) {
+        CHECK(classifyFailure(true, CURLE_OK, status) == FailureClass::Retryable);
+    }
+    for (long status : {200L, 301L, 404L, 410L, 501L}) {
+        CHECK(classifyFailure(true, CURLE_OK, status) == FailureClass::None);
+    }
+
+    CHECK(parseRetryAfter("120") == std::chrono::seconds(120));
+    CHECK(parseRetryAfter("0") == std::chrono::seconds(0));
+    CHECK(parseRetryAfter("99999999999") == std::chrono::minutes(10));
+    CHECK(!parseRetryAfter(""));
+    CHECK(!parseRetryAfter("soon"));
+    CHECK(parseRetryAfter("Wed, 21 Oct 2015 07:28:00 GMT") == std::chrono::seconds(0));
+    char date[64];
+    const std::time_t later {std::time(nullptr) + 90};
+    std::tm tm {};
+    gmtime_r(&later, &tm);
+    std::strftime(date, sizeof(date), "%a, %d %b %Y %H:%M:%S GMT", &tm);
+    const auto fromDate = parseRetryAfter(date);
+    CHECK(fromDate && *fromDate >= std::chrono::seconds(88) && *fromDate <= std::chrono::seconds(90));
+
+    for (int i = 0; i < 1000; ++i) {
+        const auto first = retryDelay(1, std::nullopt);
+        CHECK(first >= std::chrono::milliseconds(250) && first <= std::chrono::seconds(1));
+        const auto third = retryDelay(3, std::nullopt);
+        CHECK(third >= std::chrono::milliseconds(250) && third <= std::chrono::seconds(4));
+        CHECK(retryDelay(40, std::nullopt) <= std::chrono::minutes(5));
+        const auto told = retryDelay(1, std::chrono::seconds(10));
+        CHECK(told >= std::chrono::seconds(10) && told <= std::chrono::seconds(11));
+        CHECK(retryDelay(1, std::chrono::hours(5)) <= std::chrono::minutes(11));
+        CHECK(retryDelay(1, std::chrono::seconds(0)) == std::chrono::milliseconds(250));
+    }
+}
+
+// The breaker opens after a run of distinct failures, lets one probe through
+// after a doubling cooldown, closes on success and gives up after repeated trips.
+static void testHostHealth() {
+    using namespace std::chrono_literals;
+    const auto t0 = std::chrono::steady_clock::now();
+    const std::string host {"failing.test"};
+    HostHealth health;
+    std::chrono::steady_clock::time_point retryAt {};
+    auto fail = [&](std::chrono::steady_clock::time_point now, bool retry = false) {
+        health.recordFailure(host, false, 0ms, retry, now);
+    };
+
+    // Retries of one broken URL never move the breaker
+    for (int i = 0; i < 20; ++i) fail(t0, true);
+    CHECK(health.allowRequest(host, retryAt, t0));
+
+    for (int i = 0; i < 4; ++i) fail(t0);
+    CHECK(health.allowRequest(host, retryAt, t0));
+    fail(t0);
+    CHECK(!health.allowRequest(host, retryAt, t0 + 29s));
+    CHECK(retryAt == t0 + 30s);
+
+    // Half-open: one probe, everyone else waits for its result
+    CHECK(health.allowRequest(host, retryAt, t0 + 30s));
+    CHECK(!health.allowRequest(host, retryAt, t0 + 30s));
+    CHECK(retryAt == t0 + 31s);
+
+    // A failed probe reopens at once with twice the cooldown
+    fail(t0 + 31s, true);
+    CHECK(!health.allowRequest(host, retryAt, t0 + 31s));
+    CHECK(retryAt == t0 + 91s);
+
+    // A successful probe closes it and forgets the trips
+    CHECK(health.allowRequest(host, retryAt, t0 + 91s));
+    health.recordSuccess(host, 100ms);
+    CHECK(health.allowRequest(host, retryAt, t0 + 91s));
+    for (int i = 0; i < 5; ++i) fail(t0 + 100s);
+    CHECK(!health.allowRequest(host, retryAt, t0 + 100s));
+    CHECK(retryAt == t0 + 130s);
+
+    // Probes that keep failing: cooldowns double up to a cap, then the host is given up
+    auto now = t0 + 130s;
+    std::chrono::seconds expected {60};
+    for (int trip = 2; trip <= 5; ++trip) {
+        CHECK(health.allowRequest(host, retryAt, now));
+        fail(now);
+        CHECK(!health.allowRequest(host, retryAt, now));
+        if (trip <= 4) {
+            CHECK(retryAt == now + expected);
+            now = retryAt;
+            expected *= 2;
+        }
+    }
+    CHECK(retryAt == std::chrono::steady_clock::time_point::max());
+    CHECK(!health.allowRequest(host, retryAt, now + 24h));
+
+    // Timeouts: fixed until enough samples, then a multiple of p99 (at least 2s); retries double them
+    const std::string fast {"fast.test"};
+    CHECK(health.timeoutsFor(fast, 0).timeout == 20s);
+    CHECK(health.timeoutsFor(fast, 2).timeout == 60s);
+    for (int i = 0; i < 20; ++i) health.recordSuccess(fast, 100ms);
+    CHECK(health.timeoutsFor(fast, 0).timeout == 2s);
+    CHECK(health.timeoutsFor(fast, 0).connectTimeout == 1s);
+    CHECK(health.timeoutsFor(fast, 1).timeout == 4s);
+    const std::string slow {"slow.test"};
+    for (int i = 0; i < 20; ++i) health.recordSuccess(slow, 1500ms);
+    const auto slowTimeout = health.timeoutsFor(slow, 0).timeout;
+    CHECK(slowTimeout >= 6s && slowTimeout <= 20s);
+}
+
+// Template collapsing, repeating segments, size limits, the per-host depth
+// histogram and the yield-based throttle and drop decisions.
+static void testTrapDetector() {
+    const UrlShape day {TrapDetector::classify("https://a.test/cal/2024/05/17?view=day&tz=utc#top")};
+    CHECK(day.pattern != 0);
+    CHECK(day.depth == 4);
+    CHECK(!day.repeating && !day.oversized);
+    CHECK(TrapDetector::classify("https://a.test/cal/1999/1/3?tz=cet&view=week").pattern == day.pattern);
+    CHECK(TrapDetector::classify("https://a.test/cal/2024/05/17?view=day").pattern != day.pattern);
+    CHECK(TrapDetector::classify("https://a.test/cal/v2/05/17?view=day&tz=utc").pattern != day.pattern);
+
+    CHECK(TrapDetector::classify("https://a.test/a/b/a/b").repeating);
+    CHECK(TrapDetector::classify("https://a.test/x/y/z/x/y/z/q").repeating);
+    CHECK(TrapDetector::classify("https://a.test/img/x/img/y/img").repeating);
+    CHECK(!TrapDetector::classify("https://a.test/2024/01/01").repeating);
+    CHECK(!TrapDetector::classify("https://a.test/docs/api/docs/guide").repeating);
+    CHECK(TrapDetector::classify("https://a.test/?" + std::string(2100, 'q')).oversized);
+    std::string manyParams {"https://a.test/search?"};
+    for (int i = 0; i < 17; ++i) manyParams += "p" + std::to_string(i) + "=1&";
+    CHECK(TrapDetector::classify(manyParams).oversized);
+
+    TrapDetector detector;
+    auto admit = [&](const std::string& host, const std::string& url) {
+        return detector.admit(host, url, TrapDetector::classify(url));
+    };
+    CHECK(!admit("a.test", "https://a.test/a/b/a/b"));
+    CHECK(!admit("a.test", manyParams));
+    std::string deep {"https://a.test"};
+    for (int i = 0; i < 25; ++i) deep += "/s" + std::to_string(i % 7) + "x" + std::to_string(i);
+    CHECK(!admit("a.test", deep));
+    CHECK(detector.dropped() == 3);
+    CHECK(detector.throttled() == 0);
+
+    // Once the histogram is trusted, URLs far deeper than usual are sampled 1 in 8
+    for (int i = 0; i < 300; ++i) {
+        CHECK(admit("d.test", "https://d.test/blog/post-" + std::to_string(i)));
+    }
+    size_t deepAdmitted {0};
+    for (int i = 0; i < 80; ++i) {
+        if (admit("d.test", "https://d.test/a/b/c/d/e/f/" + std::to_string(i))) deepAdmitted++;
+    }
+    CHECK(deepAdmitted == 10);
+    CHECK(admit("d.test", "https://d.test/a/b/c/d/e"));
+    // Another host has no history yet
+    CHECK(admit("e.test", "https://e.test/a/b/c/d/e/f/g"));
+
+    // Calendar: every page adds one more of its own kind and nothing else.
+    // Throttled once judged, dropped once it has kept that up long enough.
+    auto yield = [&](const std::string& url, size_t newLinks, size_t selfLinks) {
+        detector.recordYield("c.test", url, TrapDetector::classify(url), newLinks, selfLinks);
+    };
+    for (int i = 0; i < 49; ++i) yield("https://c.test/cal/2024/1/" + std::to_string(i), 1, 1);
+    CHECK(admit("c.test", "https://c.test/cal/2025/1/1"));
+    yield("https://c.test/cal/2024/2/1", 1, 1);
+    size_t sampled {0};
+    for (int i = 0; i < 16; ++i) {
+        if (admit("c.test", "https://c.test/cal/2026/1/" + std::to_string(i))) sampled++;
+    }
+    CHECK(sampled == 2);
+    for (int i = 0; i < 150; ++i) yield("https://c.test/cal/2024/3/" + std::to_string(i), 1, 1);
+    CHECK(!admit("c.test", "https://c.test/cal/2026/1/1"));
+    CHECK(!admit("c.test", "https://c.test/cal/2027/8/9"));
+
+    // A catalog fanning out into many of its own kind, and articles linking
+    // elsewhere, are not traps
+    for (int i = 0; i < 300; ++i) {
+        yield("https://c.test/list/" + std::to_string(i), 20, 20);
+        yield("https://c.test/article/" + std::to_string(i), 5, 1);
+    }
+    CHECK(admit("c.test", "https://c.test/list/999"));
+    CHECK(admit("c.test", "https://c.test/article/999"));
+
+    // Hosts not seen for a while are forgotten; a host that keeps linking keeps its verdicts
+    for (size_t i = 0; i < TrapDetector::kMaxHosts * 3; ++i) {
+        const std::string host {testHost(i)};
+        admit(host, "https://" + host + "/page");
+        if (i % 1000 == 0) admit("c.test", "https://c.test/list/1");
+    }
+    CHECK(detector.trackedHosts() <= TrapDetector::kMaxHosts * 2 + 1);
+    CHECK(!admit("c.test", "https://c.test/cal/2028/1/1"));
+}
+
+// Crawling a site with an endless calendar: the calendar is cut off after a
+// sample, every real page is still crawled, and the crawl ends on its own
+// long before the page budget is spent.
+static void testTrapCalendarCrawl() {
+    const size_t pages {300};
+    BenchSite site({"--pages", std::to_string(pages), "--links", "5", "--calendar-links", "1"});
+    BudgetLimits budget;
+    budget.maxPages = 3000;
+    WebCrawler crawler(wideLimits(), budget);
+    const std::vector<CrawlResult> results = crawl(crawler, {site.url("site.test", 0)});
+    checkDistinctAndOk(results);
+
+    size_t realPages {0};
+    size_t calendarPages {0};
+    for (const auto& result : results) {
+        if (result.url.find("/cal/") != std::string::npos) {
+            calendarPages++;
+        } else {
+            realPages++;
+        }
+    }
+    if (calendarPages > 400) {
+        std::cerr << calendarPages << " calendar pages crawled\n";
+    }
+    CHECK(realPages == pages);
+    CHECK(calendarPages > 0 && calendarPages <= 400);
+    CHECK(crawler.pagesCrawled() < budget.maxPages);
+    CHECK(crawler.trapDetector().throttled() + crawler.trapDetector().dropped() > 0);
+}
+
+// A scratch file or directory path, removed when this goes out of scope.
+class TempPath {
+public:
+    explicit TempPath(const std::string& name)
+        : m_path((std::filesystem::temp_directory_path() /
+                  ("crawler_tests_" + std::to_string(::getpid()) + "_" + name)).string()) {}
+    ~TempPath() {
+        std::error_code error;
+        std::filesystem::remove_all(m_path, error);
+    }
+    TempPath(const TempPath&) = delete;
+    TempPath& operator=(const TempPath&) = delete;
+
+    const std::string& str() const { return m_path; }
+
+private:
+    std::string m_path;
+};
+
+static std::string readFile(const std::string& path) {
+    std::ifstream in(path, std::ios::binary);
+    std::ostringstream out;
+    out << in.rdbuf();
+    return out.str();
+}
+
+static void writeFile(const std::string& path, std::string_view data) {
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    out.write(data.data(), static_cast<std::streamsize>(data.size()));
+}
+
+// Rows spanning several row groups, one of them short (flush()), come back
+// from count() and scan() exactly as a brute-force filter over the input sees
+// them, for filters the row group statistics settle and ones they do not.
+static void testResultFileRoundTrip() {
+    std::vector<CrawlResult> rows;
+    const size_t total {kResultRowGroupSize * 3 + 1234};
+    const size_t flushAt {kResultRowGroupSize + 777};
+    for (size_t i = 0; i < total; ++i) {
+        CrawlResult row;
+        const size_t group {i < flushAt ? i / kResultRowGroupSize : (i + kResultRowGroupSize - 777) / kResultRowGroupSize};
+        row.url = "https://h" + std::to_string(i % 7) + ".test/section/" + std::to_string(i / 3) + "/item-" + std::to_string(i);
+        row.title = i % 5 == 0 ? "" : "Item " + std::to_string(i) + " | Example";
+        // The second group is all 200s; the others mix codes
+        static constexpr long kStatuses[] {200, 200, 200, 404, 301, 500, 0};
+        row.status = group == 1 ? 200 : kStatuses[(i * 31) % std::size(kStatuses)];
+        row.error = row.status == 0 ? "Timeout after " + std::to_string(i % 90) + "s" : "";
+        // Link counts of each group occupy their own range, so statistics prune groups
+        row.linkCount = group * 100 + i % 50;
+        row.lastModified = i % 3 == 0 ? 0 : static_cast<std::time_t>(1700000000 + static_cast<long>(i) * (i % 2 ? 1 : -1));
+        rows.push_back(std::move(row));
+    }
+
+    TempPath path("roundtrip.ccr");
+    {
+        ResultFileWriter writer(path.str());
+        CHECK(writer.writeHeader());
+        for (size_t i = 0; i < rows.size(); ++i) {
+            CHECK(writer.writeResult(rows[i]));
+            if (i + 1 == flushAt) CHECK(writer.flush());
+        }
+        CHECK(writer.finish());
+    }
+
+    ResultFileReader reader;
+    CHECK(reader.open(path.str()));
+    CHECK(reader.rowCount() == total);
+    CHECK(reader.rowGroupCount() == 5);
+
+    std::vector<ResultFilter> filters(8);
+    filters[1].status = 200;
+    filters[2].status = 404;
+    filters[3].status = 999;
+    filters[4].minLinkCount = 100;
+    filters[4].maxLinkCount = 149;
+    filters[5].status = 500;
+    filters[5].minLinkCount = 120;
+    filters[5].maxLinkCount = 130;
+    filters[6].minLinkCount = 10000;
+    filters[7].status = 0;
+    filters[7].maxLinkCount = 10;
+    for (const auto& filter : filters) {
+        std::vector<const CrawlResult*> expected;
+        for (const auto& row : rows) {
+            if ((!filter.status || row.status == *filter.status) &&
+                row.linkCount >= filter.minLinkCount && row.linkCount <= filter.maxLinkCount) {
+                expected.push_back(&row);
+            }
+        }
+        CHECK(reader.count(filter) == expected.size());
+
+        size_t seen {0};
+        size_t mismatched {0};
+        CHECK(reader.scan(filter, [&](const CrawlResult& row) {
+            if (seen < expected.size()) {
+                const CrawlResult& want {*expected[seen]};
+                if (row.url != want.url || row.title != want.title || row.status != want.status ||
+                    row.error != want.error || row.linkCount != want.linkCount ||
+                    row.lastModified != want.lastModified) {
+                    mismatched++;
+                }
+            }
+            seen++;
+        }));
+        CHECK(seen == expected.size());
+        CHECK(mismatched == 0);
+    }
+
+    // Reopening maps the new file and releases the old mapping
+    TempPath other("other.ccr");
+    {
+        ResultFileWriter writer(other.str());
+        CHECK(writer.writeHeader());
+        CHECK(writer.writeResult(rows[0]));
+        CHECK(writer.finish());
+    }
+    CHECK(reader.open(other.str()));
+    CHECK(reader.rowCount() == 1);
+    const std::string maps {readFile("/proc/self/maps")};
+    CHECK(maps.find(path.str()) == std::string::npos);
+}
+
+// Truncated or damaged files are rejected on open, never half read.
+static void testResultFileCorrupt() {
+    TempPath path("corrupt.ccr");
+    {
+        ResultFileWriter writer(path.str());
+        CHECK(writer.writeHeader());
+        for (size_t i = 0; i < 1000; ++i) {
+            CHECK(writer.writeResult(CrawlResult {"https://c.test/" + std::to_string(i), "Title", 200, i % 10, "", 0}));
+        }
+        CHECK(writer.finish());
+    }
+    const std::string file {readFile(path.str())};
+    ResultFileReader reader;
+    CHECK(reader.open(path.str()));
+
+    TempPath damaged("damaged.ccr");
+    for (size_t cut : {size_t {1}, size_t {8}, size_t {17}, size_t {40}, file.size() / 2, file.size() - 8}) {
+        writeFile(damaged.str(), std::string_view(file).substr(0, file.size() - cut));
+        CHECK(!reader.open(damaged.str()));
+        CHECK(reader.rowCount() == 0);
+    }
+
+    // A flushed but unfinished file has no footer yet
+    {
+        ResultFileWriter writer(damaged.str());
+        CHECK(writer.writeHeader());
+        CHECK(writer.writeResult(CrawlResult {"https://c.test/", "Title", 200, 1, "", 0}));
+        CHECK(writer.flush());
+        CHECK(!reader.open(damaged.str()));
+        CHECK(writer.finish());
+    }
+    CHECK(reader.open(damaged.str()));
+
+    // A footer offset pointing outside the file
+    std::string badOffset {file};
+    badOffset[badOffset.size() - 16] = static_cast<char>(0xFF);
+    badOffset[badOffset.size() - 10] = static_cast<char>(0x7F);
+    writeFile(damaged.str(), badOffset);
+    CHECK(!reader.open(damaged.str()));
+
+    // Chunk offsets that run backwards
+    std::string badChunks {file};
+    uint64_t footer {0};
+    for (int i = 0; i < 8; ++i) {
+        footer |= static_cast<uint64_t>(static_cast<unsigned char>(file[file.size() - 16 + i])) << (8 * i);
+    }
+    badChunks[footer + 3] = '\x01';
+    writeFile(damaged.str(), badChunks);
+    CHECK(!reader.open(damaged.str()));
+}
+
+// Exact, wildcard and dotted rules, blocks over allows, and case folding.
+static void testDomainFilter() {
+    DomainFilter filter;
+    CHECK(!filter.hasAllowRules());
+    CHECK(filter.isAllowed("anything.test"));
+
+    filter.allow("example.com");
+    filter.allow("*.wild.test");
+    filter.allow(".both.test");
+    CHECK(filter.hasAllowRules());
+
+    CHECK(filter.isAllowed("example.com"));
+    CHECK(filter.isAllowed("WWW.Example.COM.") == false);
+    CHECK(filter.isAllowed("Example.COM."));
+    CHECK(!filter.isAllowed("www.example.com"));
+    CHECK(!filter.isAllowed("com"));
+    CHECK(!filter.isAllowed("xexample.com"));
+
+    CHECK(filter.isAllowed("a.wild.test"));
+    CHECK(filter.isAllowed("a.b.wild.test"));
+    CHECK(!filter.isAllowed("wild.test"));
+
+    CHECK(filter.isAllowed("both.test"));
+    CHECK(filter.isAllowed("x.y.both.test"));
+    CHECK(!filter.isAllowed("other.org"));
+    CHECK(!filter.isAllowed(""));
+
+    // Blocks win over allows, each with its own reach
+    filter.allow(".site.test");
+    filter.block("ads.site.test");
+    filter.block("*.tracker.site.test");
+    CHECK(filter.isAllowed("www.site.test"));
+    CHECK(!filter.isAllowed("ads.site.test"));
+    CHECK(filter.isBlocked("ADS.site.test"));
+    CHECK(filter.isAllowed("x.ads.site.test"));
+    CHECK(filter.isAllowed("tracker.site.test"));
+    CHECK(!filter.isAllowed("a.tracker.site.test"));
+    filter.block(".site.test");
+    CHECK(!filter.isAllowed("site.test"));
+    CHECK(!filter.isAllowed("www.site.test"));
+    CHECK(filter.isAllowed("both.test"));
+
+    // With only block rules, everything else is allowed
+    DomainFilter blockOnly;
+    blockOnly.block("*.bad.test");
+    CHECK(!blockOnly.hasAllowRules());
+    CHECK(blockOnly.isAllowed("bad.test"));
+    CHECK(!blockOnly.isAllowed("x.bad.test"));
+    CHECK(blockOnly.isAllowed("good.test"));
+}
+
+// Siblings are kept in unsigned byte order; lookups of labels with bytes
+// >= 0x80 (raw UTF-8) must binary search in that same order.
+static void testDomainFilterHighBytes() {
+    const std::vector<std::string> labels {"a", "m", "z", "\xc3\xa9t\xc3\xa9", "\xe2\x82\xac", "\xff", "~x"};
+    DomainFilter filter;
+    for (const auto& label : labels) {
+        filter.allow(label + ".utf8.test");
+    }
+    for (const auto& label : labels) {
+        CHECK(filter.isAllowed(label + ".utf8.test"));
+    }
+    CHECK(!filter.isAllowed("\xc3\xa9.utf8.test"));
+    CHECK(!filter.isAllowed("\xe2\x82.utf8.test"));
+    CHECK(!filter.isAllowed("b.utf8.test"));
+}
+
+// allowAll() builds the same trie as one allow() per pattern, including when
+// it extends nodes that earlier rules created.
+static void testDomainFilterBulk() {
+    std::mt19937_64 random {7};
+    std::vector<std::string> hosts;
+    static constexpr const char* kTlds[] {"com", "org", "test", "co.uk", "xn--p1ai"};
+    for (int i = 0; i < 5000; ++i) {
+        std::string host;
+        if (random() % 3 == 0) host = "www.";
+        host += "h" + std::to_string(random() % 2000);
+        if (random() % 4 == 0) host += "\xc3\xa9";
+        host += ".";
+        host += kTlds[random() % std::size(kTlds)];
+        if (random() % 10 == 0) host[0] = 'W';
+        hosts.push_back(host);
+    }
+
+    DomainFilter single;
+    DomainFilter bulk;
+    std::vector<std::string_view> rest;
+    for (size_t i = 0; i < hosts.size(); ++i) {
+        single.allow(hosts[i]);
+        if (i < 100) bulk.allow(hosts[i]);
+        else rest.push_back(hosts[i]);
+    }
+    bulk.allowAll(rest);
+
+    size_t mismatched {0};
+    size_t allowed {0};
+    for (int i = 0; i < 20000; ++i) {
+        std::string probe;
+        if (i < static_cast<int>(hosts.size())) {
+            probe = hosts[i];
+        } else {
+            probe = (random() % 2 ? "www.h" : "h") + std::to_string(random() % 2500) + "." +
+                kTlds[random() % std::size(kTlds)];
+        }
+        if (single.isAllowed(probe) != bulk.isAllowed(probe)) mismatched++;
+        if (bulk.isAllowed(probe)) allowed++;
+    }
+    CHECK(mismatched == 0);
+    CHECK(allowed >= hosts.size());
+    for (const auto& host : hosts) {
+        CHECK(bulk.isAllowed(host));
+    }
+}
+
+// tokenize() lowercases ASCII, splits on everything else and keeps UTF-8 bytes.
+static void testTokenize() {
+    std::vector<std::string> terms;
+    tokenize("Hello, WORLD! caf\xc3\xa9 x2 -- a_b " + std::string(65, 'q') + " end", [&](std::string_view term) {
+        terms.emplace_back(term);
+    });
+    const std::vector<std::string> expected {"hello", "world", "caf\xc3\xa9", "x2", "a", "b", "end"};
+    CHECK(terms == expected);
+}
+
+// An index built through several runs and merges returns the postings a
+// brute-force pass over the same documents finds, and search() returns their
+// conjunction scored by tf-idf.
+static void testInvertedIndex() {
+    static constexpr uint32_t kDocuments {3000};
+    std::vector<std::string> texts;
+    for (uint32_t i = 0; i < kDocuments; ++i) {
+        std::string text {"common"};
+        if (i % 2 == 0) text += " Even";
+        if (i % 5 == 0) text += " ALPHA alpha";
+        if (i % 11 == 0) text += " caf\xc3\xa9";
+        for (uint32_t k = 0; k <= i % 9; ++k) {
+            text += " w" + std::to_string((i * 7 + k * 13) % 200);
+        }
+        texts.push_back(text);
+    }
+
+    std::vector<std::map<std::string, uint32_t>> frequencies(kDocuments);
+    std::map<std::string, std::vector<Posting>> expected;
+    for (uint32_t i = 0; i < kDocuments; ++i) {
+        tokenize(texts[i], [&](std::string_view term) { frequencies[i][std::string(term)]++; });
+        for (const auto& [term, frequency] : frequencies[i]) {
+            expected[term].push_back(Posting {i, frequency});
+        }
+    }
+
+    TempPath directory("index");
+    IndexOptions options;
+    options.directory = directory.str();
+    options.numThreads = 3;
+    options.runBytes = 16u << 10;
+    options.queueCapacity = 64;
+    options.mergeFanIn = 2;
+    {
+        IndexBuilder builder(options);
+        CHECK(builder.start());
+        for (uint32_t i = 0; i < kDocuments; ++i) {
+            builder.addDocument("https://idx.test/" + std::to_string(i), texts[i]);
+            if (i == kDocuments / 2) builder.flush();
+        }
+        CHECK(builder.finish());
+        CHECK(builder.documentCount() == kDocuments);
+    }
+
+    IndexReader reader;
+    CHECK(reader.open(directory.str()));
+    CHECK(reader.documentCount() == kDocuments);
+    CHECK(reader.termCount() == expected.size());
+    for (uint32_t i = 0; i < kDocuments; i += 97) {
+        CHECK(reader.url(i) == "https://idx.test/" + std::to_string(i));
+    }
+
+    size_t mismatched {0};
+    for (const auto& [term, postings] : expected) {
+        const auto actual {reader.postings(term)};
+        bool same {actual.size() == postings.size()};
+        for (size_t i = 0; same && i < actual.size(); ++i) {
+            same = actual[i].docId == postings[i].docId && actual[i].termFrequency == postings[i].termFrequency;
+        }
+        if (!same) mismatched++;
+    }
+    CHECK(mismatched == 0);
+    CHECK(expected["common"].size() > kPostingsBlockSize * 4);
+    CHECK(reader.postings("missing").empty());
+
+    for (const std::string query : {"common", "even w7", "Alpha EVEN w13", "w3 w150 common", "caf\xc3\xa9 alpha",
+                                    "missing common", "w7 w7"}) {
+        std::vector<std::string> terms;
+        tokenize(query, [&](std::string_view term) { terms.emplace_back(term); });
+        std::sort(terms.begin(), terms.end());
+        terms.erase(std::unique(terms.begin(), terms.end()), terms.end());
+
+        std::map<uint32_t, double> want;
+        for (uint32_t i = 0; i < kDocuments; ++i) {
+            double score {0};
+            bool all {true};
+            for (const auto& term : terms) {
+                auto frequency {frequencies[i].find(term)};
+                if (frequency == frequencies[i].end()) {
+                    all = false;
+                    break;
+                }
+                score += frequency->second *
+                    std::log(1.0 + double {kDocuments} / static_cast<double>(expected[term].size()));
+            }
+            if (all) want[i] = score;
+        }
+
+        const auto hits {reader.search(query, kDocuments)};
+        CHECK(hits.size() == want.size());
+        size_t wrong {0};
+        for (size_t i = 0; i < hits.size(); ++i) {
+            auto found {want.find(hits[i].docId)};
+            if (found == want.end() || std::abs(found->second - hits[i].score) > 1e-9) wrong++;
+            if (i > 0 && hits[i].score > hits[i - 1].score) wrong++;
+        }
+        CHECK(wrong == 0);
+
+        const auto top {reader.search(query, 5)};
+        CHECK(top.size() == std::min<size_t>(5, want.size()));
+        for (size_t i = 0; i < top.size(); ++i) {
+            CHECK(std::abs(top[i].score - hits[i].score) < 1e-9);
+        }
+    }
+}
+
+static int connectControl(const std::string& path) {
+    int fd {::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0)};
+    sockaddr_un address {};
+    address.sun_family = AF_UNIX;
+    std::memcpy(address.sun_path, path.c_str(), path.size() + 1);
+    if (fd >= 0 && ::connect(fd, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0) {
+        ::close(fd);
+        fd = -1;
+    }
+    return fd;
+}
+
+// Reads until the reply ends with "OK" or an "ERR" line, or nothing arrives for 5 seconds.
+static std::string readControlReply(int fd) {
+    std::string reply;
+    while (true) {
+        const size_t lineStart {reply.size() < 2 ? 0 : reply.rfind('\n', reply.size() - 2) + 1};
+        if (!reply.empty() && reply.back() == '\n' &&
+            (reply.compare(lineStart, std::string::npos, "OK\n") == 0 || reply.compare(lineStart, 4, "ERR ") == 0)) {
+            return reply;
+        }
+        pollfd readable {fd, POLLIN, 0};
+        if (::poll(&readable, 1, 5000) <= 0) return reply + "<timeout>";
+        char buffer[65536];
+        const ssize_t received {::recv(fd, buffer, sizeof(buffer), 0)};
+        if (received <= 0) return reply + "<closed>";
+        reply.append(buffer, static_cast<size_t>(received));
+    }
+}
+
+static std::string controlRequest(int fd, const std::string& line) {
+    const std::string request {line + "\n"};
+    if (::send(fd, request.data(), request.size(), MSG_NOSIGNAL) != static_cast<ssize_t>(request.size())) {
+        return "<send failed>";
+    }
+    return readControlReply(fd);
+}
+
+// Socket setup (owner-only permissions, stale sockets replaced, other files
+// refused), command parsing, and replies larger than the socket buffer that
+// go out in partial non-blocking writes while other clients are still served.
+static void testControlServer() {
+    TempPath path("control.sock");
+
+    // Whatever else is at the path is never replaced
+    writeFile(path.str(), "keep me");
+    {
+        ControlServer server;
+        CHECK(!server.start(path.str()));
+    }
+    CHECK(readFile(path.str()) == "keep me");
+    std::filesystem::remove(path.str());
+
+    // A socket left behind by a killed run is
+    {
+        int stale {::socket(AF_UNIX, SOCK_STREAM, 0)};
+        sockaddr_un address {};
+        address.sun_family = AF_UNIX;
+        std::memcpy(address.sun_path, path.str().c_str(), path.str().size() + 1);
+        CHECK(::bind(stale, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) == 0);
+        ::close(stale);
+    }
+
+    static constexpr size_t kBigReply {4u << 20};
+    ControlServer server;
+    server.addCommand("echo", "echo <words...>", [](const std::vector<std::string>& args, std::string& reply) {
+        for (const auto& arg : args) reply += arg + " ";
+        if (!reply.empty()) reply.pop_back();
+        return true;
+    });
+    server.addCommand("fail", "fail <x>", [](const std::vector<std::string>& args, std::string& reply) {
+        if (!args.empty()) reply = "failed " + args[0];
+        return false;
+    });
+    server.addCommand("big", "big", [](const std::vector<std::string>&, std::string& reply) {
+        for (size_t i = 0; reply.size() < kBigReply; ++i) {
+            reply += "line " + std::to_string(i) + "\n";
+        }
+        return true;
+    });
+
+    const mode_t maskBefore {::umask(022)};
+    ::umask(maskBefore);
+    CHECK(server.start(path.str()));
+    const mode_t maskAfter {::umask(maskBefore)};
+    CHECK(maskAfter == maskBefore);
+
+    struct stat info {};
+    CHECK(::lstat(path.str().c_str(), &info) == 0);
+    CHECK(S_ISSOCK(info.st_mode));
+    CHECK((info.st_mode & (S_IRWXG | S_IRWXO)) == 0);
+
+    int client {connectControl(path.str())};
+    CHECK(client >= 0);
+    CHECK(controlRequest(client, "echo a  b") == "a b\nOK\n");
+    CHECK(controlRequest(client, "fail x") == "ERR failed x\n");
+    CHECK(controlRequest(client, "fail") == "ERR usage: fail <x>\n");
+    CHECK(controlRequest(client, "nope").starts_with("ERR unknown command 'nope'"));
+    const std::string help {controlRequest(client, "help")};
+    CHECK(help.find("echo <words...>\n") != std::string::npos);
+    CHECK(help.ends_with("help\nOK\n"));
+
+    // A command split across writes, CRLF terminated, and two in one write
+    CHECK(::send(client, "ec", 2, MSG_NOSIGNAL) == 2);
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    CHECK(controlRequest(client, "ho split\r") == "split\nOK\n");
+    CHECK(::send(client, "echo 1\necho 2\n", 14, MSG_NOSIGNAL) == 14);
+    std::string both {readControlReply(client)};
+    if (both == "1\nOK\n") both += readControlReply(client);
+    CHECK(both == "1\nOK\n2\nOK\n");
+
+    // A client that does not read its big reply holds up nobody
+    int slow {connectControl(path.str())};
+    CHECK(slow >= 0);
+    CHECK(::send(slow, "big\n", 4, MSG_NOSIGNAL) == 4);
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    const auto askedAt {std::chrono::steady_clock::now()};
+    CHECK(controlRequest(client, "echo still here") == "still here\nOK\n");
+    CHECK(std::chrono::steady_clock::now() - askedAt < std::chrono::seconds(2));
+
+    const std::string big {readControlReply(slow)};
+    CHECK(big.size() > kBigReply);
+    CHECK(big.starts_with("line 0\nline 1\n"));
+    CHECK(big.ends_with("\nOK\n"));
+    size_t expectedLine {0};
+    size_t broken {0};
+    for (size_t begin = 0; begin + 3 < big.size();) {
+        const size_t end {big.find('\n', begin)};
+        if (big.compare(begin, end - begin, "line " + std::to_string(expectedLine++)) != 0) broken++;
+        begin = end + 1;
+    }
+    CHECK(broken == 0);
+
+    ::close(slow);
+    ::close(client);
+    server.stop();
+    CHECK(!std::filesystem::exists(path.str()));
+}
+
+// The crawl's runtime commands, driven over the socket.
+static void testControlCommands() {
+    WebCrawler crawler(wideLimits(), BudgetLimits {});
+    crawler.addSeeds({"http://a.test/1", "http://a.test/2", "http://b.test/"});
+
+    size_t flushes {0};
+    TempPath path("commands.sock");
+    ControlServer server;
+    addCrawlCommands(server, crawler, [&](std::string& error) {
+        if (++flushes > 1) {
+            error = "disk full";
+            return false;
+        }
+        return true;
+    });
+    CHECK(server.start(path.str()));
+    int client {connectControl(path.str())};
+    CHECK(client >= 0);
+
+    CHECK(controlRequest(client, "stats") == "no stats yet\nOK\n");
+    CHECK(controlRequest(client, "stats now") == "ERR usage: stats\n");
+    CHECK(controlRequest(client, "hosts") == "OK\n");
+    CHECK(controlRequest(client, "hosts x").starts_with("ERR usage: hosts"));
+
+    CHECK(controlRequest(client, "pause a.test") == "OK\n");
+    CHECK(controlRequest(client, "pause a.test") == "ERR a.test is already paused\n");
+    CHECK(controlRequest(client, "resume a.test") == "OK\n");
+    CHECK(controlRequest(client, "resume a.test") == "ERR a.test is not paused\n");
+    CHECK(controlRequest(client, "pause") == "ERR usage: pause <host>\n");
+
+    CHECK(controlRequest(client, "concurrency 8") == "concurrency_ceiling 8\nOK\n");
+    CHECK(controlRequest(client, "concurrency 1000") == "concurrency_ceiling 64\nOK\n");
+    CHECK(controlRequest(client, "concurrency -1") == "ERR usage: concurrency <n>\n");
+
+    CHECK(controlRequest(client, "budget 500") == "budget 500\nOK\n");
+    CHECK(controlRequest(client, "budget 5") == "budget 500\nOK\n");
+    CHECK(controlRequest(client, "budget 99999999999999999999999").starts_with("ERR usage: budget"));
+
+    CHECK(controlRequest(client, "flush") == "OK\n");
+    CHECK(controlRequest(client, "flush") == "ERR disk full\n");
+    CHECK(flushes == 2);
+
+    ::close(client);
+    server.stop();
+}
+
+// Capacities round up to a power of two; a small ring stays FIFO through many
+// wraparounds, refuses pushes when full (leaving the value with the caller)
+// and pops when empty.
+static void testChannelWraparound() {
+    CHECK(BoundedChannel<int>(1).capacity() == 2);
+    CHECK(BoundedChannel<int>(5).capacity() == 8);
+    CHECK(BoundedChannel<int>(8).capacity() == 8);
+
+    BoundedChannel<std::unique_ptr<int>> channel(4);
+    int next {0};
+    int expected {0};
+    size_t wrong {0};
+    for (int round = 0; round < 1000; ++round) {
+        // Fill completely, then drain a varying amount, so head and tail land
+        // on every cell of the ring
+        while (true) {
+            auto value {std::make_unique<int>(next)};
+            if (!channel.tryPush(value)) {
+                if (!value || *value != next) wrong++;
+                break;
+            }
+            next++;
+        }
+        if (channel.size() != 4) wrong++;
+        const int drain {1 + round % 4};
+        for (int i = 0; i < drain; ++i) {
+            std::unique_ptr<int> value;
+            if (!channel.tryPop(value) || !value || *value != expected) wrong++;
+            expected++;
+        }
+    }
+    std::unique_ptr<int> value;
+    while (channel.tryPop(value)) {
+        if (!value || *value != expected) wrong++;
+        expected++;
+    }
+    CHECK(wrong == 0);
+    CHECK(expected == next);
+    CHECK(channel.size() == 0);
+    CHECK(!channel.tryPop(value));
+}
+
+// close() wakes producers blocked on a full channel and consumers blocked on an
+// empty one; values queued before it are still delivered.
+static void testChannelClose() {
+    {
+        BoundedChannel<int> full(2);
+        CHECK(full.push(1));
+        CHECK(full.push(2));
+        std::atomic<int> returned {0};
+        std::atomic<int> refused {0};
+        std::vector<std::thread> producers;
+        for (int i = 0; i < 3; ++i) {
+            producers.emplace_back([&] {
+                if (!full.push(100)) refused++;
+                returned++;
+            });
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        CHECK(returned == 0);
+        full.close();
+        for (auto& thread : producers) thread.join();
+        CHECK(refused == 3);
+        CHECK(!full.push(3));
+
+        int value {0};
+        CHECK(full.pop(value) && value == 1);
+        CHECK(full.pop(value) && value == 2);
+        CHECK(!full.pop(value));
+    }
+    {
+        BoundedChannel<int> empty(4);
+        std::atomic<int> returned {0};
+        std::atomic<int> drained {0};
+        std::vector<std::thread> consumers;
+        for (int i = 0; i < 4; ++i) {
+            consumers.emplace_back([&] {
+                int value {0};
+                if (!empty.pop(value)) drained++;
+                returned++;
+            });
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        CHECK(returned == 0);
+        empty.close();
+        for (auto& thread : consumers) thread.join();
+        CHECK(drained == 4);
+    }
+}
+
+// Several producers and consumers through a small channel: nothing is lost or
+// duplicated, and each consumer sees every producer's values in order.
+static void testChannelConcurrent() {
+    static constexpr int kProducers {4};
+    static constexpr int kConsumers {4};
+    static constexpr int kPerProducer {50000};
+    BoundedChannel<int> channel(8);
+
+    std::vector<std::thread> threads;
+    std::vector<std::vector<int>> received(kConsumers);
+    for (int c = 0; c < kConsumers; ++c) {
+        threads.emplace_back([&, c] {
+            int value {0};
+            while (channel.pop(value)) received[c].push_back(value);
+        });
+    }
+    std::vector<std::thread> producers;
+    for (int p = 0; p < kProducers; ++p) {
+        producers.emplace_back([&, p] {
+            for (int i = 0; i < kPerProducer; ++i) channel.push(p * kPerProducer + i);
+        });
+    }
+    for (auto& thread : producers) thread.join();
+    channel.close();
+    for (auto& thread : threads) thread.join();
+
+    std::vector<int> all;
+    size_t outOfOrder {0};
+    for (const auto& values : received) {
+        std::vector<int> last(kProducers, -1);
+        for (int value : values) {
+            if (value <= last[value / kPerProducer]) outOfOrder++;
+            last[value / kPerProducer] = value;
+        }
+        all.insert(all.end(), values.begin(), values.end());
+    }
+    std::sort(all.begin(), all.end());
+    CHECK(outOfOrder == 0);
+    CHECK(all.size() == static_cast<size_t>(kProducers * kPerProducer));
+    bool complete {true};
+    for (size_t i = 0; i < all.size(); ++i) complete = complete && all[i] == static_cast<int>(i);
+    CHECK(complete);
+}
+
+// Header lookups over the raw buffer, and Content-Length values that must not
+// turn into a huge or wrapped presize.
+static void testHttpHeaders() {
+    HttpHeaders headers;
+    headers.append("HTTP/1.1 301 Moved\r\n");
+    headers.append("Location: /next\r\n");
+    headers.append("\r\n");
+    // A redirect's headers are replaced by the final response's
+    headers.append("HTTP/1.1 200 OK\r\n");
+    headers.append("content-type:  text/html \r\n");
+    headers.append("X-Empty:\r\n");
+    headers.append("Retry-After: 5\r\n");
+    headers.append("Retry-After: 9\r\n");
+    headers.append("\r\n");
+    CHECK(headers.location().empty());
+    CHECK(headers.contentType() == "text/html");
+    CHECK(headers.get("CONTENT-TYPE") == "text/html");
+    CHECK(headers.retryAfter() == "5");
+    CHECK(headers.get("X-Empty").empty());
+    CHECK(headers.get("X-Missing").empty());
+    CHECK(headers.size() == 4);
+    CHECK(headers.line(0) == "content-type:  text/html");
+    CHECK(headers.line(3) == "Retry-After: 9");
+    CHECK(headers.line(4).empty());
+    CHECK(!headers.contentLength());
+
+    auto lengthOf = [](std::string_view value) {
+        HttpHeaders parsed;
+        parsed.append("HTTP/2 200\r\n");
+        parsed.append("Content-Length: " + std::string(value) + "\r\n");
+        return parsed.contentLength();
+    };
+    CHECK(lengthOf("0") == 0u);
+    CHECK(lengthOf("1234") == 1234u);
+    CHECK(lengthOf(" 42 ") == 42u);
+    CHECK(lengthOf("18446744073709551615") == UINT64_MAX);
+    CHECK(!lengthOf("18446744073709551616"));
+    CHECK(!lengthOf("99999999999999999999999"));
+    CHECK(!lengthOf("-1"));
+    CHECK(!lengthOf("+5"));
+    CHECK(!lengthOf("12abc"));
+    CHECK(!lengthOf("1 2"));
+    CHECK(!lengthOf(""));
+
+    static constexpr size_t kCap {8u << 20};
+    CHECK(bodyPresize(std::nullopt) == 0);
+    CHECK(bodyPresize(0) == 0);
+    CHECK(bodyPresize(5000) == 5000);
+    CHECK(bodyPresize(kCap) == kCap);
+    CHECK(bodyPresize(kCap + 1) == kCap);
+    CHECK(bodyPresize(uint64_t {1} << 40) == kCap);
+    CHECK(bodyPresize(lengthOf("18446744073709551615")) == kCap);
+}
+
+struct TestCase {
+    const char* name;
+    void (*run)();
+};
+
+static constexpr TestCase kTests[] {
+    {"budget_exact", testBudgetExact},
+    {"budget_scoped", testBudgetScoped},
+    {"budget_depth", testBudgetDepth},
+    {"unresolvable_hosts", testUnresolvableHosts},
+    {"concurrency_backoff", testConcurrencyBackoff},
+    {"concurrency_eviction", testConcurrencyEviction},
+    {"canonicalizer_learning", testCanonicalizerLearning},
+    {"sitemap_parser", testSitemapParser},
+    {"sitemap_gzip", testSitemapGzip},
+    {"timer_wheel", testTimerWheel},
+    {"retry_policy", testRetryPolicy},
+    {"host_health", testHostHealth},
+    {"trap_detector", testTrapDetector},
+    {"trap_calendar_crawl", testTrapCalendarCrawl},
+    {"result_file_roundtrip", testResultFileRoundTrip},
+    {"result_file_corrupt", testResultFileCorrupt},
+    {"domain_filter", testDomainFilter},
+    {"domain_filter_high_bytes", testDomainFilterHighBytes},
+    {"domain_filter_bulk", testDomainFilterBulk},
+    {"tokenize", testTokenize},
+    {"inverted_index", testInvertedIndex},
+    {"control_server", testControlServer},
+    {"control_commands", testControlCommands},
+    {"channel_wraparound", testChannelWraparound},
+    {"channel_close", testChannelClose},
+    {"channel_concurrent", testChannelConcurrent},
+    {"http_headers", testHttpHeaders},
+};
+
+// Crawls a local crawler_bench_site and checks the crawl's invariants.
+int main(int argc, char* argv[]) {
+    if (argc < 2) {
+        std::cerr << "Usage: " << argv[0] << " <crawler_bench_site> [test...]\n";
+        std::cerr << "  Runs the named tests, or all of them:";
+        for (const auto& test : kTests) {
+            std::cerr << " " << test.name;
+        }
+        std::cerr << "\n";
+        return 1;
+    }
+    g_sitePath = argv[1];
+    if (curl_global_init(CURL_GLOBAL_DEFAULT) != CURLE_OK) {
+        std::cerr << "Global initializing failed.\n";
+        return 1;
+    }
+    std::vector<std::string> selected(argv + 2, argv + argc);
+    for (const auto& name : selected) {
+        if (std::none_of(std::begin(kTests), std::end(kTests), [&](const TestCase& test) { return name == test.name; })) {
+            std::cerr << "Unknown test: " << name << "\n";
+            return 1;
+        }
+    }
+
+    size_t failed {0};
+    for (const auto& test : kTests) {
+        if (!selected.empty() && std::find(selected.begin(), selected.end(), test.name) == selected.end()) continue;
+        g_failures = 0;
+        test.run();
+        std::cout << (g_failures == 0 ? "PASS " : "FAIL ") << test.name << std::endl;
+        if (g_failures > 0) failed++;
+    }
+    curl_global_cleanup();
+    return failed == 0 ? 0 : 1;
+}